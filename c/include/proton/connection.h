@@ -490,6 +490,27 @@ PN_EXTERN pn_data_t *pn_connection_remote_properties(pn_connection_t *connection
  */
 PN_EXTERN pn_transport_t *pn_connection_transport(pn_connection_t *connection);
 
+/**
+ * **Unsettled API**: Limit the number of freed deliveries kept for reuse.
+ *
+ * Deliveries that are settled and freed are kept by the connection to
+ * be reused for new deliveries. Setting a limit returns the memory of
+ * deliveries beyond the limit, for example after a burst of unsettled
+ * messages. The default is no limit.
+ *
+ * @param[in] connection the connection object
+ * @param[in] max the maximum number of deliveries to keep, 0 to keep none
+ */
+PN_EXTERN void pn_connection_set_delivery_pool_max(pn_connection_t *connection, size_t max);
+
+/**
+ * **Unsettled API**: Get the limit set by ::pn_connection_set_delivery_pool_max.
+ *
+ * @param[in] connection the connection object
+ * @return the maximum number of freed deliveries kept for reuse
+ */
+PN_EXTERN size_t pn_connection_get_delivery_pool_max(pn_connection_t *connection);
+
 /**
  * @}
  */
@@ -175,8 +175,24 @@ PN_EXTERN bool pn_connection_driver_read_closed(pn_connection_driver_t *);
  PN_EXTERN pn_bytes_t pn_connection_driver_write_buffer(pn_connection_driver_t *);
 
 /**
- * Call when the first n bytes of pn_connection_driver_write_buffer() have been
- * written to IO. Reclaims the buffer space and reset the write buffer.
+ * Get the pending output as a sequence of buffers, for scatter/gather IO such
+ * as writev() or sendmsg().
+ *
+ * Fills in up to n buffers and returns the number filled in, 0 means there is
+ * nothing to write. The buffers are consecutive parts of the output stream,
+ * write them in order. Where possible the buffers refer to encoded frames in
+ * place, avoiding the copy made by pn_connection_driver_write_buffer().
+ *
+ * Call pn_connection_driver_write_done() with the total number of bytes written
+ * across all the buffers. The buffers are only valid until the next call to a
+ * pn_connection_driver function.
+ */
+PN_EXTERN size_t pn_connection_driver_write_buffers(pn_connection_driver_t *, pn_bytes_t *bufs, size_t n);
+
+/**
+ * Call when the first n bytes of pn_connection_driver_write_buffer() or
+ * pn_connection_driver_write_buffers() have been written to IO. Reclaims the
+ * buffer space and reset the write buffer.
  */
 PN_EXTERN void pn_connection_driver_write_done(pn_connection_driver_t *, size_t n);
 
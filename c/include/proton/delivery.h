@@ -291,6 +291,23 @@ PN_EXTERN void pn_delivery_abort(pn_delivery_t *delivery);
  */
 PN_EXTERN void pn_delivery_settle(pn_delivery_t *delivery);
 
+/**
+ * **Unsettled API** - Update and settle a delivery and all unsettled
+ * deliveries before it on its link.
+ *
+ * Deliveries are handled in the order they were created on the link, as if
+ * pn_delivery_update() (unless state is 0) and pn_delivery_settle() were
+ * called for each. The transport sends the resulting dispositions as ranges,
+ * so acknowledging a batch of deliveries this way costs a single
+ * DISPOSITION frame for each run of consecutive deliveries.
+ *
+ * Does nothing if the delivery is already settled.
+ *
+ * @param[in] delivery the last delivery to settle
+ * @param[in] state the outcome for the deliveries, or 0 to just settle them
+ */
+PN_EXTERN void pn_delivery_settle_upto(pn_delivery_t *delivery, uint64_t state);
+
 /**
  * Utility function for printing details of a delivery.
  *
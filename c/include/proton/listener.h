@@ -108,6 +108,19 @@ PNP_EXTERN void *pn_listener_get_context(pn_listener_t *listener);
  */
 PNP_EXTERN void pn_listener_set_context(pn_listener_t *listener, void *context);
 
+/**
+ * **Unsettled API** - Listen with @p sockets sockets for each address,
+ * using SO_REUSEPORT so the kernel spreads incoming connections across them.
+ * The sockets are accepted independently, and by a sharded proactor (see
+ * pn_proactor_sharded()) on different shards, so a burst of new connections
+ * is not serialized through a single listening socket.
+ *
+ * Must be called before pn_proactor_listen(). The default, 0, listens with a
+ * single socket per address without SO_REUSEPORT. Ignored by proactors that do
+ * not support it.
+ */
+PNP_EXTERN void pn_listener_set_reuseport(pn_listener_t *listener, size_t sockets);
+
 /**
  * Get the attachments that are associated with a listener object.
  */
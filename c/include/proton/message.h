@@ -722,6 +722,27 @@ PN_EXTERN pn_data_t *pn_message_body(pn_message_t *msg);
  */
 PN_EXTERN int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size);
 
+/**
+ * **Unsettled API**: Decode/load message content from AMQP formatted
+ * binary data, deferring the work until the content is used.
+ *
+ * Like ::pn_message_decode(), but only the boundaries of the message
+ * sections are found here; the bytes are copied into the message and
+ * each section is decoded the first time one of its fields is
+ * accessed. A message that is only inspected for, say, its address
+ * does not pay for decoding its annotations or body.
+ *
+ * Errors in the content of a section are detected when the section
+ * is decoded, and are then reported by ::pn_message_error().
+ *
+ * @param[in] msg a message object
+ * @param[in] bytes the start of the encoded AMQP data
+ * @param[in] size the size of the encoded AMQP data
+ * @return zero on success or an error code if the section boundaries
+ * are not valid
+ */
+PN_EXTERN int pn_message_decode_lazy(pn_message_t *msg, const char *bytes, size_t size);
+
 /**
  * Encode a message as AMQP formatted binary data.
  *
@@ -87,9 +87,34 @@ PNP_EXTERN int pn_proactor_addr(char *addr, size_t size, const char *host, const
 
 /**
  * Create a proactor. Must be freed with pn_proactor_free()
+ *
+ * The initial zerocopy threshold, see pn_proactor_set_zerocopy_threshold(), is
+ * taken from the environment variable PN_ZEROCOPY_THRESHOLD if it is set.
  */
 PNP_EXTERN pn_proactor_t *pn_proactor(void);
 
+/**
+ * **Unsettled API** - Create a proactor that divides its work into @p shards
+ * independent event queues. Must be freed with pn_proactor_free()
+ *
+ * Connections and listeners are assigned to shards in turn, and each thread
+ * calling pn_proactor_wait() is assigned a home shard in turn on its first
+ * call. A thread only processes events from its home shard, so threads of
+ * different shards do not contend with each other. pn_proactor_get() polls
+ * the calling thread's home shard, or the first shard if it has none. A
+ * shard stays with its threads until they exit.
+ *
+ * PN_PROACTOR_TIMEOUT is returned only to threads of the first shard,
+ * PN_PROACTOR_INTERRUPT and PN_PROACTOR_INACTIVE to a thread of any shard.
+ * Until a shard has a thread of its own, its events are processed by the
+ * threads of the first shard. For best results use a multiple of @p shards threads,
+ * each calling pn_proactor_wait() until it returns PN_PROACTOR_INTERRUPT.
+ *
+ * pn_proactor_sharded(1) is the same as pn_proactor(). Implementations that do
+ * not support sharding ignore @p shards.
+ */
+PNP_EXTERN pn_proactor_t *pn_proactor_sharded(size_t shards);
+
 /**
  * Free the proactor. Abort open connections/listeners, clean up all resources.
  */
@@ -312,6 +337,84 @@ PNP_EXTERN pn_proactor_t *pn_event_proactor(pn_event_t *event);
  */
 PNP_EXTERN pn_millis_t pn_proactor_now(void);
 
+/**
+ * **Unsettled API** - Poll for events without sleeping for up to @p usec
+ * microseconds before pn_proactor_wait() blocks. This trades CPU time for
+ * lower latency: a spinning thread picks up an event without the delay of
+ * being woken by the operating system. 0, the default, never spins.
+ *
+ * Where supported, connections created afterwards also ask the kernel to busy
+ * poll their sockets (SO_BUSY_POLL), which may need extra privileges.
+ * Ignored by proactors that do not support busy polling.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN void pn_proactor_set_busy_poll(pn_proactor_t *proactor, uint32_t usec);
+
+/**
+ * **Unsettled API** - Write connection output of at least @p bytes with
+ * MSG_ZEROCOPY, so the kernel sends it without copying it into the socket
+ * buffer. This is only worthwhile for large messages, tens of KB or more.
+ * 0, the default, never uses zerocopy.
+ *
+ * Only connections created afterwards can use zerocopy, a threshold set later
+ * still applies to their writes. Ignored by proactors that do not support
+ * zerocopy, currently all but the Linux epoll proactor.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN void pn_proactor_set_zerocopy_threshold(pn_proactor_t *proactor, size_t bytes);
+
+/**
+ * **Unsettled API** - Counters of where a proactor spends its time, see
+ * pn_proactor_stats() and pn_connection_stats().
+ *
+ * Times are in nanoseconds. All values only increase, take the difference
+ * between two samples for the activity in an interval. Counters are only
+ * collected while enabled by pn_proactor_stats_enable().
+ */
+typedef struct pn_proactor_stats_t {
+  uint64_t read_ns;           /**< Reading from sockets */
+  uint64_t process_ns;        /**< Transport processing of input read */
+  uint64_t dispatch_ns;       /**< Application handling of event batches, excluding read, process and write */
+  uint64_t write_ns;          /**< Writing to sockets */
+  uint64_t wakeups;           /**< Proactor: returns from the OS poll call. Connection: IO notifications */
+  uint64_t rearms;            /**< Requests for further IO notifications */
+  uint64_t hog_yields;        /**< Event batches ended to give other work a turn */
+  uint64_t wakes;             /**< PN_CONNECTION_WAKE events */
+  uint64_t wake_delay_ns;     /**< Total delay from pn_connection_wake() to the PN_CONNECTION_WAKE event */
+  uint64_t wake_delay_max_ns; /**< Longest delay from pn_connection_wake() to the PN_CONNECTION_WAKE event */
+} pn_proactor_stats_t;
+
+/**
+ * **Unsettled API** - Start or stop collecting @ref pn_proactor_stats_t
+ * counters. Collection is off by default, it costs a clock read around
+ * each IO call.
+ *
+ * @note Thread-safe
+ */
+PNP_EXTERN void pn_proactor_stats_enable(pn_proactor_t *proactor, bool enable);
+
+/**
+ * **Unsettled API** - Get the counters for @p proactor: the totals for all its
+ * connections, including those already closed, and its own wakeups.
+ *
+ * @note Thread-safe
+ *
+ * @return false, with @p stats zeroed, if the proactor does not collect counters.
+ */
+PNP_EXTERN bool pn_proactor_stats(pn_proactor_t *proactor, pn_proactor_stats_t *stats);
+
+/**
+ * **Unsettled API** - Get the counters for one connection of a proactor.
+ *
+ * @note Thread-safe
+ *
+ * @return false, with @p stats zeroed, if @p connection does not belong to a
+ * proactor or the proactor does not collect counters.
+ */
+PNP_EXTERN bool pn_connection_stats(pn_connection_t *connection, pn_proactor_stats_t *stats);
+
 /**
  * @}
  */
@@ -30,13 +30,6 @@
 #include "buffer.h"
 #include "util.h"
 
-struct pn_buffer_t {
-  size_t capacity;
-  size_t start;
-  size_t size;
-  char *bytes;
-};
-
 pn_buffer_t *pn_buffer(size_t capacity)
 {
   pn_buffer_t *buf = (pn_buffer_t *) malloc(sizeof(pn_buffer_t));
@@ -44,6 +37,7 @@ pn_buffer_t *pn_buffer(size_t capacity)
     buf->capacity = capacity;
     buf->start = 0;
     buf->size = 0;
+    buf->external = false;
     if (capacity > 0) {
         buf->bytes = (char *)malloc(capacity);
         if (buf->bytes == NULL) {
@@ -61,11 +55,27 @@ pn_buffer_t *pn_buffer(size_t capacity)
 void pn_buffer_free(pn_buffer_t *buf)
 {
   if (buf) {
-    free(buf->bytes);
+    pn_buffer_tini(buf);
     free(buf);
   }
 }
 
+void pn_buffer_init(pn_buffer_t *buf, char *bytes, size_t capacity)
+{
+  buf->capacity = bytes ? capacity : 0;
+  buf->start = 0;
+  buf->size = 0;
+  buf->bytes = bytes;
+  buf->external = bytes != NULL;
+}
+
+void pn_buffer_tini(pn_buffer_t *buf)
+{
+  if (!buf->external) free(buf->bytes);
+  buf->bytes = NULL;
+  buf->capacity = 0;
+}
+
 size_t pn_buffer_size(pn_buffer_t *buf)
 {
   return buf->size;
@@ -145,7 +155,21 @@ int pn_buffer_ensure(pn_buffer_t *buf, size_t size)
     buf->capacity = 2*(buf->capacity ? buf->capacity : 16);
   }
 
-  if (buf->capacity != old_capacity) {
+  if (buf->capacity != old_capacity && buf->external) {
+    // Leave the storage we were given, unwrapping the contents on the way
+    char* new_bytes = (char *)malloc(buf->capacity);
+    if (!new_bytes) {
+      buf->capacity = old_capacity;
+      return PN_OUT_OF_MEMORY;
+    }
+    size_t new_capacity = buf->capacity;
+    buf->capacity = old_capacity;
+    pn_buffer_get(buf, 0, buf->size, new_bytes);
+    buf->capacity = new_capacity;
+    buf->bytes = new_bytes;
+    buf->start = 0;
+    buf->external = false;
+  } else if (buf->capacity != old_capacity) {
     char* new_bytes = (char *)realloc(buf->bytes, buf->capacity);
     if (new_bytes) {
       buf->bytes = new_bytes;
@@ -306,6 +330,17 @@ pn_rwbytes_t pn_buffer_memory(pn_buffer_t *buf)
   }
 }
 
+// Describe the buffer contents in place, without defragmenting.
+// Returns the number of non-empty segments filled in (0, 1 or 2).
+size_t pn_buffer_segments(pn_buffer_t *buf, pn_bytes_t segments[2])
+{
+  if (!buf || !buf->size) return 0;
+  segments[0] = pn_bytes(pni_buffer_head_size(buf), buf->bytes + pni_buffer_head(buf));
+  if (!pni_buffer_wrapped(buf)) return 1;
+  segments[1] = pn_bytes(pni_buffer_tail_size(buf), buf->bytes);
+  return segments[1].size ? 2 : 1;
+}
+
 int pn_buffer_quote(pn_buffer_t *buf, pn_string_t *str, size_t n)
 {
   size_t hsize = pni_buffer_head_size(buf);
@@ -26,15 +26,31 @@
 #include <proton/object.h>
 #include <proton/types.h>
 
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-typedef struct pn_buffer_t pn_buffer_t;
+typedef struct pn_buffer_t {
+  size_t capacity;
+  size_t start;
+  size_t size;
+  char *bytes;
+  bool external;                /* bytes not owned: storage given to pn_buffer_init() */
+} pn_buffer_t;
 
-pn_buffer_t *pn_buffer(size_t capacity);
-void pn_buffer_free(pn_buffer_t *buf);
-size_t pn_buffer_size(pn_buffer_t *buf);
+/* PN_EXTERN functions are also used by the proactor, for output it takes
+   from the transport with pni_transport_take_output() */
+PN_EXTERN pn_buffer_t *pn_buffer(size_t capacity);
+PN_EXTERN void pn_buffer_free(pn_buffer_t *buf);
+/* For a buffer embedded in another object, starting out in storage that
+   belongs to that object. The buffer moves to the heap if it must grow. */
+void pn_buffer_init(pn_buffer_t *buf, char *bytes, size_t capacity);
+void pn_buffer_tini(pn_buffer_t *buf);
+PN_EXTERN size_t pn_buffer_size(pn_buffer_t *buf);
 size_t pn_buffer_capacity(pn_buffer_t *buf);
 size_t pn_buffer_available(pn_buffer_t *buf);
 int pn_buffer_ensure(pn_buffer_t *buf, size_t size);
@@ -42,10 +58,11 @@ int pn_buffer_append(pn_buffer_t *buf, const char *bytes, size_t size);
 int pn_buffer_prepend(pn_buffer_t *buf, const char *bytes, size_t size);
 size_t pn_buffer_get(pn_buffer_t *buf, size_t offset, size_t size, char *dst);
 int pn_buffer_trim(pn_buffer_t *buf, size_t left, size_t right);
-void pn_buffer_clear(pn_buffer_t *buf);
+PN_EXTERN void pn_buffer_clear(pn_buffer_t *buf);
 int pn_buffer_defrag(pn_buffer_t *buf);
 pn_bytes_t pn_buffer_bytes(pn_buffer_t *buf);
 pn_rwbytes_t pn_buffer_memory(pn_buffer_t *buf);
+PN_EXTERN size_t pn_buffer_segments(pn_buffer_t *buf, pn_bytes_t segments[2]);
 int pn_buffer_quote(pn_buffer_t *buf, pn_string_t *string, size_t n);
 
 #ifdef __cplusplus
@@ -18,6 +18,7 @@
  */
 
 #include "engine-internal.h"
+#include "transport.h"
 #include <proton/condition.h>
 #include <proton/connection.h>
 #include <proton/connection_driver.h>
@@ -121,6 +122,10 @@ pn_bytes_t pn_connection_driver_write_buffer(pn_connection_driver_t *d) {
     pn_bytes(pending, pn_transport_head(d->transport)) : pn_bytes_null;
 }
 
+size_t pn_connection_driver_write_buffers(pn_connection_driver_t *d, pn_bytes_t *bufs, size_t n) {
+  return pn_transport_head_buffers(d->transport, bufs, n);
+}
+
 void pn_connection_driver_write_done(pn_connection_driver_t *d, size_t n) {
   pn_transport_pop(d->transport, n);
 }
@@ -0,0 +1,267 @@
+#ifndef PROTON_CONSUMERS_H
+#define PROTON_CONSUMERS_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/*
+ * Direct AMQP decoding of values from a byte buffer, without decoding into a
+ * pn_data_t first. The counterpart of emitters.h, used for the performatives
+ * received for every message.
+ *
+ * A consumer reads the elements of a list (or a single top level value) in
+ * order. Reading a field gives false if the field is absent, null or of a
+ * different type, like pn_data_scan() which gives the default value then. The
+ * field is skipped either way. Malformed or truncated input marks the consumer
+ * as failed, check with pni_consumer_ok() when done.
+ */
+
+#include <proton/types.h>
+
+#include "encodings.h"
+
+typedef struct pni_consumer_t {
+  const uint8_t *input;
+  size_t size;
+  size_t position;
+  uint32_t count;               /* Elements left to read */
+  bool failed;
+} pni_consumer_t;
+
+static inline pni_consumer_t pni_consumer(pn_bytes_t input)
+{
+  pni_consumer_t consumer = {(const uint8_t *)input.start, input.size, 0, 1, false};
+  return consumer;
+}
+
+static inline bool pni_consumer_ok(pni_consumer_t *consumer)
+{
+  return !consumer->failed;
+}
+
+static inline bool pni_consumer_need(pni_consumer_t *consumer, size_t n)
+{
+  if (consumer->failed || consumer->size - consumer->position < n) {
+    consumer->failed = true;
+    return false;
+  }
+  return true;
+}
+
+static inline uint8_t pni_consumer_readf8(pni_consumer_t *consumer)
+{
+  if (!pni_consumer_need(consumer, 1)) return 0;
+  return consumer->input[consumer->position++];
+}
+
+static inline uint32_t pni_consumer_readf32(pni_consumer_t *consumer)
+{
+  if (!pni_consumer_need(consumer, 4)) return 0;
+  const uint8_t *p = consumer->input + consumer->position;
+  consumer->position += 4;
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint64_t pni_consumer_readf64(pni_consumer_t *consumer)
+{
+  uint64_t hi = pni_consumer_readf32(consumer);
+  return hi << 32 | pni_consumer_readf32(consumer);
+}
+
+static inline void pni_consumer_skip(pni_consumer_t *consumer, size_t n)
+{
+  if (pni_consumer_need(consumer, n)) consumer->position += n;
+}
+
+/* Skip the value (after the type code) of a type with fixed or sized width */
+static inline void pni_consumer_skip_value(pni_consumer_t *consumer, uint8_t code)
+{
+  switch (code & 0xF0) {
+  case 0x40: return;
+  case 0x50: pni_consumer_skip(consumer, 1); return;
+  case 0x60: pni_consumer_skip(consumer, 2); return;
+  case 0x70: pni_consumer_skip(consumer, 4); return;
+  case 0x80: pni_consumer_skip(consumer, 8); return;
+  case 0x90: pni_consumer_skip(consumer, 16); return;
+  case 0xA0:
+  case 0xC0:
+  case 0xE0: {
+    size_t size = pni_consumer_readf8(consumer);
+    pni_consumer_skip(consumer, size);
+    return;
+  }
+  case 0xB0:
+  case 0xD0:
+  case 0xF0: {
+    size_t size = pni_consumer_readf32(consumer);
+    pni_consumer_skip(consumer, size);
+    return;
+  }
+  default:
+    consumer->failed = true;
+    return;
+  }
+}
+
+/* Start reading the next element, returns its type code. Descriptors are not
+ * skipped: PNE_DESCRIPTOR means a described value follows. */
+static inline bool pni_consumer_next(pni_consumer_t *consumer, uint8_t *code)
+{
+  if (consumer->failed || !consumer->count) return false;
+  consumer->count--;
+  *code = pni_consumer_readf8(consumer);
+  return !consumer->failed;
+}
+
+/* Skip a complete value given its type code, including any descriptors */
+static inline void pni_consumer_skip_element(pni_consumer_t *consumer, uint8_t code)
+{
+  while (code == PNE_DESCRIPTOR && !consumer->failed) {
+    pni_consumer_skip_value(consumer, pni_consumer_readf8(consumer)); /* descriptor */
+    code = pni_consumer_readf8(consumer);
+  }
+  pni_consumer_skip_value(consumer, code);
+}
+
+/* Read an unsigned integer of the given code, false if code is not one */
+static inline bool pni_consumer_ulong_value(pni_consumer_t *consumer, uint8_t code, uint64_t *value)
+{
+  switch (code) {
+  case PNE_ULONG0: *value = 0; return true;
+  case PNE_SMALLULONG: *value = pni_consumer_readf8(consumer); return true;
+  case PNE_ULONG: *value = pni_consumer_readf64(consumer); return true;
+  default: return false;
+  }
+}
+
+static inline bool pni_consume_uint(pni_consumer_t *consumer, uint32_t *value)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  switch (code) {
+  case PNE_UINT0: *value = 0; return true;
+  case PNE_SMALLUINT: *value = pni_consumer_readf8(consumer); return true;
+  case PNE_UINT: *value = pni_consumer_readf32(consumer); return true;
+  default: pni_consumer_skip_element(consumer, code); return false;
+  }
+}
+
+static inline bool pni_consume_ulong(pni_consumer_t *consumer, uint64_t *value)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  if (pni_consumer_ulong_value(consumer, code, value)) return true;
+  pni_consumer_skip_element(consumer, code);
+  return false;
+}
+
+static inline bool pni_consume_bool(pni_consumer_t *consumer, bool *value)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  switch (code) {
+  case PNE_TRUE: *value = true; return true;
+  case PNE_FALSE: *value = false; return true;
+  case PNE_BOOLEAN: *value = pni_consumer_readf8(consumer); return true;
+  default: pni_consumer_skip_element(consumer, code); return false;
+  }
+}
+
+static inline bool pni_consume_binary(pni_consumer_t *consumer, pn_bytes_t *value)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  size_t size;
+  switch (code) {
+  case PNE_VBIN8: size = pni_consumer_readf8(consumer); break;
+  case PNE_VBIN32: size = pni_consumer_readf32(consumer); break;
+  default: pni_consumer_skip_element(consumer, code); return false;
+  }
+  if (!pni_consumer_need(consumer, size)) return false;
+  *value = pn_bytes(size, (const char *)consumer->input + consumer->position);
+  consumer->position += size;
+  return true;
+}
+
+/* Skip a field */
+static inline void pni_consume_skip(pni_consumer_t *consumer)
+{
+  uint8_t code;
+  if (pni_consumer_next(consumer, &code)) pni_consumer_skip_element(consumer, code);
+}
+
+/* Read a list, giving a consumer for its elements */
+static inline bool pni_consume_list(pni_consumer_t *consumer, pni_consumer_t *list)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  size_t size = 0;
+  uint32_t count = 0;
+  switch (code) {
+  case PNE_LIST0:
+    break;
+  case PNE_LIST8:
+    size = pni_consumer_readf8(consumer);
+    if (size < 1) consumer->failed = true;
+    count = pni_consumer_readf8(consumer);
+    size -= 1;
+    break;
+  case PNE_LIST32:
+    size = pni_consumer_readf32(consumer);
+    if (size < 4) consumer->failed = true;
+    count = pni_consumer_readf32(consumer);
+    size -= 4;
+    break;
+  default:
+    pni_consumer_skip_element(consumer, code);
+    return false;
+  }
+  if (!pni_consumer_need(consumer, size)) return false;
+  pni_consumer_t l = {consumer->input + consumer->position, size, 0, count, false};
+  *list = l;
+  consumer->position += size;
+  return true;
+}
+
+/* Read a described value with a numeric descriptor. Gives the descriptor
+ * code and the bytes of the encoded value, the value is not decoded. */
+static inline bool pni_consume_described(pni_consumer_t *consumer, uint64_t *descriptor, pn_bytes_t *value)
+{
+  uint8_t code;
+  if (!pni_consumer_next(consumer, &code)) return false;
+  if (code != PNE_DESCRIPTOR) {
+    pni_consumer_skip_element(consumer, code);
+    return false;
+  }
+  code = pni_consumer_readf8(consumer);
+  if (!pni_consumer_ulong_value(consumer, code, descriptor)) {
+    pni_consumer_skip_value(consumer, code);
+    pni_consumer_skip_element(consumer, pni_consumer_readf8(consumer));
+    return false;
+  }
+  size_t start = consumer->position;
+  pni_consumer_skip_element(consumer, pni_consumer_readf8(consumer));
+  if (consumer->failed) return false;
+  *value = pn_bytes(consumer->position - start, (const char *)consumer->input + start);
+  return true;
+}
+
+#endif /* consumers.h */
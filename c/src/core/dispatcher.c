@@ -49,9 +49,6 @@ static inline int pni_dispatch_action(pn_transport_t* transport, uint64_t lcode,
     case OPEN:            action = pn_do_open; break;
     case BEGIN:           action = pn_do_begin; break;
     case ATTACH:          action = pn_do_attach; break;
-    case FLOW:            action = pn_do_flow; break;
-    case TRANSFER:        action = pn_do_transfer; break;
-    case DISPOSITION:     action = pn_do_disposition; break;
     case DETACH:          action = pn_do_detach; break;
     case END:             action = pn_do_end; break;
     case CLOSE:           action = pn_do_close; break;
@@ -74,6 +71,49 @@ static inline int pni_dispatch_action(pn_transport_t* transport, uint64_t lcode,
   return action(transport, frame_type, channel, args, payload);
 }
 
+// Dispatch TRANSFER, FLOW and DISPOSITION without decoding into a pn_data_t.
+// Returns false if the frame is something else, or can't be read this way,
+// and must go through pn_data_decode().
+static bool pni_dispatch_fast(pn_transport_t *transport, pn_data_t *args, pn_frame_t frame, int *err)
+{
+  if (frame.type != AMQP_FRAME_TYPE) return false;
+
+  pni_consumer_t consumer = pni_consumer(pn_bytes(frame.size, frame.payload));
+  uint64_t lcode;
+  pn_bytes_t value;
+  if (!pni_consume_described(&consumer, &lcode, &value)) return false;
+  pn_action_fast_t *action;
+  switch (lcode) {
+  case FLOW:            action = pn_do_flow; break;
+  case TRANSFER:        action = pn_do_transfer; break;
+  case DISPOSITION:     action = pn_do_disposition; break;
+  default:              return false;
+  }
+  pni_consumer_t performative = pni_consumer(value);
+  pni_consumer_t fields;
+  if (!pni_consume_list(&performative, &fields)) return false;
+
+  size_t dsize = consumer.position;
+  size_t payload_size = frame.size - dsize;
+  const char *payload_mem = payload_size ? frame.payload + dsize : NULL;
+  pn_bytes_t payload = {payload_size, payload_mem};
+
+  if (transport->trace & PN_TRACE_FRM) {
+    pn_data_decode(args, frame.payload, dsize);
+    pn_do_trace(transport, frame.channel, IN, args, payload_mem, payload_size);
+    pn_data_clear(args);
+  }
+
+  *err = action(transport, frame.type, frame.channel, &fields, &payload);
+  if (!pni_consumer_ok(&fields)) {
+    pn_string_format(transport->scratch, "Error decoding frame: %s\n", pn_code(PN_ERR));
+    pn_quote(transport->scratch, frame.payload, frame.size);
+    pn_transport_log(transport, pn_string_get(transport->scratch));
+    *err = PN_ERR;
+  }
+  return true;
+}
+
 static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_frame_t frame)
 {
   if (frame.size == 0) { // ignore null frames
@@ -82,6 +122,9 @@ static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_fr
     return 0;
   }
 
+  int err;
+  if (pni_dispatch_fast(transport, args, frame, &err)) return err;
+
   ssize_t dsize = pn_data_decode(args, frame.payload, frame.size);
   if (dsize < 0) {
     pn_string_format(transport->scratch,
@@ -113,7 +156,7 @@ static int pni_dispatch_frame(pn_transport_t * transport, pn_data_t *args, pn_fr
 
   pn_do_trace(transport, channel, IN, args, payload_mem, payload_size);
 
-  int err = pni_dispatch_action(transport, lcode, frame_type, channel, args, &payload);
+  err = pni_dispatch_action(transport, lcode, frame_type, channel, args, &payload);
 
   pn_data_clear(args);
 
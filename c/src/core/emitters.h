@@ -0,0 +1,224 @@
+#ifndef PROTON_EMITTERS_H
+#define PROTON_EMITTERS_H 1
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/*
+ * Direct AMQP encoding of values into a byte buffer, without building a
+ * pn_data_t first. Used for the performatives that are sent for every message.
+ *
+ * The output is the same as pn_data_encode() gives for the equivalent
+ * pn_data_fill() format: lists are always list32 (or list0 when empty) and
+ * trailing nulls are left out of described lists.
+ *
+ * Emitting never fails: once the output is full the position keeps counting
+ * but nothing more is written. After encoding, if pni_emitter_overflow() is
+ * true the position gives the size needed to encode everything.
+ */
+
+#include <proton/codec.h>
+#include <proton/types.h>
+
+#include "encodings.h"
+
+#include <string.h>
+
+typedef struct pni_emitter_t {
+  char *output;
+  size_t size;
+  size_t position;
+} pni_emitter_t;
+
+/* State for the list currently being emitted */
+typedef struct pni_compound_t {
+  size_t start;                 /* Position of the list size */
+  uint32_t count;
+  uint32_t null_count;          /* Nulls not written yet, omitted if trailing */
+} pni_compound_t;
+
+static inline pni_emitter_t pni_emitter(pn_rwbytes_t output)
+{
+  pni_emitter_t emitter = {output.start, output.size, 0};
+  return emitter;
+}
+
+static inline bool pni_emitter_overflow(pni_emitter_t *emitter)
+{
+  return emitter->position > emitter->size;
+}
+
+/* A compound for values that are not in a list: nothing to count and nulls
+ * are written straight away */
+static inline pni_compound_t pni_emitter_top(void)
+{
+  pni_compound_t top = {0, 0, 0};
+  return top;
+}
+
+static inline void pni_emitter_writef8(pni_emitter_t *emitter, uint8_t value)
+{
+  if (emitter->position + 1 <= emitter->size) {
+    emitter->output[emitter->position] = value;
+  }
+  emitter->position += 1;
+}
+
+static inline void pni_emitter_writef32(pni_emitter_t *emitter, uint32_t value)
+{
+  if (emitter->position + 4 <= emitter->size) {
+    char *p = emitter->output + emitter->position;
+    p[0] = 0xFF & (value >> 24);
+    p[1] = 0xFF & (value >> 16);
+    p[2] = 0xFF & (value >>  8);
+    p[3] = 0xFF & (value      );
+  }
+  emitter->position += 4;
+}
+
+static inline void pni_emitter_writef64(pni_emitter_t *emitter, uint64_t value)
+{
+  pni_emitter_writef32(emitter, (uint32_t)(value >> 32));
+  pni_emitter_writef32(emitter, (uint32_t)value);
+}
+
+static inline void pni_emitter_raw(pni_emitter_t *emitter, const char *bytes, size_t size)
+{
+  if (emitter->position + size <= emitter->size) {
+    memcpy(emitter->output + emitter->position, bytes, size);
+  }
+  emitter->position += size;
+}
+
+/* Write out any nulls held back, the next value is not trailing */
+static inline void pni_emitter_element(pni_emitter_t *emitter, pni_compound_t *compound)
+{
+  for (; compound->null_count; --compound->null_count) {
+    pni_emitter_writef8(emitter, PNE_NULL);
+    compound->count++;
+  }
+  compound->count++;
+}
+
+static inline void pni_emit_null(pni_emitter_t *emitter, pni_compound_t *compound)
+{
+  if (compound->start) {
+    compound->null_count++;
+  } else {
+    pni_emitter_writef8(emitter, PNE_NULL);
+  }
+}
+
+static inline void pni_emit_bool(pni_emitter_t *emitter, pni_compound_t *compound, bool value)
+{
+  pni_emitter_element(emitter, compound);
+  pni_emitter_writef8(emitter, value ? PNE_TRUE : PNE_FALSE);
+}
+
+static inline void pni_emit_uint(pni_emitter_t *emitter, pni_compound_t *compound, uint32_t value)
+{
+  pni_emitter_element(emitter, compound);
+  if (value < 256) {
+    pni_emitter_writef8(emitter, PNE_SMALLUINT);
+    pni_emitter_writef8(emitter, value);
+  } else {
+    pni_emitter_writef8(emitter, PNE_UINT);
+    pni_emitter_writef32(emitter, value);
+  }
+}
+
+static inline void pni_emit_ulong(pni_emitter_t *emitter, pni_compound_t *compound, uint64_t value)
+{
+  pni_emitter_element(emitter, compound);
+  if (value < 256) {
+    pni_emitter_writef8(emitter, PNE_SMALLULONG);
+    pni_emitter_writef8(emitter, value);
+  } else {
+    pni_emitter_writef8(emitter, PNE_ULONG);
+    pni_emitter_writef64(emitter, value);
+  }
+}
+
+static inline void pni_emit_binary(pni_emitter_t *emitter, pni_compound_t *compound, pn_bytes_t value)
+{
+  pni_emitter_element(emitter, compound);
+  if (value.size < 256) {
+    pni_emitter_writef8(emitter, PNE_VBIN8);
+    pni_emitter_writef8(emitter, value.size);
+  } else {
+    pni_emitter_writef8(emitter, PNE_VBIN32);
+    pni_emitter_writef32(emitter, value.size);
+  }
+  pni_emitter_raw(emitter, value.start, value.size);
+}
+
+/* Start a described value in compound, emit the value itself into the
+ * returned compound */
+static inline pni_compound_t pni_emit_descriptor(pni_emitter_t *emitter, pni_compound_t *compound, uint64_t code)
+{
+  pni_emitter_element(emitter, compound);
+  pni_emitter_writef8(emitter, PNE_DESCRIPTOR);
+  pni_compound_t described = pni_emitter_top();
+  pni_emit_ulong(emitter, &described, code);
+  return described;
+}
+
+static inline pni_compound_t pni_emit_list(pni_emitter_t *emitter, pni_compound_t *compound)
+{
+  pni_emitter_element(emitter, compound);
+  pni_emitter_writef8(emitter, PNE_LIST32);
+  pni_compound_t list = {emitter->position, 0, 0};
+  emitter->position += 8;       /* Size and count are filled in at the end */
+  return list;
+}
+
+static inline void pni_emit_end_list(pni_emitter_t *emitter, pni_compound_t *list)
+{
+  if (list->count == 0) {
+    emitter->position = list->start - 1;
+    pni_emitter_writef8(emitter, PNE_LIST0);
+    return;
+  }
+  size_t end = emitter->position;
+  emitter->position = list->start;
+  pni_emitter_writef32(emitter, end - list->start - 4);
+  pni_emitter_writef32(emitter, list->count);
+  emitter->position = end;
+}
+
+/* Encode the value in data, or null if data is empty */
+static inline void pni_emit_copy(pni_emitter_t *emitter, pni_compound_t *compound, pn_data_t *data)
+{
+  if (!data || pn_data_size(data) == 0) {
+    pni_emit_null(emitter, compound);
+    return;
+  }
+  pni_emitter_element(emitter, compound);
+  ssize_t size = pn_data_encoded_size(data);
+  if (size > 0) {
+    if (emitter->position + size <= emitter->size) {
+      pn_data_encode(data, emitter->output + emitter->position, size);
+    }
+    emitter->position += size;
+  }
+}
+
+#endif /* emitters.h */
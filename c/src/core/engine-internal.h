@@ -63,9 +63,20 @@ typedef struct {
   bool init;
 } pn_delivery_state_t;
 
+/* In-flight deliveries of a session by delivery-id. Ids are allocated in
+   sequence, so the deliveries with ids from first up to next are kept in a
+   ring indexed by the low bits of the id, with room for at least next - first
+   entries. When the ring is full but mostly empty, the deliveries at its low
+   end are moved to the stragglers hash rather than growing it, so deliveries
+   that stay unsettled do not keep the ring as large as the span of ids sent
+   or received since. */
 typedef struct {
+  pn_delivery_t **deliveries;
+  size_t capacity;              /* power of 2, or 0 */
+  size_t size;                  /* deliveries in the map */
+  pn_sequence_t first;          /* no deliveries in the ring before this id */
   pn_sequence_t next;
-  pn_hash_t *deliveries;
+  pn_hash_t *stragglers;        /* deliveries with ids before first, or NULL */
 } pn_delivery_map_t;
 
 typedef struct {
@@ -76,6 +87,15 @@ typedef struct {
   pn_sequence_t link_credit;
 } pn_link_state_t;
 
+// A batchable disposition waiting to be sent in a ranged DISPOSITION
+typedef struct {
+  uint64_t code;
+  pn_sequence_t id;
+  uint32_t seq;                 // Order posted, for dispositions of the same id
+  bool settled;
+  bool type;                    // Role
+} pni_disp_t;
+
 typedef struct {
   // XXX: stop using negative numbers
   uint16_t local_channel;
@@ -91,12 +111,9 @@ typedef struct {
   pn_hash_t *local_handles;
   pn_hash_t *remote_handles;
 
-  uint64_t disp_code;
-  bool disp_settled;
-  bool disp_type;
-  pn_sequence_t disp_first;
-  pn_sequence_t disp_last;
-  bool disp;
+  pni_disp_t *disps;
+  size_t disp_count;
+  size_t disp_capacity;
 } pn_session_state_t;
 
 typedef struct pn_io_layer_t {
@@ -175,14 +192,16 @@ struct pn_transport_t {
   uint64_t output_frames_ct;
   uint64_t input_frames_ct;
 
-  /* output buffered for send */
+  /* output buffered for send, output_pending bytes from output_start */
   #define PN_TRANSPORT_INITIAL_BUFFER_SIZE (16*1024)
   size_t output_size;
+  size_t output_start;
   size_t output_pending;
   char *output_buf;
 
-  /* input from peer */
+  /* input from peer, input_pending bytes from input_start */
   size_t input_size;
+  size_t input_start;
   size_t input_pending;
   char *input_buf;
 
@@ -248,6 +267,7 @@ struct pn_connection_t {
   pn_collector_t *collector;
   pn_record_t *context;
   pn_list_t *delivery_pool;
+  size_t delivery_pool_max;
   struct pn_connection_driver_t *driver;
 };
 
@@ -322,11 +342,20 @@ struct pn_disposition_t {
   bool settled;
 };
 
+/* Size of the storage inside pn_delivery_t for the tag and payload. Build with
+   -DPN_DELIVERY_INLINE_PAYLOAD=N to change the payload size. */
+#ifndef PN_DELIVERY_INLINE_TAG
+#define PN_DELIVERY_INLINE_TAG 32   /* Longest tag allowed by AMQP */
+#endif
+#ifndef PN_DELIVERY_INLINE_PAYLOAD
+#define PN_DELIVERY_INLINE_PAYLOAD 256
+#endif
+
 struct pn_delivery_t {
   pn_disposition_t local;
   pn_disposition_t remote;
   pn_link_t *link;  // reference counted
-  pn_buffer_t *tag;
+  pn_buffer_t tag;
   pn_delivery_t *unsettled_next;
   pn_delivery_t *unsettled_prev;
   pn_delivery_t *work_next;
@@ -334,7 +363,7 @@ struct pn_delivery_t {
   pn_delivery_t *tpwork_next;
   pn_delivery_t *tpwork_prev;
   pn_delivery_state_t state;
-  pn_buffer_t *bytes;
+  pn_buffer_t bytes;
   pn_record_t *context;
   bool updated;
   bool settled; // tracks whether we're in the unsettled list or not
@@ -343,6 +372,9 @@ struct pn_delivery_t {
   bool done;
   bool referenced;
   bool aborted;
+  /* Initial storage for tag and bytes, they only allocate when they outgrow it */
+  char tag_inline[PN_DELIVERY_INLINE_TAG];
+  char bytes_inline[PN_DELIVERY_INLINE_PAYLOAD];
 };
 
 #define PN_SET_LOCAL(OLD, NEW)                                          \
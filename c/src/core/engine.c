@@ -195,6 +195,22 @@ void pn_connection_set_context(pn_connection_t *conn, void *context)
   pn_record_set(conn->context, PN_LEGCTX, context);
 }
 
+void pn_connection_set_delivery_pool_max(pn_connection_t *connection, size_t max)
+{
+  assert(connection);
+  connection->delivery_pool_max = max;
+  size_t size = pn_list_size(connection->delivery_pool);
+  if (size > max) {
+    pn_list_del(connection->delivery_pool, max, size - max);
+  }
+}
+
+size_t pn_connection_get_delivery_pool_max(pn_connection_t *connection)
+{
+  assert(connection);
+  return connection->delivery_pool_max;
+}
+
 pn_transport_t *pn_connection_transport(pn_connection_t *connection)
 {
   assert(connection);
@@ -537,6 +553,7 @@ pn_connection_t *pn_connection()
   conn->collector = NULL;
   conn->context = pn_record();
   conn->delivery_pool = pn_list(PN_OBJECT, 0);
+  conn->delivery_pool_max = SIZE_MAX;
   conn->driver = NULL;
 
   return conn;
@@ -950,6 +967,7 @@ static void pn_session_finalize(void *object)
   pni_endpoint_tini(endpoint);
   pn_delivery_map_free(&session->state.incoming);
   pn_delivery_map_free(&session->state.outgoing);
+  free(session->state.disps);
   pn_free(session->state.local_handles);
   pn_free(session->state.remote_handles);
   pni_remove_session(session->connection, session);
@@ -1409,7 +1427,7 @@ static void pn_disposition_finalize(pn_disposition_t *ds)
 {
   pn_free(ds->data);
   pn_free(ds->annotations);
-  pn_condition_tini(&ds->condition);
+  if (ds->condition.name) pn_condition_tini(&ds->condition);
 }
 
 static void pn_delivery_incref(void *object)
@@ -1452,13 +1470,17 @@ static void pn_delivery_finalize(void *object)
                         ? &link->session->state.outgoing
                         : &link->session->state.incoming,
                         delivery);
-    pn_buffer_clear(delivery->tag);
-    pn_buffer_clear(delivery->bytes);
-    pn_record_clear(delivery->context);
+    // Go back to the inline storage so that a pooled delivery does not keep
+    // the memory of a large payload
+    pn_buffer_tini(&delivery->tag);
+    pn_buffer_tini(&delivery->bytes);
+    pn_buffer_init(&delivery->tag, delivery->tag_inline, sizeof(delivery->tag_inline));
+    pn_buffer_init(&delivery->bytes, delivery->bytes_inline, sizeof(delivery->bytes_inline));
+    if (delivery->context) pn_record_clear(delivery->context);
     delivery->settled = true;
     pn_connection_t *conn = link->session->connection;
     assert(pn_refcount(delivery) == 0);
-    if (pni_connection_live(conn)) {
+    if (pni_connection_live(conn) && pn_list_size(conn->delivery_pool) < conn->delivery_pool_max) {
       pn_list_t *pool = link->session->connection->delivery_pool;
       delivery->link = NULL;
       pn_list_add(pool, delivery);
@@ -1469,8 +1491,8 @@ static void pn_delivery_finalize(void *object)
 
   if (!pooled) {
     pn_free(delivery->context);
-    pn_buffer_free(delivery->tag);
-    pn_buffer_free(delivery->bytes);
+    pn_buffer_tini(&delivery->tag);
+    pn_buffer_tini(&delivery->bytes);
     pn_disposition_finalize(&delivery->local);
     pn_disposition_finalize(&delivery->remote);
   }
@@ -1480,11 +1502,15 @@ static void pn_delivery_finalize(void *object)
   }
 }
 
+// The data, annotations and condition are only created when first used, most
+// deliveries never need them.
 static void pn_disposition_init(pn_disposition_t *ds)
 {
-  ds->data = pn_data(0);
-  ds->annotations = pn_data(0);
-  pn_condition_init(&ds->condition);
+  ds->data = NULL;
+  ds->annotations = NULL;
+  ds->condition.name = NULL;
+  ds->condition.description = NULL;
+  ds->condition.info = NULL;
 }
 
 static void pn_disposition_clear(pn_disposition_t *ds)
@@ -1495,9 +1521,9 @@ static void pn_disposition_clear(pn_disposition_t *ds)
   ds->failed = false;
   ds->undeliverable = false;
   ds->settled = false;
-  pn_data_clear(ds->data);
-  pn_data_clear(ds->annotations);
-  pn_condition_clear(&ds->condition);
+  if (ds->data) pn_data_clear(ds->data);
+  if (ds->annotations) pn_data_clear(ds->annotations);
+  if (ds->condition.name) pn_condition_clear(&ds->condition);
 }
 
 #define pn_delivery_new pn_object_new
@@ -1512,7 +1538,7 @@ static void pn_disposition_clear(pn_disposition_t *ds)
 int pn_delivery_inspect(void *obj, pn_string_t *dst) {
   pn_delivery_t *d = (pn_delivery_t*)obj;
   const char* dir = pn_link_is_sender(d->link) ? "sending" : "receiving";
-  pn_bytes_t bytes = pn_buffer_bytes(d->tag);
+  pn_bytes_t bytes = pn_buffer_bytes(&d->tag);
   int err =
     pn_string_addf(dst, "pn_delivery<%p>{%s, tag=b\"", obj, dir) ||
     pn_quote(dst, bytes.start, bytes.size) ||
@@ -1536,18 +1562,18 @@ pn_delivery_t *pn_delivery(pn_link_t *link, pn_delivery_tag_t tag)
     static const pn_class_t clazz = PN_METACLASS(pn_delivery);
     delivery = (pn_delivery_t *) pn_class_new(&clazz, sizeof(pn_delivery_t));
     if (!delivery) return NULL;
-    delivery->tag = pn_buffer(16);
-    delivery->bytes = pn_buffer(64);
+    pn_buffer_init(&delivery->tag, delivery->tag_inline, sizeof(delivery->tag_inline));
+    pn_buffer_init(&delivery->bytes, delivery->bytes_inline, sizeof(delivery->bytes_inline));
     pn_disposition_init(&delivery->local);
     pn_disposition_init(&delivery->remote);
-    delivery->context = pn_record();
+    delivery->context = NULL;
   } else {
     assert(!delivery->state.init);
   }
   delivery->link = link;
   pn_incref(delivery->link);  // keep link until finalized
-  pn_buffer_clear(delivery->tag);
-  pn_buffer_append(delivery->tag, tag.start, tag.size);
+  pn_buffer_clear(&delivery->tag);
+  pn_buffer_append(&delivery->tag, tag.start, tag.size);
   pn_disposition_clear(&delivery->local);
   pn_disposition_clear(&delivery->remote);
   delivery->updated = false;
@@ -1560,10 +1586,9 @@ pn_delivery_t *pn_delivery(pn_link_t *link, pn_delivery_tag_t tag)
   delivery->tpwork_next = NULL;
   delivery->tpwork_prev = NULL;
   delivery->tpwork = false;
-  pn_buffer_clear(delivery->bytes);
+  pn_buffer_clear(&delivery->bytes);
   delivery->done = false;
   delivery->aborted = false;
-  pn_record_clear(delivery->context);
 
   // begin delivery state
   delivery->state.init = false;
@@ -1593,7 +1618,7 @@ bool pn_delivery_buffered(pn_delivery_t *delivery)
     if (state->sent) {
       return false;
     } else {
-      return delivery->done || (pn_buffer_size(delivery->bytes) > 0);
+      return delivery->done || (pn_buffer_size(&delivery->bytes) > 0);
     }
   } else {
     return false;
@@ -1632,7 +1657,7 @@ bool pn_delivery_current(pn_delivery_t *delivery)
 void pn_delivery_dump(pn_delivery_t *d)
 {
   char tag[1024];
-  pn_bytes_t bytes = pn_buffer_bytes(d->tag);
+  pn_bytes_t bytes = pn_buffer_bytes(&d->tag);
   pn_quote_data(tag, 1024, bytes.start, bytes.size);
   printf("{tag=%s, local.type=%" PRIu64 ", remote.type=%" PRIu64 ", local.settled=%u, "
          "remote.settled=%u, updated=%u, current=%u, writable=%u, readable=%u, "
@@ -1645,18 +1670,19 @@ void pn_delivery_dump(pn_delivery_t *d)
 void *pn_delivery_get_context(pn_delivery_t *delivery)
 {
   assert(delivery);
-  return pn_record_get(delivery->context, PN_LEGCTX);
+  return delivery->context ? pn_record_get(delivery->context, PN_LEGCTX) : NULL;
 }
 
 void pn_delivery_set_context(pn_delivery_t *delivery, void *context)
 {
   assert(delivery);
-  pn_record_set(delivery->context, PN_LEGCTX, context);
+  pn_record_set(pn_delivery_attachments(delivery), PN_LEGCTX, context);
 }
 
 pn_record_t *pn_delivery_attachments(pn_delivery_t *delivery)
 {
   assert(delivery);
+  if (!delivery->context) delivery->context = pn_record();
   return delivery->context;
 }
 
@@ -1669,6 +1695,7 @@ uint64_t pn_disposition_type(pn_disposition_t *disposition)
 pn_data_t *pn_disposition_data(pn_disposition_t *disposition)
 {
   assert(disposition);
+  if (!disposition->data) disposition->data = pn_data(0);
   return disposition->data;
 }
 
@@ -1723,19 +1750,21 @@ void pn_disposition_set_undeliverable(pn_disposition_t *disposition, bool undeli
 pn_data_t *pn_disposition_annotations(pn_disposition_t *disposition)
 {
   assert(disposition);
+  if (!disposition->annotations) disposition->annotations = pn_data(0);
   return disposition->annotations;
 }
 
 pn_condition_t *pn_disposition_condition(pn_disposition_t *disposition)
 {
   assert(disposition);
+  if (!disposition->condition.name) pn_condition_init(&disposition->condition);
   return &disposition->condition;
 }
 
 pn_delivery_tag_t pn_delivery_tag(pn_delivery_t *delivery)
 {
   if (delivery) {
-    pn_bytes_t tag = pn_buffer_bytes(delivery->tag);
+    pn_bytes_t tag = pn_buffer_bytes(&delivery->tag);
     return pn_dtag(tag.start, tag.size);
   } else {
     return pn_dtag(0, 0);
@@ -1772,8 +1801,8 @@ static void pni_advance_receiver(pn_link_t *link)
   link->session->incoming_deliveries--;
 
   pn_delivery_t *current = link->current;
-  link->session->incoming_bytes -= pn_buffer_size(current->bytes);
-  pn_buffer_clear(current->bytes);
+  link->session->incoming_bytes -= pn_buffer_size(&current->bytes);
+  pn_buffer_clear(&current->bytes);
 
   if (!link->session->state.incoming_window) {
     pni_add_tpwork(current);
@@ -1879,6 +1908,21 @@ void pn_delivery_settle(pn_delivery_t *delivery)
   }
 }
 
+void pn_delivery_settle_upto(pn_delivery_t *delivery, uint64_t state)
+{
+  assert(delivery);
+  if (delivery->local.settled) return;
+  pn_delivery_t *d = pn_unsettled_head(delivery->link);
+  while (d) {
+    pn_delivery_t *next = pn_unsettled_next(d);
+    bool last = (d == delivery);
+    if (state) pn_delivery_update(d, state);
+    pn_delivery_settle(d);
+    if (last) break;
+    d = next;
+  }
+}
+
 void pn_link_offered(pn_link_t *sender, int credit)
 {
   sender->available = credit;
@@ -1889,7 +1933,7 @@ ssize_t pn_link_send(pn_link_t *sender, const char *bytes, size_t n)
   pn_delivery_t *current = pn_link_current(sender);
   if (!current) return PN_EOS;
   if (!bytes || !n) return 0;
-  pn_buffer_append(current->bytes, bytes, n);
+  pn_buffer_append(&current->bytes, bytes, n);
   sender->session->outgoing_bytes += n;
   pni_add_tpwork(current);
   return n;
@@ -1921,8 +1965,8 @@ ssize_t pn_link_recv(pn_link_t *receiver, char *bytes, size_t n)
   pn_delivery_t *delivery = receiver->current;
   if (!delivery) return PN_STATE_ERR;
   if (delivery->aborted) return PN_ABORTED;
-  size_t size = pn_buffer_get(delivery->bytes, 0, n, bytes);
-  pn_buffer_trim(delivery->bytes, size, 0);
+  size_t size = pn_buffer_get(&delivery->bytes, 0, n, bytes);
+  pn_buffer_trim(&delivery->bytes, size, 0);
   if (size) {
     receiver->session->incoming_bytes -= size;
     if (!receiver->session->state.incoming_window) {
@@ -2065,7 +2109,7 @@ size_t pn_delivery_pending(pn_delivery_t *delivery)
      the PN_ABORTED error return code.
   */
   if (delivery->aborted) return 1;
-  return pn_buffer_size(delivery->bytes);
+  return pn_buffer_size(&delivery->bytes);
 }
 
 bool pn_delivery_partial(pn_delivery_t *delivery)
@@ -85,7 +85,15 @@ ssize_t pn_read_frame(pn_frame_t *frame, const char *bytes, size_t available, ui
 
 size_t pn_write_frame(pn_buffer_t* buffer, pn_frame_t frame)
 {
-  size_t size = AMQP_HEADER_SIZE + frame.ex_size + frame.size;
+  return pn_write_frame_gather(buffer, frame, pn_bytes(0, NULL));
+}
+
+// Write a frame whose body is frame.payload followed by more, so that a
+// separately held body section does not need to be copied next to the payload
+// first.
+size_t pn_write_frame_gather(pn_buffer_t* buffer, pn_frame_t frame, pn_bytes_t more)
+{
+  size_t size = AMQP_HEADER_SIZE + frame.ex_size + frame.size + more.size;
   if (size <= pn_buffer_available(buffer))
   {
     // Prepare header
@@ -101,6 +109,8 @@ size_t pn_write_frame(pn_buffer_t* buffer, pn_frame_t frame)
     if (frame.extended)
         pn_buffer_append(buffer, frame.extended, frame.ex_size);
     pn_buffer_append(buffer, frame.payload, frame.size);
+    if (more.size)
+        pn_buffer_append(buffer, more.start, more.size);
     return size;
   } else {
     return 0;
@@ -43,5 +43,6 @@ typedef struct {
 
 ssize_t pn_read_frame(pn_frame_t *frame, const char *bytes, size_t available, uint32_t max);
 size_t pn_write_frame(pn_buffer_t* buffer, pn_frame_t frame);
+size_t pn_write_frame_gather(pn_buffer_t* buffer, pn_frame_t frame, pn_bytes_t more);
 
 #endif /* framing.h */
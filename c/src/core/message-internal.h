@@ -28,6 +28,24 @@ extern "C" {
 
 /** @cond INTERNAL */
 
+/** Sections decoded on demand after pn_message_decode_lazy() */
+typedef enum {
+  PNI_MSG_HEADER,
+  PNI_MSG_PROPERTIES,
+  PNI_MSG_INSTRUCTIONS,
+  PNI_MSG_ANNOTATIONS,
+  PNI_MSG_APPLICATION_PROPERTIES,
+  PNI_MSG_BODY,
+  PNI_MSG_SECTIONS
+} pni_msg_section_t;
+
+/**
+ * Decode a section of a message from pn_message_decode_lazy() if it has not
+ * been used yet. Return 0, or an error code for as long as the section's
+ * content could not be decoded. The error text is in pn_message_error().
+ */
+PN_EXTERN int pni_message_check_section(pn_message_t *msg, pni_msg_section_t section);
+
 /** Construct a message with extra storage */
 PN_EXTERN pn_message_t * pni_message_with_extra(size_t extra);
 
@@ -21,6 +21,7 @@
 
 #include "platform/platform_fmt.h"
 
+#include "consumers.h"
 #include "max_align.h"
 #include "message-internal.h"
 #include "protocol.h"
@@ -59,11 +60,19 @@ struct pn_message_t {
 
   pn_error_t *error;
 
+  /* Copy of the bytes given to pn_message_decode_lazy(), and the last
+     encoded section of each kind */
+  char *encoded;
+  size_t encoded_capacity;
+  pn_bytes_t sections[PNI_MSG_SECTIONS];
+
   pn_sequence_t group_sequence;
   pn_millis_t ttl;
   uint32_t delivery_count;
 
   uint8_t priority;
+  uint8_t pending;              /* Bit for each section not decoded yet */
+  uint8_t failed;               /* Bit for each section whose content could not be decoded */
 
   bool durable;
   bool first_acquirer;
@@ -89,11 +98,49 @@ void pn_message_finalize(void *obj)
   pn_data_free(msg->properties);
   pn_data_free(msg->body);
   pn_error_free(msg->error);
+  free(msg->encoded);
+}
+
+static ssize_t pni_message_decode_section(pn_message_t *msg, const char *bytes, size_t size);
+
+static int pni_message_load(pn_message_t *msg, pni_msg_section_t section)
+{
+  msg->pending &= ~(1u << section);
+  pn_bytes_t bytes = msg->sections[section];
+  ssize_t used = pni_message_decode_section(msg, bytes.start, bytes.size);
+  if (used >= 0) return 0;
+  msg->failed |= 1u << section;
+  return (int)used;
+}
+
+/* Decode a section of a lazily decoded message before it is used. Return the
+   error if its content is bad, which is also set in msg->error. */
+static inline int pni_message_ensure(pn_message_t *msg, pni_msg_section_t section)
+{
+  return (msg->pending & (1u << section)) ? pni_message_load(msg, section) : 0;
+}
+
+int pni_message_check_section(pn_message_t *msg, pni_msg_section_t section)
+{
+  int err = pni_message_ensure(msg, section);
+  if (!err && (msg->failed & (1u << section))) {
+    err = pn_error_code(msg->error);
+    if (!err) err = PN_ERR;
+  }
+  return err;
+}
+
+static void pni_message_ensure_all(pn_message_t *msg)
+{
+  for (int section = 0; msg->pending && section < PNI_MSG_SECTIONS; ++section) {
+    pni_message_ensure(msg, (pni_msg_section_t)section);
+  }
 }
 
 int pn_message_inspect(void *obj, pn_string_t *dst)
 {
   pn_message_t *msg = (pn_message_t *) obj;
+  pni_message_ensure_all(msg);
   int err = pn_string_addf(dst, "Message{");
   if (err) return err;
 
@@ -336,6 +383,10 @@ static pn_message_t *pni_message_new(size_t size)
   msg->body = pn_data(16);
 
   msg->error = pn_error();
+  msg->encoded = NULL;
+  msg->encoded_capacity = 0;
+  msg->pending = 0;
+  msg->failed = 0;
   return msg;
 }
 
@@ -388,6 +439,8 @@ void pn_message_clear(pn_message_t *msg)
   pn_data_clear(msg->annotations);
   pn_data_clear(msg->properties);
   pn_data_clear(msg->body);
+  msg->pending = 0;
+  msg->failed = 0;
 }
 
 int pn_message_errno(pn_message_t *msg)
@@ -411,6 +464,7 @@ bool pn_message_is_inferred(pn_message_t *msg)
 int pn_message_set_inferred(pn_message_t *msg, bool inferred)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_BODY);
   msg->inferred = inferred;
   return 0;
 }
@@ -418,11 +472,13 @@ int pn_message_set_inferred(pn_message_t *msg, bool inferred)
 bool pn_message_is_durable(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   return msg->durable;
 }
 int pn_message_set_durable(pn_message_t *msg, bool durable)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   msg->durable = durable;
   return 0;
 }
@@ -431,11 +487,13 @@ int pn_message_set_durable(pn_message_t *msg, bool durable)
 uint8_t pn_message_get_priority(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   return msg->priority;
 }
 int pn_message_set_priority(pn_message_t *msg, uint8_t priority)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   msg->priority = priority;
   return 0;
 }
@@ -443,11 +501,13 @@ int pn_message_set_priority(pn_message_t *msg, uint8_t priority)
 pn_millis_t pn_message_get_ttl(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   return msg->ttl;
 }
 int pn_message_set_ttl(pn_message_t *msg, pn_millis_t ttl)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   msg->ttl = ttl;
   return 0;
 }
@@ -455,11 +515,13 @@ int pn_message_set_ttl(pn_message_t *msg, pn_millis_t ttl)
 bool pn_message_is_first_acquirer(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   return msg->first_acquirer;
 }
 int pn_message_set_first_acquirer(pn_message_t *msg, bool first)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   msg->first_acquirer = first;
   return 0;
 }
@@ -467,11 +529,13 @@ int pn_message_set_first_acquirer(pn_message_t *msg, bool first)
 uint32_t pn_message_get_delivery_count(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   return msg->delivery_count;
 }
 int pn_message_set_delivery_count(pn_message_t *msg, uint32_t count)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_HEADER);
   msg->delivery_count = count;
   return 0;
 }
@@ -479,16 +543,19 @@ int pn_message_set_delivery_count(pn_message_t *msg, uint32_t count)
 pn_data_t *pn_message_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return msg->id;
 }
 pn_atom_t pn_message_get_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_data_get_atom(msg->id);
 }
 int pn_message_set_id(pn_message_t *msg, pn_atom_t id)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   pn_data_rewind(msg->id);
   return pn_data_put_atom(msg->id, id);
 }
@@ -506,60 +573,71 @@ static int pn_string_set_bytes(pn_string_t *string, pn_bytes_t bytes)
 pn_bytes_t pn_message_get_user_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get_bytes(msg->user_id);
 }
 int pn_message_set_user_id(pn_message_t *msg, pn_bytes_t user_id)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set_bytes(msg->user_id, user_id);
 }
 
 const char *pn_message_get_address(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->address);
 }
 int pn_message_set_address(pn_message_t *msg, const char *address)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->address, address);
 }
 
 const char *pn_message_get_subject(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->subject);
 }
 int pn_message_set_subject(pn_message_t *msg, const char *subject)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->subject, subject);
 }
 
 const char *pn_message_get_reply_to(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->reply_to);
 }
 int pn_message_set_reply_to(pn_message_t *msg, const char *reply_to)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->reply_to, reply_to);
 }
 
 pn_data_t *pn_message_correlation_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return msg->correlation_id;
 }
 pn_atom_t pn_message_get_correlation_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_data_get_atom(msg->correlation_id);
 }
 int pn_message_set_correlation_id(pn_message_t *msg, pn_atom_t atom)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   pn_data_rewind(msg->correlation_id);
   return pn_data_put_atom(msg->correlation_id, atom);
 }
@@ -567,33 +645,39 @@ int pn_message_set_correlation_id(pn_message_t *msg, pn_atom_t atom)
 const char *pn_message_get_content_type(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->content_type);
 }
 int pn_message_set_content_type(pn_message_t *msg, const char *type)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->content_type, type);
 }
 
 const char *pn_message_get_content_encoding(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->content_encoding);
 }
 int pn_message_set_content_encoding(pn_message_t *msg, const char *encoding)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->content_encoding, encoding);
 }
 
 pn_timestamp_t pn_message_get_expiry_time(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return msg->expiry_time;
 }
 int pn_message_set_expiry_time(pn_message_t *msg, pn_timestamp_t time)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   msg->expiry_time = time;
   return 0;
 }
@@ -601,11 +685,13 @@ int pn_message_set_expiry_time(pn_message_t *msg, pn_timestamp_t time)
 pn_timestamp_t pn_message_get_creation_time(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return msg->creation_time;
 }
 int pn_message_set_creation_time(pn_message_t *msg, pn_timestamp_t time)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   msg->creation_time = time;
   return 0;
 }
@@ -613,22 +699,26 @@ int pn_message_set_creation_time(pn_message_t *msg, pn_timestamp_t time)
 const char *pn_message_get_group_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->group_id);
 }
 int pn_message_set_group_id(pn_message_t *msg, const char *group_id)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->group_id, group_id);
 }
 
 pn_sequence_t pn_message_get_group_sequence(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return msg->group_sequence;
 }
 int pn_message_set_group_sequence(pn_message_t *msg, pn_sequence_t n)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   msg->group_sequence = n;
   return 0;
 }
@@ -636,14 +726,126 @@ int pn_message_set_group_sequence(pn_message_t *msg, pn_sequence_t n)
 const char *pn_message_get_reply_to_group_id(pn_message_t *msg)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_get(msg->reply_to_group_id);
 }
 int pn_message_set_reply_to_group_id(pn_message_t *msg, const char *reply_to_group_id)
 {
   assert(msg);
+  pni_message_ensure(msg, PNI_MSG_PROPERTIES);
   return pn_string_set(msg->reply_to_group_id, reply_to_group_id);
 }
 
+/* Decode the first section in bytes into the message, returns the bytes used */
+static ssize_t pni_message_decode_section(pn_message_t *msg, const char *bytes, size_t size)
+{
+  pn_data_clear(msg->data);
+  ssize_t used = pn_data_decode(msg->data, bytes, size);
+  if (used < 0)
+      return pn_error_format(msg->error, used, "data error: %s",
+                             pn_error_text(pn_data_error(msg->data)));
+  bool scanned;
+  uint64_t desc;
+  int err = pn_data_scan(msg->data, "D?L.", &scanned, &desc);
+  if (err) return pn_error_format(msg->error, err, "data error: %s",
+                                  pn_error_text(pn_data_error(msg->data)));
+  if (!scanned) {
+    desc = 0;
+  }
+
+  pn_data_rewind(msg->data);
+  pn_data_next(msg->data);
+  pn_data_enter(msg->data);
+  pn_data_next(msg->data);
+
+  switch (desc) {
+  case HEADER: {
+    bool priority_q;
+    uint8_t priority;
+    err = pn_data_scan(msg->data, "D.[o?BIoI]",
+                       &msg->durable,
+                       &priority_q, &priority,
+                       &msg->ttl,
+                       &msg->first_acquirer,
+                       &msg->delivery_count);
+    if (err) return pn_error_format(msg->error, err, "data error: %s",
+                                    pn_error_text(pn_data_error(msg->data)));
+    msg->priority = priority_q ? priority : HEADER_PRIORITY_DEFAULT;
+    break;
+  }
+  case PROPERTIES:
+    {
+      pn_bytes_t user_id, address, subject, reply_to, ctype, cencoding,
+        group_id, reply_to_group_id;
+      pn_data_clear(msg->id);
+      pn_data_clear(msg->correlation_id);
+      err = pn_data_scan(msg->data, "D.[CzSSSCssttSIS]", msg->id,
+                         &user_id, &address, &subject, &reply_to,
+                         msg->correlation_id, &ctype, &cencoding,
+                         &msg->expiry_time, &msg->creation_time, &group_id,
+                         &msg->group_sequence, &reply_to_group_id);
+      if (err) return pn_error_format(msg->error, err, "data error: %s",
+                                      pn_error_text(pn_data_error(msg->data)));
+      err = pn_string_set_bytes(msg->user_id, user_id);
+      if (err) return pn_error_format(msg->error, err, "error setting user_id");
+      err = pn_string_setn(msg->address, address.start, address.size);
+      if (err) return pn_error_format(msg->error, err, "error setting address");
+      err = pn_string_setn(msg->subject, subject.start, subject.size);
+      if (err) return pn_error_format(msg->error, err, "error setting subject");
+      err = pn_string_setn(msg->reply_to, reply_to.start, reply_to.size);
+      if (err) return pn_error_format(msg->error, err, "error setting reply_to");
+      err = pn_string_setn(msg->content_type, ctype.start, ctype.size);
+      if (err) return pn_error_format(msg->error, err, "error setting content_type");
+      err = pn_string_setn(msg->content_encoding, cencoding.start,
+                           cencoding.size);
+      if (err) return pn_error_format(msg->error, err, "error setting content_encoding");
+      err = pn_string_setn(msg->group_id, group_id.start, group_id.size);
+      if (err) return pn_error_format(msg->error, err, "error setting group_id");
+      err = pn_string_setn(msg->reply_to_group_id, reply_to_group_id.start,
+                           reply_to_group_id.size);
+      if (err) return pn_error_format(msg->error, err, "error setting reply_to_group_id");
+    }
+    break;
+  case DELIVERY_ANNOTATIONS:
+    pn_data_narrow(msg->data);
+    err = pn_data_copy(msg->instructions, msg->data);
+    if (err) return err;
+    break;
+  case MESSAGE_ANNOTATIONS:
+    pn_data_narrow(msg->data);
+    err = pn_data_copy(msg->annotations, msg->data);
+    if (err) return err;
+    break;
+  case APPLICATION_PROPERTIES:
+    pn_data_narrow(msg->data);
+    err = pn_data_copy(msg->properties, msg->data);
+    if (err) return err;
+    break;
+  case DATA:
+  case AMQP_SEQUENCE:
+    msg->inferred = true;
+    pn_data_narrow(msg->data);
+    err = pn_data_copy(msg->body, msg->data);
+    if (err) return err;
+    break;
+  case AMQP_VALUE:
+    msg->inferred = false;
+    pn_data_narrow(msg->data);
+    err = pn_data_copy(msg->body, msg->data);
+    if (err) return err;
+    break;
+  case FOOTER:
+    break;
+  default:
+    err = pn_data_copy(msg->body, msg->data);
+    if (err) return err;
+    break;
+  }
+
+  pn_data_clear(msg->data);
+  return used;
+}
+
 int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size)
 {
   assert(msg && bytes && size);
@@ -651,133 +853,235 @@ int pn_message_decode(pn_message_t *msg, const char *bytes, size_t size)
   pn_message_clear(msg);
 
   while (size) {
-    pn_data_clear(msg->data);
-    ssize_t used = pn_data_decode(msg->data, bytes, size);
-    if (used < 0)
-        return pn_error_format(msg->error, used, "data error: %s",
-                               pn_error_text(pn_data_error(msg->data)));
+    ssize_t used = pni_message_decode_section(msg, bytes, size);
+    if (used < 0) return used;
     size -= used;
     bytes += used;
-    bool scanned;
-    uint64_t desc;
-    int err = pn_data_scan(msg->data, "D?L.", &scanned, &desc);
-    if (err) return pn_error_format(msg->error, err, "data error: %s",
-                                    pn_error_text(pn_data_error(msg->data)));
-    if (!scanned) {
-      desc = 0;
-    }
+  }
 
-    pn_data_rewind(msg->data);
-    pn_data_next(msg->data);
-    pn_data_enter(msg->data);
-    pn_data_next(msg->data);
+  return 0;
+}
 
-    switch (desc) {
-    case HEADER: {
-      bool priority_q;
-      uint8_t priority;
-      err = pn_data_scan(msg->data, "D.[o?BIoI]",
-                         &msg->durable,
-                         &priority_q, &priority,
-                         &msg->ttl,
-                         &msg->first_acquirer,
-                         &msg->delivery_count);
-      if (err) return pn_error_format(msg->error, err, "data error: %s",
-                                      pn_error_text(pn_data_error(msg->data)));
-      msg->priority = priority_q ? priority : HEADER_PRIORITY_DEFAULT;
-      break;
-    }
-    case PROPERTIES:
-      {
-        pn_bytes_t user_id, address, subject, reply_to, ctype, cencoding,
-          group_id, reply_to_group_id;
-        pn_data_clear(msg->id);
-        pn_data_clear(msg->correlation_id);
-        err = pn_data_scan(msg->data, "D.[CzSSSCssttSIS]", msg->id,
-                           &user_id, &address, &subject, &reply_to,
-                           msg->correlation_id, &ctype, &cencoding,
-                           &msg->expiry_time, &msg->creation_time, &group_id,
-                           &msg->group_sequence, &reply_to_group_id);
-        if (err) return pn_error_format(msg->error, err, "data error: %s",
-                                        pn_error_text(pn_data_error(msg->data)));
-        err = pn_string_set_bytes(msg->user_id, user_id);
-        if (err) return pn_error_format(msg->error, err, "error setting user_id");
-        err = pn_string_setn(msg->address, address.start, address.size);
-        if (err) return pn_error_format(msg->error, err, "error setting address");
-        err = pn_string_setn(msg->subject, subject.start, subject.size);
-        if (err) return pn_error_format(msg->error, err, "error setting subject");
-        err = pn_string_setn(msg->reply_to, reply_to.start, reply_to.size);
-        if (err) return pn_error_format(msg->error, err, "error setting reply_to");
-        err = pn_string_setn(msg->content_type, ctype.start, ctype.size);
-        if (err) return pn_error_format(msg->error, err, "error setting content_type");
-        err = pn_string_setn(msg->content_encoding, cencoding.start,
-                             cencoding.size);
-        if (err) return pn_error_format(msg->error, err, "error setting content_encoding");
-        err = pn_string_setn(msg->group_id, group_id.start, group_id.size);
-        if (err) return pn_error_format(msg->error, err, "error setting group_id");
-        err = pn_string_setn(msg->reply_to_group_id, reply_to_group_id.start,
-                             reply_to_group_id.size);
-        if (err) return pn_error_format(msg->error, err, "error setting reply_to_group_id");
+int pn_message_decode_lazy(pn_message_t *msg, const char *bytes, size_t size)
+{
+  assert(msg && bytes && size);
+
+  pn_message_clear(msg);
+
+  if (msg->encoded_capacity < size) {
+    char *encoded = (char *) realloc(msg->encoded, size);
+    if (!encoded) return pn_error_format(msg->error, PN_OUT_OF_MEMORY, "error copying message");
+    msg->encoded = encoded;
+    msg->encoded_capacity = size;
+  }
+  memcpy(msg->encoded, bytes, size);
+
+  /* Only find the section boundaries here, as pn_message_decode() would see
+     them: the last section of each kind wins, and anything that is not a
+     known section is taken as the body. */
+  pni_consumer_t consumer = pni_consumer(pn_bytes(size, msg->encoded));
+  uint8_t pending = 0;
+  while (consumer.position < size) {
+    size_t start = consumer.position;
+    uint64_t desc = 0;
+    uint8_t code = pni_consumer_readf8(&consumer);
+    if (code == PNE_DESCRIPTOR) {
+      uint8_t dcode = pni_consumer_readf8(&consumer);
+      if (!pni_consumer_ulong_value(&consumer, dcode, &desc)) {
+        desc = 0;
+        pni_consumer_skip_value(&consumer, dcode);
       }
-      break;
-    case DELIVERY_ANNOTATIONS:
-      pn_data_narrow(msg->data);
-      err = pn_data_copy(msg->instructions, msg->data);
-      if (err) return err;
-      break;
-    case MESSAGE_ANNOTATIONS:
-      pn_data_narrow(msg->data);
-      err = pn_data_copy(msg->annotations, msg->data);
-      if (err) return err;
-      break;
-    case APPLICATION_PROPERTIES:
-      pn_data_narrow(msg->data);
-      err = pn_data_copy(msg->properties, msg->data);
-      if (err) return err;
-      break;
+      code = pni_consumer_readf8(&consumer);
+    }
+    pni_consumer_skip_element(&consumer, code);
+    if (!pni_consumer_ok(&consumer)) {
+      return pn_error_format(msg->error, PN_UNDERFLOW, "data error: invalid message section at %" PN_ZU, start);
+    }
+
+    pni_msg_section_t section;
+    switch (desc) {
+    case HEADER:                 section = PNI_MSG_HEADER; break;
+    case PROPERTIES:             section = PNI_MSG_PROPERTIES; break;
+    case DELIVERY_ANNOTATIONS:   section = PNI_MSG_INSTRUCTIONS; break;
+    case MESSAGE_ANNOTATIONS:    section = PNI_MSG_ANNOTATIONS; break;
+    case APPLICATION_PROPERTIES: section = PNI_MSG_APPLICATION_PROPERTIES; break;
+    case FOOTER:                 continue;
     case DATA:
     case AMQP_SEQUENCE:
       msg->inferred = true;
-      pn_data_narrow(msg->data);
-      err = pn_data_copy(msg->body, msg->data);
-      if (err) return err;
+      section = PNI_MSG_BODY;
       break;
     case AMQP_VALUE:
       msg->inferred = false;
-      pn_data_narrow(msg->data);
-      err = pn_data_copy(msg->body, msg->data);
-      if (err) return err;
-      break;
-    case FOOTER:
-      break;
-    default:
-      err = pn_data_copy(msg->body, msg->data);
-      if (err) return err;
+      section = PNI_MSG_BODY;
       break;
+    default:                     section = PNI_MSG_BODY; break;
     }
+    msg->sections[section] = pn_bytes(consumer.position - start, msg->encoded + start);
+    pending |= 1u << section;
   }
+  msg->pending = pending;
+  return 0;
+}
 
-  pn_data_clear(msg->data);
+/* The order of the sections in an encoded message */
+static const pni_msg_section_t pni_msg_encode_order[PNI_MSG_SECTIONS] = {
+  PNI_MSG_HEADER,
+  PNI_MSG_INSTRUCTIONS,
+  PNI_MSG_ANNOTATIONS,
+  PNI_MSG_PROPERTIES,
+  PNI_MSG_APPLICATION_PROPERTIES,
+  PNI_MSG_BODY
+};
+
+/* Append a section of the message to data, nothing if the section is empty */
+static int pni_message_section_data(pn_message_t *msg, pn_data_t *data, pni_msg_section_t section)
+{
+  int err = 0;
+  switch (section) {
+  case PNI_MSG_HEADER:
+    err = pn_data_fill(data, "DL[?o?B?I?o?I]", HEADER,
+                       msg->durable, msg->durable,
+                       msg->priority!=HEADER_PRIORITY_DEFAULT, msg->priority,
+                       (bool)msg->ttl, msg->ttl,
+                       msg->first_acquirer, msg->first_acquirer,
+                       (bool)msg->delivery_count, msg->delivery_count);
+    if (err)
+      return pn_error_format(msg->error, err, "data error: %s",
+                             pn_error_text(pn_data_error(data)));
+    break;
+
+  case PNI_MSG_INSTRUCTIONS:
+    if (pn_data_size(msg->instructions)) {
+      pn_data_put_described(data);
+      pn_data_enter(data);
+      pn_data_put_ulong(data, DELIVERY_ANNOTATIONS);
+      pn_data_rewind(msg->instructions);
+      err = pn_data_append(data, msg->instructions);
+      if (err)
+        return pn_error_format(msg->error, err, "data error: %s",
+                               pn_error_text(pn_data_error(data)));
+      pn_data_exit(data);
+    }
+    break;
+
+  case PNI_MSG_ANNOTATIONS:
+    if (pn_data_size(msg->annotations)) {
+      pn_data_put_described(data);
+      pn_data_enter(data);
+      pn_data_put_ulong(data, MESSAGE_ANNOTATIONS);
+      pn_data_rewind(msg->annotations);
+      err = pn_data_append(data, msg->annotations);
+      if (err)
+        return pn_error_format(msg->error, err, "data error: %s",
+                               pn_error_text(pn_data_error(data)));
+      pn_data_exit(data);
+    }
+    break;
+
+  case PNI_MSG_PROPERTIES:
+    err = pn_data_fill(data, "DL[CzSSSCss?t?tS?IS]", PROPERTIES,
+                       msg->id,
+                       pn_string_size(msg->user_id), pn_string_get(msg->user_id),
+                       pn_string_get(msg->address),
+                       pn_string_get(msg->subject),
+                       pn_string_get(msg->reply_to),
+                       msg->correlation_id,
+                       pn_string_get(msg->content_type),
+                       pn_string_get(msg->content_encoding),
+                       (bool)msg->expiry_time, msg->expiry_time,
+                       (bool)msg->creation_time, msg->creation_time,
+                       pn_string_get(msg->group_id),
+                       /*
+                        * As a heuristic, null out group_sequence if there is no group_id and
+                        * group_sequence is 0. In this case it is extremely unlikely we want
+                        * group semantics
+                        */
+                       (bool)pn_string_get(msg->group_id) || (bool)msg->group_sequence , msg->group_sequence,
+                       pn_string_get(msg->reply_to_group_id));
+    if (err)
+      return pn_error_format(msg->error, err, "data error: %s",
+                             pn_error_text(pn_data_error(data)));
+    break;
+
+  case PNI_MSG_APPLICATION_PROPERTIES:
+    if (pn_data_size(msg->properties)) {
+      pn_data_put_described(data);
+      pn_data_enter(data);
+      pn_data_put_ulong(data, APPLICATION_PROPERTIES);
+      pn_data_rewind(msg->properties);
+      err = pn_data_append(data, msg->properties);
+      if (err)
+        return pn_error_format(msg->error, err, "data error: %s",
+                               pn_error_text(pn_data_error(data)));
+      pn_data_exit(data);
+    }
+    break;
+
+  case PNI_MSG_BODY:
+    if (pn_data_size(msg->body)) {
+      pn_data_rewind(msg->body);
+      pn_data_next(msg->body);
+      pn_type_t body_type = pn_data_type(msg->body);
+      pn_data_rewind(msg->body);
+
+      pn_data_put_described(data);
+      pn_data_enter(data);
+      if (msg->inferred) {
+        switch (body_type) {
+        case PN_BINARY:
+          pn_data_put_ulong(data, DATA);
+          break;
+        case PN_LIST:
+          pn_data_put_ulong(data, AMQP_SEQUENCE);
+          break;
+        default:
+          pn_data_put_ulong(data, AMQP_VALUE);
+          break;
+        }
+      } else {
+        pn_data_put_ulong(data, AMQP_VALUE);
+      }
+      pn_data_append(data, msg->body);
+    }
+    break;
+
+  default:
+    break;
+  }
   return 0;
 }
 
 int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size)
 {
   if (!msg || !bytes || !size || !*size) return PN_ARG_ERR;
-  pn_data_clear(msg->data);
-  pn_message_data(msg, msg->data);
   size_t remaining = *size;
-  ssize_t encoded = pn_data_encode(msg->data, bytes, remaining);
-  if (encoded < 0) {
-    if (encoded == PN_OVERFLOW) {
-      return encoded;
-    } else {
-      return pn_error_format(msg->error, encoded, "data error: %s",
-                             pn_error_text(pn_data_error(msg->data)));
+  for (int i = 0; i < PNI_MSG_SECTIONS; ++i) {
+    pni_msg_section_t section = pni_msg_encode_order[i];
+    if (msg->pending & (1u << section)) {
+      /* Not used since pn_message_decode_lazy(), copy it as it was */
+      pn_bytes_t encoded = msg->sections[section];
+      if (encoded.size > remaining) return PN_OVERFLOW;
+      memcpy(bytes, encoded.start, encoded.size);
+      bytes += encoded.size;
+      remaining -= encoded.size;
+      continue;
+    }
+    pn_data_clear(msg->data);
+    int err = pni_message_section_data(msg, msg->data, section);
+    if (err) return err;
+    ssize_t encoded = pn_data_encode(msg->data, bytes, remaining);
+    if (encoded < 0) {
+      if (encoded == PN_OVERFLOW) {
+        return encoded;
+      } else {
+        return pn_error_format(msg->error, encoded, "data error: %s",
+                               pn_error_text(pn_data_error(msg->data)));
+      }
     }
+    bytes += encoded;
+    remaining -= encoded;
   }
-  bytes += encoded;
-  remaining -= encoded;
   *size -= remaining;
   pn_data_clear(msg->data);
   return 0;
@@ -785,122 +1089,41 @@ int pn_message_encode(pn_message_t *msg, char *bytes, size_t *size)
 
 int pn_message_data(pn_message_t *msg, pn_data_t *data)
 {
+  pni_message_ensure_all(msg);
   pn_data_clear(data);
-  int err = pn_data_fill(data, "DL[?o?B?I?o?I]", HEADER,
-                         msg->durable, msg->durable,
-                         msg->priority!=HEADER_PRIORITY_DEFAULT, msg->priority,
-                         (bool)msg->ttl, msg->ttl,
-                         msg->first_acquirer, msg->first_acquirer,
-                         (bool)msg->delivery_count, msg->delivery_count);
-  if (err)
-    return pn_error_format(msg->error, err, "data error: %s",
-                           pn_error_text(pn_data_error(data)));
-
-  if (pn_data_size(msg->instructions)) {
-    pn_data_put_described(data);
-    pn_data_enter(data);
-    pn_data_put_ulong(data, DELIVERY_ANNOTATIONS);
-    pn_data_rewind(msg->instructions);
-    err = pn_data_append(data, msg->instructions);
-    if (err)
-      return pn_error_format(msg->error, err, "data error: %s",
-                             pn_error_text(pn_data_error(data)));
-    pn_data_exit(data);
-  }
-
-  if (pn_data_size(msg->annotations)) {
-    pn_data_put_described(data);
-    pn_data_enter(data);
-    pn_data_put_ulong(data, MESSAGE_ANNOTATIONS);
-    pn_data_rewind(msg->annotations);
-    err = pn_data_append(data, msg->annotations);
-    if (err)
-      return pn_error_format(msg->error, err, "data error: %s",
-                             pn_error_text(pn_data_error(data)));
-    pn_data_exit(data);
-  }
-
-  err = pn_data_fill(data, "DL[CzSSSCss?t?tS?IS]", PROPERTIES,
-                     msg->id,
-                     pn_string_size(msg->user_id), pn_string_get(msg->user_id),
-                     pn_string_get(msg->address),
-                     pn_string_get(msg->subject),
-                     pn_string_get(msg->reply_to),
-                     msg->correlation_id,
-                     pn_string_get(msg->content_type),
-                     pn_string_get(msg->content_encoding),
-                     (bool)msg->expiry_time, msg->expiry_time,
-                     (bool)msg->creation_time, msg->creation_time,
-                     pn_string_get(msg->group_id),
-                     /*
-                      * As a heuristic, null out group_sequence if there is no group_id and
-                      * group_sequence is 0. In this case it is extremely unlikely we want
-                      * group semantics
-                      */
-                     (bool)pn_string_get(msg->group_id) || (bool)msg->group_sequence , msg->group_sequence,
-                     pn_string_get(msg->reply_to_group_id));
-  if (err)
-    return pn_error_format(msg->error, err, "data error: %s",
-                           pn_error_text(pn_data_error(data)));
-
-  if (pn_data_size(msg->properties)) {
-    pn_data_put_described(data);
-    pn_data_enter(data);
-    pn_data_put_ulong(data, APPLICATION_PROPERTIES);
-    pn_data_rewind(msg->properties);
-    err = pn_data_append(data, msg->properties);
-    if (err)
-      return pn_error_format(msg->error, err, "data error: %s",
-                             pn_error_text(pn_data_error(data)));
-    pn_data_exit(data);
-  }
-
-  if (pn_data_size(msg->body)) {
-    pn_data_rewind(msg->body);
-    pn_data_next(msg->body);
-    pn_type_t body_type = pn_data_type(msg->body);
-    pn_data_rewind(msg->body);
-
-    pn_data_put_described(data);
-    pn_data_enter(data);
-    if (msg->inferred) {
-      switch (body_type) {
-      case PN_BINARY:
-        pn_data_put_ulong(data, DATA);
-        break;
-      case PN_LIST:
-        pn_data_put_ulong(data, AMQP_SEQUENCE);
-        break;
-      default:
-        pn_data_put_ulong(data, AMQP_VALUE);
-        break;
-      }
-    } else {
-      pn_data_put_ulong(data, AMQP_VALUE);
-    }
-    pn_data_append(data, msg->body);
+  for (int i = 0; i < PNI_MSG_SECTIONS; ++i) {
+    int err = pni_message_section_data(msg, data, pni_msg_encode_order[i]);
+    if (err) return err;
   }
   return 0;
 }
 
 pn_data_t *pn_message_instructions(pn_message_t *msg)
 {
-  return msg ? msg->instructions : NULL;
+  if (!msg) return NULL;
+  pni_message_ensure(msg, PNI_MSG_INSTRUCTIONS);
+  return msg->instructions;
 }
 
 pn_data_t *pn_message_annotations(pn_message_t *msg)
 {
-  return msg ? msg->annotations : NULL;
+  if (!msg) return NULL;
+  pni_message_ensure(msg, PNI_MSG_ANNOTATIONS);
+  return msg->annotations;
 }
 
 pn_data_t *pn_message_properties(pn_message_t *msg)
 {
-  return msg ? msg->properties : NULL;
+  if (!msg) return NULL;
+  pni_message_ensure(msg, PNI_MSG_APPLICATION_PROPERTIES);
+  return msg->properties;
 }
 
 pn_data_t *pn_message_body(pn_message_t *msg)
 {
-  return msg ? msg->body : NULL;
+  if (!msg) return NULL;
+  pni_message_ensure(msg, PNI_MSG_BODY);
+  return msg->body;
 }
 
 ssize_t pn_message_encode2(pn_message_t *msg, pn_rwbytes_t *buffer) {
@@ -0,0 +1,53 @@
+#ifndef CORE_TRANSPORT_INTERNAL_H
+#define CORE_TRANSPORT_INTERNAL_H
+
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <proton/transport.h>
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @cond INTERNAL */
+
+/**
+ * Take the frames waiting to be written out of the transport, for a caller
+ * that writes them from memory that must not change until the write is
+ * complete (e.g. MSG_ZEROCOPY). The empty @p spare becomes the transport's
+ * frame buffer, so frames generated meanwhile do not touch the taken ones.
+ * The taken bytes count as written.
+ *
+ * Return the buffer holding the frames, now owned by the caller. Return NULL,
+ * leaving @p spare with the caller, if the output is not all frames written
+ * as they are (other output first, or SASL/SSL layers): write it with
+ * pn_transport_head_buffers() or pn_transport_head() as usual.
+ */
+PN_EXTERN pn_buffer_t *pni_transport_take_output(pn_transport_t *transport, pn_buffer_t *spare);
+
+/** @endcond */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CORE_TRANSPORT_INTERNAL_H
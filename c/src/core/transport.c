@@ -21,12 +21,14 @@
 
 #include "engine-internal.h"
 #include "framing.h"
+#include "transport-internal.h"
 #include "platform/platform.h"
 #include "platform/platform_fmt.h"
 #include "sasl/sasl-internal.h"
 #include "ssl/ssl-internal.h"
 
 #include "autodetect.h"
+#include "emitters.h"
 #include "protocol.h"
 #include "dispatch_actions.h"
 #include "config.h"
@@ -73,24 +75,34 @@ static void pni_calculate_channel_max(pn_transport_t *transport) {
 
 void pn_delivery_map_init(pn_delivery_map_t *db, pn_sequence_t next)
 {
-  db->deliveries = pn_hash(PN_WEAKREF, 0, 0.75);
+  db->deliveries = NULL;
+  db->capacity = 0;
+  db->size = 0;
+  db->first = next;
   db->next = next;
+  db->stragglers = NULL;
 }
 
 void pn_delivery_map_free(pn_delivery_map_t *db)
 {
-  pn_free(db->deliveries);
+  free(db->deliveries);
+  pn_free(db->stragglers);
 }
 
-static inline uintptr_t pni_sequence_make_hash ( pn_sequence_t i )
+static inline pn_delivery_t **pni_delivery_map_slot(pn_delivery_map_t *db, pn_sequence_t id)
 {
-  return i & 0x00000000FFFFFFFFUL;
+  return &db->deliveries[id & (db->capacity - 1)];
 }
 
+static inline bool pni_delivery_map_in_ring(pn_delivery_map_t *db, pn_sequence_t id)
+{
+  return id - db->first < db->next - db->first;
+}
 
 static pn_delivery_t *pni_delivery_map_get(pn_delivery_map_t *db, pn_sequence_t id)
 {
-  return (pn_delivery_t *) pn_hash_get(db->deliveries, pni_sequence_make_hash(id) );
+  if (pni_delivery_map_in_ring(db, id)) return *pni_delivery_map_slot(db, id);
+  return db->stragglers ? (pn_delivery_t *) pn_hash_get(db->stragglers, id) : NULL;
 }
 
 static void pn_delivery_state_init(pn_delivery_state_t *ds, pn_delivery_t *delivery, pn_sequence_t id)
@@ -101,11 +113,57 @@ static void pn_delivery_state_init(pn_delivery_state_t *ds, pn_delivery_t *deliv
   ds->init = true;
 }
 
+// Double the ring, entries move to the slots for their ids in the new size
+static bool pni_delivery_map_grow(pn_delivery_map_t *db)
+{
+  size_t capacity = db->capacity ? 2 * db->capacity : 16;
+  pn_delivery_t **deliveries = (pn_delivery_t **) calloc(capacity, sizeof(pn_delivery_t *));
+  if (!deliveries) return false;
+  for (pn_sequence_t id = db->first; id != db->next; ++id) {
+    deliveries[id & (capacity - 1)] = *pni_delivery_map_slot(db, id);
+  }
+  free(db->deliveries);
+  db->deliveries = deliveries;
+  db->capacity = capacity;
+  return true;
+}
+
+// Move the deliveries in the low half of the full ring to the stragglers
+static bool pni_delivery_map_spill(pn_delivery_map_t *db)
+{
+  if (!db->stragglers) {
+    db->stragglers = pn_hash(PN_WEAKREF, 0, 0.75);
+    if (!db->stragglers) return false;
+  }
+  pn_sequence_t end = db->first + db->capacity / 2;
+  for (; db->first != end; ++db->first) {
+    pn_delivery_t **slot = pni_delivery_map_slot(db, db->first);
+    if (*slot) {
+      if (pn_hash_put(db->stragglers, db->first, *slot)) return false;
+      *slot = NULL;
+    }
+  }
+  while (db->first != db->next && !*pni_delivery_map_slot(db, db->first)) {
+    db->first++;
+  }
+  return true;
+}
+
 static pn_delivery_state_t *pni_delivery_map_push(pn_delivery_map_t *db, pn_delivery_t *delivery)
 {
+  if (!db->size) db->first = db->next;
+  if ((size_t)(db->next - db->first) >= db->capacity) {
+    // Grow a ring that is at least half full, or a small one
+    size_t in_ring = db->size - (db->stragglers ? pn_hash_size(db->stragglers) : 0);
+    bool grow = db->capacity < 64 || 2 * in_ring >= db->capacity;
+    if (!(grow ? pni_delivery_map_grow(db) : pni_delivery_map_spill(db))) {
+      return NULL;
+    }
+  }
   pn_delivery_state_t *ds = &delivery->state;
   pn_delivery_state_init(ds, delivery, db->next++);
-  pn_hash_put(db->deliveries, pni_sequence_make_hash(ds->id), delivery);
+  *pni_delivery_map_slot(db, ds->id) = delivery;
+  db->size++;
   return ds;
 }
 
@@ -115,20 +173,34 @@ void pn_delivery_map_del(pn_delivery_map_t *db, pn_delivery_t *delivery)
     delivery->state.init = false;
     delivery->state.sending = false;
     delivery->state.sent = false;
-    pn_hash_del(db->deliveries, pni_sequence_make_hash(delivery->state.id) );
+    pn_sequence_t id = delivery->state.id;
+    if (!pni_delivery_map_in_ring(db, id)) {
+      if (db->stragglers && pn_hash_get(db->stragglers, id) == delivery) {
+        pn_hash_del(db->stragglers, id);
+        db->size--;
+      }
+    } else if (*pni_delivery_map_slot(db, id) == delivery) {
+      *pni_delivery_map_slot(db, id) = NULL;
+      db->size--;
+      while (db->first != db->next && !*pni_delivery_map_slot(db, db->first)) {
+        db->first++;
+      }
+    }
   }
 }
 
 static void pni_delivery_map_clear(pn_delivery_map_t *dm)
 {
-  pn_hash_t *hash = dm->deliveries;
-  for (pn_handle_t entry = pn_hash_head(hash);
-       entry;
-       entry = pn_hash_next(hash, entry))
-  {
-    pn_delivery_t *dlv = (pn_delivery_t *) pn_hash_value(hash, entry);
+  while (dm->stragglers && pn_hash_size(dm->stragglers)) {
+    pn_hash_t *stragglers = dm->stragglers;
+    pn_delivery_map_del(dm, (pn_delivery_t *) pn_hash_value(stragglers, pn_hash_head(stragglers)));
+  }
+  while (dm->size) {
+    pn_delivery_t *dlv = pni_delivery_map_get(dm, dm->first);
+    assert(dlv);
     pn_delivery_map_del(dm, dlv);
   }
+  dm->first = 0;
   dm->next = 0;
 }
 
@@ -481,7 +553,9 @@ static void pn_transport_initialize(void *object)
   transport->bytes_input = 0;
   transport->bytes_output = 0;
 
+  transport->input_start = 0;
   transport->input_pending = 0;
+  transport->output_start = 0;
   transport->output_pending = 0;
 
   transport->done_processing = false;
@@ -758,6 +832,7 @@ void pni_transport_unbind_channels(pn_hash_t *channels)
     pn_session_t *ssn = (pn_session_t *) pn_hash_value(channels, h);
     pni_delivery_map_clear(&ssn->state.incoming);
     pni_delivery_map_clear(&ssn->state.outgoing);
+    ssn->state.disp_count = 0;
     pni_transport_unbind_handles(ssn->state.local_handles, true);
     pni_transport_unbind_handles(ssn->state.remote_handles, true);
     pn_session_unbound(ssn);
@@ -783,6 +858,7 @@ int pn_transport_unbind(pn_transport_t *transport)
   while (ssn) {
     pni_delivery_map_clear(&ssn->state.incoming);
     pni_delivery_map_clear(&ssn->state.outgoing);
+    ssn->state.disp_count = 0;
     ssn = pn_session_next(ssn, 0);
   }
 
@@ -859,7 +935,6 @@ bool pni_disposition_batchable(pn_disposition_t *disposition)
 
 static int pni_disposition_encode(pn_disposition_t *disposition, pn_data_t *data)
 {
-  pn_condition_t *cond = &disposition->condition;
   switch (disposition->type) {
   case PN_RECEIVED:
     PN_RETURN_IF_ERROR(pn_data_put_list(data));
@@ -871,17 +946,23 @@ static int pni_disposition_encode(pn_disposition_t *disposition, pn_data_t *data
   case PN_ACCEPTED:
   case PN_RELEASED:
     return 0;
-  case PN_REJECTED:
+  case PN_REJECTED: {
+    pn_condition_t *cond = pn_disposition_condition(disposition);
     return pn_data_fill(data, "[?DL[sSC]]", pn_condition_is_set(cond), ERROR,
                  pn_condition_get_name(cond),
                  pn_condition_get_description(cond),
                  pn_condition_info(cond));
+  }
   case PN_MODIFIED:
     return pn_data_fill(data, "[ooC]",
                  disposition->failed,
                  disposition->undeliverable,
                  disposition->annotations);
   default:
+    if (!disposition->data) {
+      pn_data_clear(data);
+      return 0;
+    }
     return pn_data_copy(data, disposition->data);
   }
 }
@@ -909,6 +990,40 @@ void pn_do_trace(pn_transport_t *transport, uint16_t ch, pn_dir_t dir,
   }
 }
 
+// Trace an already encoded performative, only decoding it if frames are traced
+static void pni_trace_encoded(pn_transport_t *transport, uint16_t ch, pn_bytes_t performative,
+                              const char *payload, size_t size)
+{
+  if (transport->trace & PN_TRACE_FRM) {
+    pn_data_clear(transport->output_args);
+    pn_data_decode(transport->output_args, performative.start, performative.size);
+    pn_do_trace(transport, ch, OUT, transport->output_args, payload, size);
+  }
+}
+
+// Write a frame to the output_buffer, the frame body is the performative
+// followed by the body bytes.
+static void pni_write_frame(pn_transport_t *transport, uint8_t type, uint16_t ch,
+                            pn_bytes_t performative, pn_bytes_t body)
+{
+  pn_frame_t frame = {AMQP_FRAME_TYPE};
+  frame.type = type;
+  frame.channel = ch;
+  frame.payload = performative.start;
+  frame.size = performative.size;
+  size_t frame_size = AMQP_HEADER_SIZE+frame.ex_size+frame.size+body.size;
+
+  pn_buffer_ensure(transport->output_buffer, frame_size);
+  pn_write_frame_gather(transport->output_buffer, frame, body);
+  transport->output_frames_ct += 1;
+  if (transport->trace & PN_TRACE_RAW) {
+    pn_string_set(transport->scratch, "RAW: \"");
+    pn_buffer_quote(transport->output_buffer, transport->scratch, frame_size);
+    pn_string_addf(transport->scratch, "\"");
+    pn_transport_log(transport, pn_string_get(transport->scratch));
+  }
+}
+
 int pn_post_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, const char *fmt, ...)
 {
   pn_buffer_t *frame_buf = transport->frame;
@@ -942,24 +1057,125 @@ int pn_post_frame(pn_transport_t *transport, uint8_t type, uint16_t ch, const ch
     return PN_ERR;
   }
 
-  pn_frame_t frame = {AMQP_FRAME_TYPE};
-  frame.type = type;
-  frame.channel = ch;
-  frame.payload = buf.start;
-  frame.size = wr;
-  pn_buffer_ensure(transport->output_buffer, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-  pn_write_frame(transport->output_buffer, frame);
-  transport->output_frames_ct += 1;
-  if (transport->trace & PN_TRACE_RAW) {
-    pn_string_set(transport->scratch, "RAW: \"");
-    pn_buffer_quote(transport->output_buffer, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-    pn_string_addf(transport->scratch, "\"");
-    pn_transport_log(transport, pn_string_get(transport->scratch));
-  }
-
+  pni_write_frame(transport, type, ch, pn_bytes(wr, buf.start), pn_bytes(0, NULL));
   return 0;
 }
 
+// Get the empty frame buffer to encode a performative into
+static pn_rwbytes_t pni_frame_buffer(pn_transport_t *transport)
+{
+  pn_buffer_clear( transport->frame );
+  pn_rwbytes_t buf = pn_buffer_memory( transport->frame );
+  buf.size = pn_buffer_available( transport->frame );
+  return buf;
+}
+
+// Post a performative encoded by one of the pni_encode_ functions below
+static void pni_post_encoded_frame(pn_transport_t *transport, uint16_t ch, pn_bytes_t performative)
+{
+  pni_trace_encoded(transport, ch, performative, NULL, 0);
+  pni_write_frame(transport, AMQP_FRAME_TYPE, ch, performative, pn_bytes(0, NULL));
+}
+
+/*
+ * Encoders for the performatives sent for every message. These write the
+ * performative straight into buf rather than going through a pn_data_t, and
+ * return the size needed: if that is bigger than buf.size nothing useful was
+ * encoded and the caller should retry with more space.
+ */
+
+// "DL[IIzI?o?on?DLC?o?o?o]"
+static size_t pni_encode_transfer(pn_rwbytes_t buf, uint32_t handle, pn_sequence_t id,
+                                  const pn_bytes_t *tag, uint32_t message_format,
+                                  bool settled, bool more, uint64_t code, pn_data_t *state,
+                                  bool resume, bool aborted, bool batchable)
+{
+  pni_emitter_t emitter = pni_emitter(buf);
+  pni_compound_t top = pni_emitter_top();
+  pni_compound_t performative = pni_emit_descriptor(&emitter, &top, TRANSFER);
+  pni_compound_t list = pni_emit_list(&emitter, &performative);
+  pni_emit_uint(&emitter, &list, handle);
+  pni_emit_uint(&emitter, &list, id);
+  if (tag->start) pni_emit_binary(&emitter, &list, *tag);
+  else pni_emit_null(&emitter, &list);
+  pni_emit_uint(&emitter, &list, message_format);
+  if (settled) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  if (more) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  pni_emit_null(&emitter, &list);       // rcv-settle-mode
+  if (code) {
+    pni_compound_t outcome = pni_emit_descriptor(&emitter, &list, code);
+    pni_emit_copy(&emitter, &outcome, state);
+  } else {
+    pni_emit_null(&emitter, &list);
+  }
+  if (resume) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  if (aborted) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  if (batchable) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  pni_emit_end_list(&emitter, &list);
+  return emitter.position;
+}
+
+// "DL[?IIII?I?I?In?o]"
+static size_t pni_encode_flow(pn_rwbytes_t buf, bool has_next_incoming, uint32_t next_incoming,
+                              uint32_t incoming_window, uint32_t next_outgoing,
+                              uint32_t outgoing_window, pn_link_t *link)
+{
+  pni_emitter_t emitter = pni_emitter(buf);
+  pni_compound_t top = pni_emitter_top();
+  pni_compound_t performative = pni_emit_descriptor(&emitter, &top, FLOW);
+  pni_compound_t list = pni_emit_list(&emitter, &performative);
+  if (has_next_incoming) pni_emit_uint(&emitter, &list, next_incoming);
+  else pni_emit_null(&emitter, &list);
+  pni_emit_uint(&emitter, &list, incoming_window);
+  pni_emit_uint(&emitter, &list, next_outgoing);
+  pni_emit_uint(&emitter, &list, outgoing_window);
+  if (link) {
+    pni_emit_uint(&emitter, &list, link->state.local_handle);
+    pni_emit_uint(&emitter, &list, link->state.delivery_count);
+    pni_emit_uint(&emitter, &list, link->state.link_credit);
+    pni_emit_null(&emitter, &list);     // available
+    pni_emit_bool(&emitter, &list, link->drain);
+  }
+  pni_emit_end_list(&emitter, &list);
+  return emitter.position;
+}
+
+// "DL[oI?I?o?DL[]]" for a range with no outcome details, otherwise
+// "DL[oIn?o?DLC]" with the outcome details in state
+static size_t pni_encode_disposition(pn_rwbytes_t buf, bool role, pn_sequence_t first,
+                                     pn_sequence_t last, bool settled, uint64_t code,
+                                     pn_data_t *state)
+{
+  pni_emitter_t emitter = pni_emitter(buf);
+  pni_compound_t top = pni_emitter_top();
+  pni_compound_t performative = pni_emit_descriptor(&emitter, &top, DISPOSITION);
+  pni_compound_t list = pni_emit_list(&emitter, &performative);
+  pni_emit_bool(&emitter, &list, role);
+  pni_emit_uint(&emitter, &list, first);
+  if (last != first) pni_emit_uint(&emitter, &list, last);
+  else pni_emit_null(&emitter, &list);
+  if (settled) pni_emit_bool(&emitter, &list, true);
+  else pni_emit_null(&emitter, &list);
+  if (code) {
+    pni_compound_t outcome = pni_emit_descriptor(&emitter, &list, code);
+    if (state) {
+      pni_emit_copy(&emitter, &outcome, state);
+    } else {
+      pni_compound_t empty = pni_emit_list(&emitter, &outcome);
+      pni_emit_end_list(&emitter, &empty);
+    }
+  } else {
+    pni_emit_null(&emitter, &list);
+  }
+  pni_emit_end_list(&emitter, &list);
+  return emitter.position;
+}
+
 static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
                                         uint32_t handle,
                                         pn_sequence_t id,
@@ -977,47 +1193,18 @@ static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
 {
   bool more_flag = more;
   unsigned framecount = 0;
-  pn_buffer_t *frame = transport->frame;
-
-  // create preformatives, assuming 'more' flag need not change
-
- compute_performatives:
-  pn_data_clear(transport->output_args);
-  int err = pn_data_fill(transport->output_args, "DL[IIzI?o?on?DLC?o?o?o]", TRANSFER,
-                         handle,
-                         id,
-                         tag->size, tag->start,
-                         message_format,
-                         settled, settled,
-                         more_flag, more_flag,
-                         (bool)code, code, state,
-                         resume, resume,
-                         aborted, aborted,
-                         batchable, batchable);
-  if (err) {
-    pn_transport_logf(transport,
-                      "error posting transfer frame: %s: %s", pn_code(err),
-                      pn_error_text(pn_data_error(transport->output_args)));
-    return PN_ERR;
-  }
 
   do { // send as many frames as possible without changing the 'more' flag...
 
-  encode_performatives:
-    pn_buffer_clear( frame );
-    pn_rwbytes_t buf = pn_buffer_memory( frame );
-    buf.size = pn_buffer_available( frame );
-
-    ssize_t wr = pn_data_encode(transport->output_args, buf.start, buf.size);
-    if (wr < 0) {
-      if (wr == PN_OVERFLOW) {
-        pn_buffer_ensure( frame, pn_buffer_available( frame ) * 2 );
-        goto encode_performatives;
-      }
-      pn_transport_logf(transport, "error posting frame: %s", pn_code(wr));
-      return PN_ERR;
+  encode_performatives: ;
+    pn_rwbytes_t buf = pni_frame_buffer(transport);
+    size_t size = pni_encode_transfer(buf, handle, id, tag, message_format, settled, more_flag,
+                                      code, state, resume, aborted, batchable);
+    if (size > buf.size) {
+      pn_buffer_ensure( transport->frame, size );
+      goto encode_performatives;
     }
-    buf.size = wr;
+    buf.size = size;
 
     // check if we need to break up the outbound frame
     size_t available = payload->size;
@@ -1026,43 +1213,24 @@ static int pni_post_amqp_transfer_frame(pn_transport_t *transport, uint16_t ch,
         available = transport->remote_max_frame - 8 - buf.size;
         if (more_flag == false) {
           more_flag = true;
-          goto compute_performatives;  // deal with flag change
+          goto encode_performatives;  // deal with flag change
         }
       } else if (more_flag == true && more == false) {
         // caller has no more, and this is the last frame
         more_flag = false;
-        goto compute_performatives;
+        goto encode_performatives;
       }
     }
 
-    if (pn_buffer_available( frame ) < (available + buf.size)) {
-      // not enough room for payload - try again...
-      pn_buffer_ensure( frame, available + buf.size );
-      goto encode_performatives;
-    }
-
-    pn_do_trace(transport, ch, OUT, transport->output_args, payload->start, available);
+    pni_trace_encoded(transport, ch, pn_bytes(buf.size, buf.start), payload->start, available);
 
-    memmove( buf.start + buf.size, payload->start, available);
+    // The payload goes straight from the delivery into the output buffer
+    // behind the performative, it is not staged in the frame buffer.
+    pni_write_frame(transport, AMQP_FRAME_TYPE, ch, pn_bytes(buf.size, buf.start),
+                    pn_bytes(available, payload->start));
     payload->start += available;
     payload->size -= available;
-    buf.size += available;
-
-    pn_frame_t frame = {AMQP_FRAME_TYPE};
-    frame.channel = ch;
-    frame.payload = buf.start;
-    frame.size = buf.size;
-
-    pn_buffer_ensure(transport->output_buffer, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-    pn_write_frame(transport->output_buffer, frame);
-    transport->output_frames_ct += 1;
     framecount++;
-    if (transport->trace & PN_TRACE_RAW) {
-      pn_string_set(transport->scratch, "RAW: \"");
-      pn_buffer_quote(transport->output_buffer, transport->scratch, AMQP_HEADER_SIZE+frame.ex_size+frame.size);
-      pn_string_addf(transport->scratch, "\"");
-      pn_transport_log(transport, pn_string_get(transport->scratch));
-    }
   } while (payload->size > 0 && framecount < frame_limit);
 
   return framecount;
@@ -1463,23 +1631,44 @@ static void pn_full_settle(pn_delivery_map_t *db, pn_delivery_t *delivery)
   pn_decref(delivery);
 }
 
-int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
+// Read an optional delivery state field, "D?LC" in pn_data_scan() terms: the
+// state details are decoded into data, if there are any.
+static bool pni_consume_state(pni_consumer_t *fields, uint64_t *type, pn_data_t *data)
+{
+  pn_bytes_t value;
+  if (!pni_consume_described(fields, type, &value)) return false;
+  if (value.size && (uint8_t)value.start[0] != PNE_NULL) {
+    ssize_t n = pn_data_decode(data, value.start, value.size);
+    if (n < 0) fields->failed = true;
+  }
+  return true;
+}
+
+int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pni_consumer_t *fields, const pn_bytes_t *payload)
 {
   // XXX: multi transfer
-  uint32_t handle;
-  pn_bytes_t tag;
-  bool id_present;
-  pn_sequence_t id;
-  bool settled;
-  bool more;
-  bool has_type, settled_set;
-  bool resume, aborted, batchable;
-  uint64_t type;
+  uint32_t handle = 0;
+  pn_bytes_t tag = pn_bytes(0, NULL);
+  pn_sequence_t id = 0;
+  bool settled = false;
+  bool more = false;
+  bool settled_set;
+  bool resume = false, aborted = false, batchable = false;
+  uint64_t type = 0;
   pn_data_clear(transport->disp_data);
-  int err = pn_data_scan(args, "D.[I?Iz.?oo.D?LCooo]", &handle, &id_present, &id, &tag,
-                         &settled_set, &settled, &more, &has_type, &type, transport->disp_data,
-                         &resume, &aborted, &batchable);
-  if (err) return err;
+  // "D.[I?Iz.?oo.D?LCooo]"
+  pni_consume_uint(fields, &handle);
+  bool id_present = pni_consume_uint(fields, &id);
+  pni_consume_binary(fields, &tag);
+  pni_consume_skip(fields);           // message-format
+  settled_set = pni_consume_bool(fields, &settled);
+  pni_consume_bool(fields, &more);
+  pni_consume_skip(fields);           // rcv-settle-mode
+  bool has_type = pni_consume_state(fields, &type, transport->disp_data);
+  pni_consume_bool(fields, &resume);
+  pni_consume_bool(fields, &aborted);
+  pni_consume_bool(fields, &batchable);
+  if (!pni_consumer_ok(fields)) return PN_ERR;
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
     return pn_do_error(transport, "amqp:not-allowed", "no such channel: %u", channel);
@@ -1509,6 +1698,7 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
 
     delivery = pn_delivery(link, pn_dtag(tag.start, tag.size));
     pn_delivery_state_t *state = pni_delivery_map_push(incoming, delivery);
+    if (!state) return PN_OUT_OF_MEMORY;
     if (id_present && id != state->id) {
       return pn_do_error(transport, "amqp:session:invalid-field",
                          "sequencing error, expected delivery-id %u, got %u",
@@ -1516,7 +1706,9 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
     }
     if (has_type) {
       delivery->remote.type = type;
-      pn_data_copy(delivery->remote.data, transport->disp_data);
+      if (pn_data_size(transport->disp_data)) {
+        pn_data_copy(pn_disposition_data(&delivery->remote), transport->disp_data);
+      }
     }
 
     link->state.delivery_count++;
@@ -1524,7 +1716,7 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
     link->queued++;
   }
 
-  pn_buffer_append(delivery->bytes, payload->start, payload->size);
+  pn_buffer_append(&delivery->bytes, payload->start, payload->size);
   ssn->incoming_bytes += payload->size;
   delivery->done = !more;
 
@@ -1553,16 +1745,23 @@ int pn_do_transfer(pn_transport_t *transport, uint8_t frame_type, uint16_t chann
   return 0;
 }
 
-int pn_do_flow(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
-{
-  pn_sequence_t onext, inext, delivery_count;
-  uint32_t iwin, owin, link_credit;
-  uint32_t handle;
-  bool inext_init, handle_init, dcount_init, drain;
-  int err = pn_data_scan(args, "D.[?IIII?I?II.o]", &inext_init, &inext, &iwin,
-                         &onext, &owin, &handle_init, &handle, &dcount_init,
-                         &delivery_count, &link_credit, &drain);
-  if (err) return err;
+int pn_do_flow(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pni_consumer_t *fields, const pn_bytes_t *payload)
+{
+  pn_sequence_t onext = 0, inext = 0, delivery_count = 0;
+  uint32_t iwin = 0, owin = 0, link_credit = 0;
+  uint32_t handle = 0;
+  bool drain = false;
+  // "D.[?IIII?I?II.o]"
+  bool inext_init = pni_consume_uint(fields, &inext);
+  pni_consume_uint(fields, &iwin);
+  pni_consume_uint(fields, &onext);
+  pni_consume_uint(fields, &owin);
+  bool handle_init = pni_consume_uint(fields, &handle);
+  bool dcount_init = pni_consume_uint(fields, &delivery_count);
+  pni_consume_uint(fields, &link_credit);
+  pni_consume_skip(fields);           // available
+  pni_consume_bool(fields, &drain);
+  if (!pni_consumer_ok(fields)) return PN_ERR;
 
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
@@ -1655,7 +1854,7 @@ static int pni_do_delivery_disposition(pn_transport_t * transport, pn_delivery_t
       break;
 
     case PN_REJECTED: {
-      int err = pn_scan_error(transport->disp_data, &remote->condition, SCAN_ERROR_DISP);
+      int err = pn_scan_error(transport->disp_data, pn_disposition_condition(remote), SCAN_ERROR_DISP);
 
       if (err) return err;
       break;
@@ -1675,13 +1874,13 @@ static int pni_do_delivery_disposition(pn_transport_t * transport, pn_delivery_t
         remote->undeliverable = pn_data_get_bool(transport->disp_data);
       }
       pn_data_narrow(transport->disp_data);
-      pn_data_clear(remote->data);
-      pn_data_appendn(remote->annotations, transport->disp_data, 1);
+      if (remote->data) pn_data_clear(remote->data);
+      pn_data_appendn(pn_disposition_annotations(remote), transport->disp_data, 1);
       pn_data_widen(transport->disp_data);
       break;
 
     default:
-      pn_data_copy(remote->data, transport->disp_data);
+      pn_data_copy(pn_disposition_data(remote), transport->disp_data);
       break;
     }
   }
@@ -1694,18 +1893,22 @@ static int pni_do_delivery_disposition(pn_transport_t * transport, pn_delivery_t
   return 0;
 }
 
-int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pn_data_t *args, const pn_bytes_t *payload)
+int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t channel, pni_consumer_t *fields, const pn_bytes_t *payload)
 {
-  bool role;
-  pn_sequence_t first, last;
+  bool role = false;
+  pn_sequence_t first = 0, last = 0;
   uint64_t type = 0;
-  bool last_init, settled, type_init;
+  bool settled = false;
   pn_data_clear(transport->disp_data);
-  int err = pn_data_scan(args, "D.[oI?IoD?LC]", &role, &first, &last_init,
-                         &last, &settled, &type_init, &type,
-                         transport->disp_data);
-  if (err) return err;
+  // "D.[oI?IoD?LC]"
+  pni_consume_bool(fields, &role);
+  pni_consume_uint(fields, &first);
+  bool last_init = pni_consume_uint(fields, &last);
+  pni_consume_bool(fields, &settled);
+  bool type_init = pni_consume_state(fields, &type, transport->disp_data);
+  if (!pni_consumer_ok(fields)) return PN_ERR;
   if (!last_init) last = first;
+  int err = 0;
 
   pn_session_t *ssn = pni_channel_state(transport, channel);
   if (!ssn) {
@@ -1727,31 +1930,38 @@ int pn_do_disposition(pn_transport_t *transport, uint8_t frame_type, uint16_t ch
   bool remote_data = (pn_data_next(transport->disp_data) &&
                       pn_data_get_list(transport->disp_data) > 0);
 
-  // Do some validation of received first and last values
-  // TODO: We should really also clamp the first value here, but we're not keeping track of the earliest
-  // unsettled delivery sequence no
-  last = sequence_lte(last, deliveries->next) ? last : deliveries->next;
-
-  // If there are fewer deliveries in the session than the range then look at every delivery in the session
-  // otherwise look at every delivery_id in the disposition performative
-  pn_hash_t *dh = deliveries->deliveries;
-  if (last-first+1 >= pn_hash_size(dh)) {
-    for (pn_handle_t entry = pn_hash_head(dh); entry!=0 ; entry = pn_hash_next(dh, entry)) {
-      pn_sequence_t key = pn_hash_key(dh, entry);
-      if (sequence_lte(first, key) && sequence_lte(key, last)) {
-        pn_delivery_t *delivery = (pn_delivery_t*) pn_hash_value(dh, entry);
-        err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
-        if (err) return err;
-      }
+  // Deliveries moved out of the ring are few, find those in the range first.
+  // Their ids are collected as settling one can rearrange the hash.
+  size_t straggler_count = deliveries->stragglers ? pn_hash_size(deliveries->stragglers) : 0;
+  if (straggler_count) {
+    pn_hash_t *stragglers = deliveries->stragglers;
+    pn_sequence_t *ids = (pn_sequence_t *) malloc(straggler_count * sizeof(pn_sequence_t));
+    if (!ids) return PN_OUT_OF_MEMORY;
+    size_t n = 0;
+    for (pn_handle_t h = pn_hash_head(stragglers); h; h = pn_hash_next(stragglers, h)) {
+      pn_sequence_t id = (pn_sequence_t) pn_hash_key(stragglers, h);
+      if (sequence_lte(first, id) && sequence_lte(id, last)) ids[n++] = id;
     }
-  } else {
-    for (pn_sequence_t id = first; sequence_lte(id, last); ++id) {
-      pn_delivery_t *delivery = pni_delivery_map_get(deliveries, id);
+    for (size_t i = 0; i < n && !err; ++i) {
+      pn_delivery_t *delivery = pni_delivery_map_get(deliveries, ids[i]);
       if (delivery) {
         err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
-        if (err) return err;
       }
     }
+    free(ids);
+    if (err) return err;
+  }
+
+  // Only look at ids that can be in the ring, the range may be much larger
+  if (!sequence_lte(deliveries->first, first)) first = deliveries->first;
+  if (!sequence_lte(last, deliveries->next)) last = deliveries->next;
+
+  for (pn_sequence_t id = first; sequence_lte(id, last); ++id) {
+    pn_delivery_t *delivery = pni_delivery_map_get(deliveries, id);
+    if (delivery) {
+      err = pni_do_delivery_disposition(transport, delivery, settled, remote_data, type_init, type);
+      if (err) return err;
+    }
   }
 
   return 0;
@@ -1860,10 +2070,11 @@ static ssize_t transport_consume(pn_transport_t *transport)
     ssize_t n;
     n = transport->io_layers[0]->
       process_input( transport, 0,
-                     transport->input_buf + consumed,
+                     transport->input_buf + transport->input_start,
                      transport->input_pending );
     if (n > 0) {
       consumed += n;
+      transport->input_start += n;
       transport->input_pending -= n;
     } else if (n == 0) {
       break;
@@ -1871,13 +2082,16 @@ static ssize_t transport_consume(pn_transport_t *transport)
       assert(n == PN_EOS);
       if (transport->trace & (PN_TRACE_RAW | PN_TRACE_FRM))
         pn_transport_log(transport, "  <- EOS");
+      transport->input_start = 0;
       transport->input_pending = 0;  // XXX ???
       return n;
     }
   }
 
-  if (transport->input_pending && consumed) {
-    memmove( transport->input_buf,  &transport->input_buf[consumed], transport->input_pending );
+  // Unconsumed input stays where it is, the space in front of it is only
+  // reclaimed when the buffer fills up (see pn_transport_capacity())
+  if (!transport->input_pending) {
+    transport->input_start = 0;
   }
 
   return consumed;
@@ -2104,17 +2318,20 @@ static int pni_post_flow(pn_transport_t *transport, pn_session_t *ssn, pn_link_t
 {
   ssn->state.incoming_window = pni_session_incoming_window(ssn);
   ssn->state.outgoing_window = pni_session_outgoing_window(ssn);
-  bool linkq = (bool) link;
-  pn_link_state_t *state = &link->state;
-  return pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel, "DL[?IIII?I?I?In?o]", FLOW,
-                       (int16_t) ssn->state.remote_channel >= 0, ssn->state.incoming_transfer_count,
-                       ssn->state.incoming_window,
-                       ssn->state.outgoing_transfer_count,
-                       ssn->state.outgoing_window,
-                       linkq, linkq ? state->local_handle : 0,
-                       linkq, linkq ? state->delivery_count : 0,
-                       linkq, linkq ? state->link_credit : 0,
-                       linkq, linkq ? link->drain : false);
+  for (;;) {
+    pn_rwbytes_t buf = pni_frame_buffer(transport);
+    size_t size = pni_encode_flow(buf, (int16_t) ssn->state.remote_channel >= 0,
+                                  ssn->state.incoming_transfer_count,
+                                  ssn->state.incoming_window,
+                                  ssn->state.outgoing_transfer_count,
+                                  ssn->state.outgoing_window,
+                                  link);
+    if (size <= buf.size) {
+      pni_post_encoded_frame(transport, ssn->state.local_channel, pn_bytes(size, buf.start));
+      return 0;
+    }
+    pn_buffer_ensure(transport->frame, size);
+  }
 }
 
 static int pni_process_flow_receiver(pn_transport_t *transport, pn_endpoint_t *endpoint)
@@ -2135,26 +2352,64 @@ static int pni_process_flow_receiver(pn_transport_t *transport, pn_endpoint_t *e
   return 0;
 }
 
+static int pni_disp_cmp(const void *a, const void *b)
+{
+  const pni_disp_t *da = (const pni_disp_t *) a;
+  const pni_disp_t *db = (const pni_disp_t *) b;
+  if (da->type != db->type) return da->type < db->type ? -1 : 1;
+  if (da->id != db->id) return da->id < db->id ? -1 : 1;
+  if (da->seq != db->seq) return da->seq < db->seq ? -1 : 1;
+  return 0;
+}
+
+static int pni_post_disp_range(pn_transport_t *transport, pn_session_t *ssn, const pni_disp_t *first, pn_sequence_t last)
+{
+  for (;;) {
+    pn_rwbytes_t buf = pni_frame_buffer(transport);
+    size_t size = pni_encode_disposition(buf, first->type, first->id, last,
+                                         first->settled, first->code, NULL);
+    if (size <= buf.size) {
+      pni_post_encoded_frame(transport, ssn->state.local_channel, pn_bytes(size, buf.start));
+      return 0;
+    }
+    pn_buffer_ensure(transport->frame, size);
+  }
+}
+
+// Send the batched dispositions as the fewest ranged frames: after sorting by
+// role and id, each run of consecutive ids with the same outcome is one frame.
+// Ids are compared without wrap around, a run crossing the wrap just splits.
 static int pni_flush_disp(pn_transport_t *transport, pn_session_t *ssn)
 {
-  uint64_t code = ssn->state.disp_code;
-  bool settled = ssn->state.disp_settled;
-  if (ssn->state.disp) {
-    int err = pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel, "DL[oI?I?o?DL[]]", DISPOSITION,
-                            ssn->state.disp_type,
-                            ssn->state.disp_first,
-                            ssn->state.disp_last!=ssn->state.disp_first, ssn->state.disp_last,
-                            settled, settled,
-                            (bool)code, code);
+  pn_session_state_t *state = &ssn->state;
+  size_t count = state->disp_count;
+  if (!count) return 0;
+  pni_disp_t *disps = state->disps;
+  for (size_t i = 1; i < count; ++i) {
+    if (pni_disp_cmp(&disps[i - 1], &disps[i]) > 0) {
+      qsort(disps, count, sizeof(pni_disp_t), pni_disp_cmp);
+      break;
+    }
+  }
+  state->disp_count = 0;
+
+  const pni_disp_t *first = &disps[0];
+  pn_sequence_t last = first->id;
+  for (size_t i = 1; i < count; ++i) {
+    const pni_disp_t *d = &disps[i];
+    if (d->type == first->type && d->code == first->code && d->settled == first->settled) {
+      if (d->id == last + 1) {
+        last = d->id;
+        continue;
+      }
+      if (d->id == last) continue; // Posted twice with the same outcome
+    }
+    int err = pni_post_disp_range(transport, ssn, first, last);
     if (err) return err;
-    ssn->state.disp_type = 0;
-    ssn->state.disp_code = 0;
-    ssn->state.disp_settled = 0;
-    ssn->state.disp_first = 0;
-    ssn->state.disp_last = 0;
-    ssn->state.disp = false;
+    first = d;
+    last = d->id;
   }
-  return 0;
+  return pni_post_disp_range(transport, ssn, first, last);
 }
 
 static int pni_post_disp(pn_transport_t *transport, pn_delivery_t *delivery)
@@ -2175,37 +2430,32 @@ static int pni_post_disp(pn_transport_t *transport, pn_delivery_t *delivery)
   if (!pni_disposition_batchable(&delivery->local)) {
     pn_data_clear(transport->disp_data);
     PN_RETURN_IF_ERROR(pni_disposition_encode(&delivery->local, transport->disp_data));
-    return pn_post_frame(transport, AMQP_FRAME_TYPE, ssn->state.local_channel,
-      "DL[oIn?o?DLC]", DISPOSITION,
-      role, state->id,
-      delivery->local.settled, delivery->local.settled,
-      (bool)code, code, transport->disp_data);
-  }
-
-  if (ssn_state->disp && code == ssn_state->disp_code &&
-      delivery->local.settled == ssn_state->disp_settled &&
-      ssn_state->disp_type == role) {
-    if (state->id == ssn_state->disp_first - 1) {
-      ssn_state->disp_first = state->id;
-      return 0;
-    } else if (state->id == ssn_state->disp_last + 1) {
-      ssn_state->disp_last = state->id;
-      return 0;
+    for (;;) {
+      pn_rwbytes_t buf = pni_frame_buffer(transport);
+      size_t size = pni_encode_disposition(buf, role, state->id, state->id,
+                                           delivery->local.settled, code, transport->disp_data);
+      if (size <= buf.size) {
+        pni_post_encoded_frame(transport, ssn->state.local_channel, pn_bytes(size, buf.start));
+        return 0;
+      }
+      pn_buffer_ensure(transport->frame, size);
     }
   }
 
-  if (ssn_state->disp) {
-    int err = pni_flush_disp(transport, ssn);
-    if (err) return err;
-  }
-
-  ssn_state->disp_type = role;
-  ssn_state->disp_code = code;
-  ssn_state->disp_settled = delivery->local.settled;
-  ssn_state->disp_first = state->id;
-  ssn_state->disp_last = state->id;
-  ssn_state->disp = true;
-
+  // Batched until the end of the processing pass, see pni_flush_disp
+  if (ssn_state->disp_count == ssn_state->disp_capacity) {
+    size_t capacity = ssn_state->disp_capacity ? 2 * ssn_state->disp_capacity : 16;
+    pni_disp_t *disps = (pni_disp_t *) realloc(ssn_state->disps, capacity * sizeof(pni_disp_t));
+    if (!disps) return PN_OUT_OF_MEMORY;
+    ssn_state->disps = disps;
+    ssn_state->disp_capacity = capacity;
+  }
+  pni_disp_t *disp = &ssn_state->disps[ssn_state->disp_count];
+  disp->code = code;
+  disp->id = state->id;
+  disp->seq = ssn_state->disp_count++;
+  disp->settled = delivery->local.settled;
+  disp->type = role;
   return 0;
 }
 
@@ -2225,15 +2475,16 @@ static int pni_process_tpwork_sender(pn_transport_t *transport, pn_delivery_t *d
   pn_link_state_t *link_state = &link->state;
   bool xfr_posted = false;
   if ((int16_t) ssn_state->local_channel >= 0 && (int32_t) link_state->local_handle >= 0) {
-    if (!state->sent && (delivery->done || pn_buffer_size(delivery->bytes) > 0) &&
+    if (!state->sent && (delivery->done || pn_buffer_size(&delivery->bytes) > 0) &&
         ssn_state->remote_incoming_window > 0 && link_state->link_credit > 0) {
       if (!state->init) {
         state = pni_delivery_map_push(&ssn_state->outgoing, delivery);
+        if (!state) return PN_OUT_OF_MEMORY;
       }
 
-      pn_bytes_t bytes = pn_buffer_bytes(delivery->bytes);
+      pn_bytes_t bytes = pn_buffer_bytes(&delivery->bytes);
       size_t full_size = bytes.size;
-      pn_bytes_t tag = pn_buffer_bytes(delivery->tag);
+      pn_bytes_t tag = pn_buffer_bytes(&delivery->tag);
       pn_data_clear(transport->disp_data);
       PN_RETURN_IF_ERROR(pni_disposition_encode(&delivery->local, transport->disp_data));
       int count = pni_post_amqp_transfer_frame(transport,
@@ -2257,9 +2508,9 @@ static int pni_process_tpwork_sender(pn_transport_t *transport, pn_delivery_t *d
       ssn_state->remote_incoming_window -= count;
 
       int sent = full_size - bytes.size;
-      pn_buffer_trim(delivery->bytes, sent, 0);
+      pn_buffer_trim(&delivery->bytes, sent, 0);
       link->session->outgoing_bytes -= sent;
-      if (!pn_buffer_size(delivery->bytes) && delivery->done) {
+      if (!pn_buffer_size(&delivery->bytes) && delivery->done) {
         state->sent = true;
         link_state->delivery_count++;
         link_state->link_credit--;
@@ -2722,29 +2973,23 @@ static ssize_t transport_produce(pn_transport_t *transport)
 {
   if (transport->head_closed) return PN_EOS;
 
-  ssize_t space = transport->output_size - transport->output_pending;
-
-  if (space <= 0) {     // can we expand the buffer?
-    int more = 0;
-    if (!transport->remote_max_frame)   // no limit, so double it
-      more = transport->output_size;
-    else if (transport->remote_max_frame > transport->output_size)
-      more = pn_min(transport->output_size, transport->remote_max_frame - transport->output_size);
-    if (more) {
-      char *newbuf = (char *)realloc( transport->output_buf, transport->output_size + more );
-      if (newbuf) {
-        transport->output_buf = newbuf;
-        transport->output_size += more;
-        space += more;
-      }
-    }
+  // Only move pending output back to the start of the buffer once at least
+  // as much space has been written out in front of it, so the copying is
+  // bounded by the amount written. The buffer does not grow, the layers
+  // produce output in pieces as space becomes available.
+  if (transport->output_start && transport->output_start >= transport->output_pending) {
+    memmove( transport->output_buf, &transport->output_buf[transport->output_start],
+             transport->output_pending );
+    transport->output_start = 0;
   }
 
+  ssize_t space = transport->output_size - transport->output_start - transport->output_pending;
+
   while (space > 0) {
     ssize_t n;
     n = transport->io_layers[0]->
       process_output( transport, 0,
-                      &transport->output_buf[transport->output_pending],
+                      &transport->output_buf[transport->output_start + transport->output_pending],
                       space );
     if (n > 0) {
       space -= n;
@@ -2939,7 +3184,7 @@ ssize_t pn_transport_capacity(pn_transport_t *transport)  /* <0 == done */
   if (transport->tail_closed) return PN_EOS;
   //if (pn_error_code(transport->error)) return pn_error_code(transport->error);
 
-  ssize_t capacity = transport->input_size - transport->input_pending;
+  ssize_t capacity = transport->input_size - transport->input_start - transport->input_pending;
   if ( capacity<=0 ) {
     // can we expand the size of the input buffer?
     int more = 0;
@@ -2948,6 +3193,17 @@ ssize_t pn_transport_capacity(pn_transport_t *transport)  /* <0 == done */
     } else if (transport->local_max_frame > transport->input_size) {
       more = pn_min(transport->input_size, transport->local_max_frame - transport->input_size);
     }
+    // Reclaim consumed space in front of the pending input instead if that
+    // frees at least as much as is moved, or if the buffer can't grow. The
+    // buffer only grows to hold a frame bigger than it is.
+    if (transport->input_start &&
+        (transport->input_start >= transport->input_pending || !more)) {
+      memmove( transport->input_buf, &transport->input_buf[transport->input_start],
+               transport->input_pending );
+      capacity += transport->input_start;
+      transport->input_start = 0;
+      more = 0;
+    }
     if (more) {
       char *newbuf = (char *) realloc( transport->input_buf, transport->input_size + more );
       if (newbuf) {
@@ -2963,8 +3219,8 @@ ssize_t pn_transport_capacity(pn_transport_t *transport)  /* <0 == done */
 
 char *pn_transport_tail(pn_transport_t *transport)
 {
-  if (transport && transport->input_pending < transport->input_size) {
-    return &transport->input_buf[transport->input_pending];
+  if (transport && transport->input_start + transport->input_pending < transport->input_size) {
+    return &transport->input_buf[transport->input_start + transport->input_pending];
   }
   return NULL;
 }
@@ -2995,7 +3251,7 @@ ssize_t pn_transport_push(pn_transport_t *transport, const char *src, size_t siz
 int pn_transport_process(pn_transport_t *transport, size_t size)
 {
   assert(transport);
-  size = pn_min( size, (transport->input_size - transport->input_pending) );
+  size = pn_min( size, (transport->input_size - transport->input_start - transport->input_pending) );
   transport->input_pending += size;
   transport->bytes_input += size;
 
@@ -3027,11 +3283,53 @@ ssize_t pn_transport_pending(pn_transport_t *transport)      /* <0 == done */
 const char *pn_transport_head(pn_transport_t *transport)
 {
   if (transport && transport->output_pending) {
-    return transport->output_buf;
+    return &transport->output_buf[transport->output_start];
   }
   return NULL;
 }
 
+// True if every layer in front of the AMQP layer passes output through
+// unchanged, so frames in the output_buffer are exactly the bytes to be written.
+static bool pni_output_passthru(pn_transport_t *transport)
+{
+  for (unsigned int layer = 0; layer < PN_IO_LAYER_CT; ++layer) {
+    const pn_io_layer_t *l = transport->io_layers[layer];
+    if (l == &amqp_layer) return true;
+    if (l != &pni_passthru_layer) return false;
+  }
+  return false;
+}
+
+size_t pn_transport_head_buffers(pn_transport_t *transport, pn_bytes_t *buffers, size_t n)
+{
+  assert(transport);
+  if (!n) return 0;
+
+  if (transport->head_closed || !pni_output_passthru(transport)) {
+    ssize_t pending = transport_produce(transport);
+    if (pending <= 0) return 0;
+    buffers[0] = pn_bytes(pending, &transport->output_buf[transport->output_start]);
+    return 1;
+  }
+
+  // Generate frames without copying them out of the output_buffer, they are
+  // handed out in place behind anything already in the output_buf.
+  ssize_t err = transport->io_layers[0]->process_output(transport, 0, NULL, 0);
+  size_t count = 0;
+  if (transport->output_pending) {
+    buffers[count++] = pn_bytes(transport->output_pending, &transport->output_buf[transport->output_start]);
+  }
+  pn_bytes_t segments[2];
+  size_t segment_count = pn_buffer_segments(transport->output_buffer, segments);
+  for (size_t i = 0; i < segment_count && count < n; ++i) {
+    buffers[count++] = segments[i];
+  }
+  if (!count && err < 0) {
+    transport_produce(transport);       // Close the head
+  }
+  return count;
+}
+
 ssize_t pn_transport_peek(pn_transport_t *transport, char *dst, size_t size)
 {
   assert(transport);
@@ -3055,20 +3353,58 @@ ssize_t pn_transport_peek(pn_transport_t *transport, char *dst, size_t size)
 void pn_transport_pop(pn_transport_t *transport, size_t size)
 {
   if (transport) {
-    assert( transport->output_pending >= size );
+    // Bytes beyond the output_buf were handed out in place by
+    // pn_transport_head_buffers()
+    size_t buffered = 0;
+    if (size > transport->output_pending) {
+      buffered = size - transport->output_pending;
+      size = transport->output_pending;
+      assert( pni_output_passthru(transport) );
+      assert( pn_buffer_size(transport->output_buffer) >= buffered );
+      pn_buffer_trim(transport->output_buffer, buffered, 0);
+    }
     transport->output_pending -= size;
-    transport->bytes_output += size;
-    if (transport->output_pending) {
-      memmove( transport->output_buf,  &transport->output_buf[size],
-               transport->output_pending );
+    transport->bytes_output += size + buffered;
+    // Leave the rest in place, pending output is only moved when the space
+    // in front of it is needed (see transport_produce())
+    transport->output_start = transport->output_pending ? transport->output_start + size : 0;
+
+    if (transport->output_pending==0) {
+      if (!transport->close_sent && pni_output_passthru(transport)) {
+        // Frames are handed out in place: generate the next ones behind any
+        // still in the output_buffer rather than producing, which would copy
+        // them into the output_buf. Only the AMQP layer can end the output,
+        // after sending close.
+        transport->io_layers[0]->process_output(transport, 0, NULL, 0);
+      } else if (pn_transport_pending(transport) < 0) {
+        // TODO: It looks to me that this is a NOP as iff we ever get here
+        // TODO: pni_close_head() will always have been already called before leaving pn_transport_pending()
+        pni_close_head(transport);
+      }
     }
+  }
+}
 
-    if (transport->output_pending==0 && pn_transport_pending(transport) < 0) {
-      // TODO: It looks to me that this is a NOP as iff we ever get here
-      // TODO: pni_close_head() will always have been already called before leaving pn_transport_pending()
-      pni_close_head(transport);
-    }
+pn_buffer_t *pni_transport_take_output(pn_transport_t *transport, pn_buffer_t *spare)
+{
+  assert(transport && spare && !pn_buffer_size(spare));
+  if (transport->head_closed || transport->output_pending || !pni_output_passthru(transport))
+    return NULL;
+
+  transport->io_layers[0]->process_output(transport, 0, NULL, 0);
+  pn_buffer_t *taken = transport->output_buffer;
+  size_t size = pn_buffer_size(taken);
+  if (!size) return NULL;
+  transport->output_buffer = spare;
+  transport->bytes_output += size;
+
+  // As pn_transport_pop() once the output is all written
+  if (!transport->close_sent) {
+    transport->io_layers[0]->process_output(transport, 0, NULL, 0);
+  } else if (pn_transport_pending(transport) < 0) {
+    pni_close_head(transport);
   }
+  return taken;
 }
 
 int pn_transport_close_head(pn_transport_t *transport)
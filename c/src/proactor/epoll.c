@@ -27,6 +27,8 @@
 #undef _GNU_SOURCE
 
 #include "../core/log_private.h"
+#include "../core/transport-internal.h"
+#include "./hazard.h"
 #include "./proactor-internal.h"
 
 #include <proton/condition.h>
@@ -50,15 +52,17 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <asm/socket.h>          /* SO_ZEROCOPY, SO_BUSY_POLL */
 #include <sys/eventfd.h>
 #include <limits.h>
 #include <time.h>
 
 #include "./netaddr-internal.h" /* Include after socket/inet headers */
 
-// TODO: replace timerfd per connection with global lightweight timer mechanism.
-// logging in general
+// TODO: logging in general
 // SIGPIPE?
 // Can some of the mutexes be spinlocks (any benefit over adaptive pthread mutex)?
 //   Maybe futex is even better?
@@ -118,9 +122,10 @@ typedef enum {
   WAKE,   /* see if any work to do in proactor/psocket context */
   PCONNECTION_IO,
   PCONNECTION_IO_2,
-  PCONNECTION_TIMER,
+  PCONNECTION_TIMERS,
   LISTENER_IO,
   CHAINED_EPOLL,
+  ORPHAN_SHARD,
   PROACTOR_TIMER } epoll_type_t;
 
 // Data to use with epoll.
@@ -130,6 +135,7 @@ typedef struct epoll_extended_t {
   epoll_type_t type;   // io/timer/wakeup
   uint32_t wanted;     // events to poll for
   bool polling;
+  int epollfd;         // epoll set polling fd, for rearm
   pmutex barrier_mutex;
 } epoll_extended_t;
 
@@ -158,9 +164,8 @@ static void memory_barrier(epoll_extended_t *ee) {
  *   cancel/settime(0) (thread A) (number of expiries resets to zero)
  *   read(timerfd) -> -1, EAGAIN  (thread B servicing epoll event)
  *
- * The original implementation with counters to track expiry counts
- * was abandoned in favor of "in doubt" transitions and resolution
- * at shutdown.
+ * so the expiry count is only used as a hint.  The proactor timer lives
+ * as long as the proactor, it is never shut down while in doubt.
  */
 
 typedef struct ptimer_t {
@@ -168,20 +173,15 @@ typedef struct ptimer_t {
   int timerfd;
   epoll_extended_t epoll_io;
   bool timer_active;
-  bool in_doubt;  // 0 or 1 callbacks are possible
-  bool shutting_down;
 } ptimer_t;
 
-static bool ptimer_init(ptimer_t *pt, struct psocket_t *ps) {
+static bool ptimer_init(ptimer_t *pt) {
   pt->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
   pmutex_init(&pt->mutex);
   pt->timer_active = false;
-  pt->in_doubt = false;
-  pt->shutting_down = false;
-  epoll_type_t type = ps ? PCONNECTION_TIMER : PROACTOR_TIMER;
-  pt->epoll_io.psocket = ps;
+  pt->epoll_io.psocket = NULL;
   pt->epoll_io.fd = pt->timerfd;
-  pt->epoll_io.type = type;
+  pt->epoll_io.type = PROACTOR_TIMER;
   pt->epoll_io.wanted = EPOLLIN;
   pt->epoll_io.polling = false;
   return (pt->timerfd >= 0);
@@ -189,23 +189,19 @@ static bool ptimer_init(ptimer_t *pt, struct psocket_t *ps) {
 
 // Call with ptimer lock held
 static void ptimer_set_lh(ptimer_t *pt, uint64_t t_millis) {
-  struct itimerspec newt, oldt;
+  struct itimerspec newt;
   memset(&newt, 0, sizeof(newt));
   newt.it_value.tv_sec = t_millis / 1000;
   newt.it_value.tv_nsec = (t_millis % 1000) * 1000000;
 
-  timerfd_settime(pt->timerfd, 0, &newt, &oldt);
-  if (pt->timer_active && oldt.it_value.tv_nsec == 0 && oldt.it_value.tv_sec == 0) {
-    // EPOLLIN is possible but not assured
-    pt->in_doubt = true;
-  }
+  timerfd_settime(pt->timerfd, 0, &newt, NULL);
   pt->timer_active = t_millis;
 }
 
 static void ptimer_set(ptimer_t *pt, uint64_t t_millis) {
   // t_millis == 0 -> cancel
   lock(&pt->mutex);
-  if ((t_millis == 0 && !pt->timer_active) || pt->shutting_down) {
+  if (t_millis == 0 && !pt->timer_active) {
     unlock(&pt->mutex);
     return;  // nothing to do
   }
@@ -232,36 +228,73 @@ static bool ptimer_callback(ptimer_t *pt) {
       pt->timer_active = false;
   }
   uint64_t u_exp_count = read_uint64(pt->timerfd);
-  if (!pt->timer_active) {
-    // Expiry counter just cleared, timer not set, timerfd not armed
-    pt->in_doubt = false;
-  }
   unlock(&pt->mutex);
   return u_exp_count > 0;
 }
 
-// Return true if timerfd has and will have no pollable expiries in the current armed state
-static bool ptimer_shutdown(ptimer_t *pt, bool currently_armed) {
-  lock(&pt->mutex);
-  if (currently_armed) {
-    ptimer_set_lh(pt, 0);
-    pt->shutting_down = true;
-    if (pt->in_doubt)
-      // Force at least one callback.  If two, second cannot proceed with unarmed timerfd.
-      ptimer_set_lh(pt, 1);
-  }
-  else
-    pt->shutting_down = true;
-  bool rv = !pt->in_doubt;
-  unlock(&pt->mutex);
-  return rv;
-}
-
 static void ptimer_finalize(ptimer_t *pt) {
   if (pt->timerfd >= 0) close(pt->timerfd);
   pmutex_finalize(&pt->mutex);
 }
 
+/*
+ * Connection ticks (for idle timeouts) share a single timerfd per shard.
+ * Deadlines are kept in a binary min-heap and the timerfd is set for the
+ * earliest. When it fires each expired connection is woken with tick_pending
+ * set. A connection only resets its deadline when the transport's next tick
+ * time changes, see pconnection_tick().
+ *
+ * The timerfd is only reset when the earliest deadline moves earlier. A
+ * deadline moving later leaves an early expiry that finds nothing to do and
+ * re-sets the timerfd, so a connection pushing its next tick out after every
+ * read normally costs no system call.
+ *
+ * Lock order: timer heap mutex, then pconnection context mutex.
+ */
+typedef struct ptimer_heap_t {
+  pmutex mutex;
+  int timerfd;
+  epoll_extended_t epoll_io;
+  struct pconnection_t **heap;
+  size_t size;
+  size_t capacity;
+  uint64_t armed;               /* Deadline the timerfd is set for, 0 if none */
+} ptimer_heap_t;
+
+#define TIMER_UNSCHEDULED SIZE_MAX
+
+static bool ptimer_heap_init(ptimer_heap_t *th) {
+  th->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  pmutex_init(&th->mutex);
+  th->epoll_io.psocket = NULL;
+  th->epoll_io.fd = th->timerfd;
+  th->epoll_io.type = PCONNECTION_TIMERS;
+  th->epoll_io.wanted = EPOLLIN;
+  th->epoll_io.polling = false;
+  th->heap = NULL;
+  th->size = th->capacity = 0;
+  th->armed = 0;
+  return (th->timerfd >= 0);
+}
+
+static void ptimer_heap_finalize(ptimer_heap_t *th) {
+  if (th->timerfd >= 0) close(th->timerfd);
+  free(th->heap);
+  pmutex_finalize(&th->mutex);
+}
+
+static uint64_t monotonic_millis(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec) * 1000 + t.tv_nsec / 1000000;
+}
+
+static uint64_t monotonic_nanos(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec * 1000000000) + t.tv_nsec;
+}
+
 pn_timestamp_t pn_i_now2(void)
 {
   struct timespec now;
@@ -282,6 +315,17 @@ const char *AMQP_PORT_NAME = "amqp";
 // and increases latency.
 #define HOG_MAX 1
 
+// The most bytes read from a connection socket in one pass of
+// pconnection_process().  Reading continues while the socket fills the
+// transport's read buffer, so a busy connection processes many frames per
+// epoll wakeup, but other work on the connection still gets a turn.
+#define READ_MAX (256 * 1024)
+
+// The most output buffers written by one sendmsg().
+// pn_connection_driver_write_buffers() hands out at most 3: the flat output
+// buffer and the two parts of the frame ring buffer.
+#define WRITE_IOV_MAX 4
+
 /* pn_proactor_t and pn_listener_t are plain C structs with normal memory management.
    Class definitions are for identification as pn_event_t context only.
 */
@@ -295,6 +339,7 @@ static bool start_polling(epoll_extended_t *ee, int epollfd) {
   struct epoll_event ev = {0};
   ev.data.ptr = ee;
   ev.events = ee->wanted | EPOLLONESHOT;
+  ee->epollfd = epollfd;
   memory_barrier(ee);
   return (epoll_ctl(epollfd, EPOLL_CTL_ADD, ee->fd, &ev) == 0);
 }
@@ -367,14 +412,20 @@ typedef enum {
   LISTENER,
   WAKEABLE } pcontext_type_t;
 
+/* Link in a shard's lock-free wake list */
+typedef struct pwake_link_t {
+  struct pwake_link_t *next;
+} pwake_link_t;
+
 typedef struct pcontext_t {
   pmutex mutex;
   pn_proactor_t *proactor;  /* Immutable */
   void *owner;              /* Instance governed by the context */
   pcontext_type_t type;
   bool working;
+  struct pshard_t *shard;   /* Immutable once in use */
   int wake_ops;             // unprocessed eventfd wake callback (convert to bool?)
-  struct pcontext_t *wake_next; // wake list, guarded by proactor eventfd_mutex
+  pwake_link_t wake_link;   // shard wake list, see wake()
   bool closing;
   // Next 4 are protected by the proactor mutex
   struct pcontext_t* next;  /* Protected by proactor.mutex */
@@ -406,16 +457,57 @@ typedef struct psocket_t {
   const char *host, *port;
 } psocket_t;
 
-struct pn_proactor_t {
-  pcontext_t context;
+/*
+ * **** shards ****
+ *
+ * A proactor has one or more shards, each an independent epollfd (with its
+ * epollfd_2 and wake eventfd).  Connections and listeners are assigned to a
+ * shard in turn and only ever polled and woken there.  Threads blocking in
+ * pn_proactor_wait() are likewise assigned a home shard in turn on their
+ * first call, so threads of different shards do not contend in the kernel or
+ * on the wake list.  Threads that only poll with pn_proactor_get() may stop
+ * calling at any time, so they are never given a shard: they poll their home
+ * shard if they have one, otherwise the first.
+ *
+ * Proactor timeouts belong to the first shard, each shard ticks its own
+ * connections from its own timer heap.  The proactor has its own wake and
+ * interrupt eventfds, polled by every shard, so that proactor events reach
+ * threads blocked on any of them even after the first shard's threads exit.
+ * Until a shard has a thread of its own its epollfd is chained into the first
+ * shard's epollfd (ORPHAN_SHARD) and serviced by those threads, so the
+ * proactor works with any number of threads.
+ */
+typedef struct pshard_t {
   int epollfd;
   int epollfd_2;
+  epoll_extended_t epoll_secondary;
+  // wake subsystem
+  int eventfd;
+  bool wakes_in_progress;       /* Atomic */
+  pwake_link_t *wake_tail;      /* Atomic, last pushed by wakers */
+  pwake_link_t *wake_head;      /* Next to pop, only the thread processing epoll_wake */
+  pwake_link_t wake_stub;
+  epoll_extended_t epoll_wake;
+  epoll_extended_t epoll_interrupt;  /* The proactor interruptfd */
+  epoll_extended_t epoll_proactor_wake;  /* The proactor wakefd */
+  // chained into the first shard while no thread is assigned
+  epoll_extended_t epoll_orphan;
+  pmutex orphan_mutex;
+  size_t threads;               /* Threads with this home shard, protected by orphan_mutex */
+  ptimer_heap_t timer_heap;     /* ticks of the shard's connections */
+  uint64_t wakeups;             /* Atomic, epoll_wait() returns for pn_proactor_stats() */
+} pshard_t;
+
+struct pn_proactor_t {
+  pcontext_t context;
+  pshard_t *shards;
+  size_t shard_count;
+  size_t next_shard;            /* Next shard to assign to a context, protected by proactor mutex */
+  size_t next_home;             /* Next home shard for a thread, protected by proactor mutex */
+  pthread_key_t home_shard;     /* Home shard of each thread, if shard_count > 1 */
   ptimer_t timer;
   pn_collector_t *collector;
   pcontext_t *contexts;         /* in-use contexts for PN_PROACTOR_INACTIVE and cleanup */
-  epoll_extended_t epoll_wake;
-  epoll_extended_t epoll_interrupt;
-  epoll_extended_t epoll_secondary;
   pn_event_batch_t batch;
   size_t disconnects_pending;   /* unfinished proactor disconnects*/
   // need_xxx flags indicate we should generate PN_PROACTOR_XXX on the next update_batch()
@@ -426,14 +518,14 @@ struct pn_proactor_t {
   bool timeout_processed;  /* timeout event dispatched in the most recent event batch */
   bool timer_armed; /* timer is armed in epoll */
   bool shutting_down;
-  // wake subsystem
-  int eventfd;
-  pmutex eventfd_mutex;
-  bool wakes_in_progress;
-  pcontext_t *wake_list_first;
-  pcontext_t *wake_list_last;
   // Interrupts have a dedicated eventfd because they must be async-signal safe.
   int interruptfd;
+  // Wakes of the proactor context, not on a shard wake list so any shard can take them.
+  int wakefd;
+  size_t zerocopy_threshold;    /* Atomic, see pn_proactor_set_zerocopy_threshold() */
+  uint32_t busy_poll;           /* Atomic, microseconds to spin before blocking in epoll_wait() */
+  bool stats_enabled;           /* Atomic, see pn_proactor_stats_enable() */
+  pn_proactor_stats_t stats;    /* Totals of connections no longer on the contexts list, protected by proactor mutex */
   // If the process runs out of file descriptors, disarm listening sockets temporarily and save them here.
   acceptor_t *overflow;
   pmutex overflow_mutex;
@@ -441,6 +533,44 @@ struct pn_proactor_t {
 
 static void rearm(pn_proactor_t *p, epoll_extended_t *ee);
 
+static inline bool stats_enabled(pn_proactor_t *p) {
+  return __atomic_load_n(&p->stats_enabled, __ATOMIC_RELAXED);
+}
+
+// Update a counter with a single writer, read by other threads.
+static inline void stat_add(uint64_t *stat, uint64_t n) {
+  __atomic_store_n(stat, __atomic_load_n(stat, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_get(const uint64_t *stat) {
+  return __atomic_load_n(stat, __ATOMIC_RELAXED);
+}
+
+// Add the counters in s to sum.
+static void stats_sum(pn_proactor_stats_t *sum, const pn_proactor_stats_t *s) {
+  sum->read_ns += stat_get(&s->read_ns);
+  sum->process_ns += stat_get(&s->process_ns);
+  sum->dispatch_ns += stat_get(&s->dispatch_ns);
+  sum->write_ns += stat_get(&s->write_ns);
+  sum->wakeups += stat_get(&s->wakeups);
+  sum->rearms += stat_get(&s->rearms);
+  sum->hog_yields += stat_get(&s->hog_yields);
+  sum->wakes += stat_get(&s->wakes);
+  sum->wake_delay_ns += stat_get(&s->wake_delay_ns);
+  uint64_t max = stat_get(&s->wake_delay_max_ns);
+  if (max > sum->wake_delay_max_ns) sum->wake_delay_max_ns = max;
+}
+
+// Shard for a new connection or listener.
+static pshard_t *proactor_next_shard(pn_proactor_t *p) {
+  if (p->shard_count == 1)
+    return &p->shards[0];
+  lock(&p->context.mutex);
+  pshard_t *s = &p->shards[p->next_shard++ % p->shard_count];
+  unlock(&p->context.mutex);
+  return s;
+}
+
 /*
  * Wake strategy with eventfd.
  *  - wakees can be in the list only once
@@ -450,29 +580,67 @@ static void rearm(pn_proactor_t *p, epoll_extended_t *ee);
  * Otherwise it is the trio of write/read/rearm.
  * Only the writes and reads need to be carefully ordered.
  *
+ * The wake list is an intrusive multi-producer single-consumer queue
+ * (D. Vyukov) so wakers never block each other or the wakee.  Wakers
+ * push with a single atomic exchange of the tail.  There is only one
+ * wakee at a time: the thread that got the EPOLLONESHOT event of
+ * epoll_wake pops, then rearms.  A waker that has exchanged the tail
+ * but not yet linked its predecessor leaves the list briefly
+ * inconsistent: the wakee then leaves the eventfd set and tries again.
+ *
  * Multiple eventfds could be used and shared amongst the pcontext_t's.
  */
 
+static void wake_list_init(pshard_t *s) {
+  s->wake_stub.next = NULL;
+  s->wake_head = s->wake_tail = &s->wake_stub;
+}
+
+static void wake_list_push(pshard_t *s, pwake_link_t *link) {
+  __atomic_store_n(&link->next, NULL, __ATOMIC_RELAXED);
+  pwake_link_t *prev = __atomic_exchange_n(&s->wake_tail, link, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&prev->next, link, __ATOMIC_RELEASE);
+}
+
+// wakee only: true if nothing is pushed, not even partially
+static bool wake_list_empty(pshard_t *s) {
+  return s->wake_head == &s->wake_stub &&
+    __atomic_load_n(&s->wake_stub.next, __ATOMIC_ACQUIRE) == NULL &&
+    __atomic_load_n(&s->wake_tail, __ATOMIC_SEQ_CST) == &s->wake_stub;
+}
+
+// wakee only: NULL if empty or inconsistent
+static pcontext_t *wake_list_pop(pshard_t *s) {
+  pwake_link_t *head = s->wake_head;
+  pwake_link_t *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+  if (head == &s->wake_stub) {
+    if (!next) return NULL;
+    s->wake_head = head = next;
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+  }
+  if (!next) {
+    if (head != __atomic_load_n(&s->wake_tail, __ATOMIC_SEQ_CST))
+      return NULL;              /* Waker mid-push */
+    wake_list_push(s, &s->wake_stub);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (!next) return NULL;     /* Waker mid-push */
+  }
+  s->wake_head = next;
+  return (pcontext_t*)((char*)head - offsetof(pcontext_t, wake_link));
+}
+
 // part1: call with ctx->owner lock held, return true if notify required by caller
 static bool wake(pcontext_t *ctx) {
   bool notify = false;
   if (!ctx->wake_ops) {
     if (!ctx->working) {
       ctx->wake_ops++;
-      pn_proactor_t *p = ctx->proactor;
-      lock(&p->eventfd_mutex);
-      if (!p->wake_list_first) {
-        p->wake_list_first = p->wake_list_last = ctx;
-      } else {
-        p->wake_list_last->wake_next = ctx;
-        p->wake_list_last = ctx;
-      }
-      if (!p->wakes_in_progress) {
-        // force a wakeup via the eventfd
-        p->wakes_in_progress = true;
-        notify = true;
-      }
-      unlock(&p->eventfd_mutex);
+      if (ctx->type == PROACTOR)
+        return true;            /* Has its own eventfd, see wake_notify() */
+      pshard_t *s = ctx->shard;
+      wake_list_push(s, &ctx->wake_link);
+      // force a wakeup via the eventfd unless one is in progress
+      notify = !__atomic_exchange_n(&s->wakes_in_progress, true, __ATOMIC_SEQ_CST);
     }
   }
   return notify;
@@ -480,35 +648,32 @@ static bool wake(pcontext_t *ctx) {
 
 // part2: make OS call without lock held
 static inline void wake_notify(pcontext_t *ctx) {
-  if (ctx->proactor->eventfd == -1)
+  int fd = (ctx->type == PROACTOR) ? ((pn_proactor_t*)ctx->owner)->wakefd : ctx->shard->eventfd;
+  if (fd == -1)
     return;
   uint64_t increment = 1;
-  if (write(ctx->proactor->eventfd, &increment, sizeof(uint64_t)) != sizeof(uint64_t))
+  if (write(fd, &increment, sizeof(uint64_t)) != sizeof(uint64_t))
     EPOLL_FATAL("setting eventfd", errno);
 }
 
 // call with no locks
-static pcontext_t *wake_pop_front(pn_proactor_t *p) {
-  pcontext_t *ctx = NULL;
-  lock(&p->eventfd_mutex);
-  assert(p->wakes_in_progress);
-  if (p->wake_list_first) {
-    ctx = p->wake_list_first;
-    p->wake_list_first = ctx->wake_next;
-    if (!p->wake_list_first) p->wake_list_last = NULL;
-    ctx->wake_next = NULL;
-
-    if (!p->wake_list_first) {
-      /* Reset the eventfd until a future write.
-       * Can the read system call be made without holding the lock?
-       * Note that if the reads/writes happen out of order, the wake
-       * mechanism will hang. */
-      (void)read_uint64(p->eventfd);
-      p->wakes_in_progress = false;
+static pcontext_t *wake_pop_front(pn_proactor_t *p, pshard_t *s) {
+  assert(__atomic_load_n(&s->wakes_in_progress, __ATOMIC_SEQ_CST));
+  pcontext_t *ctx = wake_list_pop(s);
+  if (wake_list_empty(s)) {
+    /* Reset the eventfd until a future write.  The read must come before
+     * clearing wakes_in_progress: if the reads/writes happen out of order,
+     * the wake mechanism will hang. */
+    (void)read_uint64(s->eventfd);
+    __atomic_store_n(&s->wakes_in_progress, false, __ATOMIC_SEQ_CST);
+    /* A waker that pushed before the store saw wakes_in_progress set */
+    if (!wake_list_empty(s) && !__atomic_exchange_n(&s->wakes_in_progress, true, __ATOMIC_SEQ_CST)) {
+      uint64_t increment = 1;
+      if (write(s->eventfd, &increment, sizeof(uint64_t)) != sizeof(uint64_t))
+        EPOLL_FATAL("setting eventfd", errno);
     }
   }
-  unlock(&p->eventfd_mutex);
-  rearm(p, &p->epoll_wake);
+  rearm(p, &s->epoll_wake);
   return ctx;
 }
 
@@ -526,6 +691,7 @@ static void psocket_init(psocket_t* ps, pn_proactor_t* p, pn_listener_t *listene
   ps->epoll_io.type = listener ? LISTENER_IO : PCONNECTION_IO;
   ps->epoll_io.wanted = 0;
   ps->epoll_io.polling = false;
+  ps->epoll_io.epollfd = -1;
   ps->proactor = p;
   ps->listener = listener;
   ps->sockfd = -1;
@@ -540,19 +706,37 @@ typedef struct pconnection_t {
   int wake_count;
   bool server;                /* accept, not connect */
   bool tick_pending;
-  bool timer_armed;
   bool queued_disconnect;     /* deferred from pn_proactor_disconnect() */
   pn_condition_t *disconnect_condition;
-  ptimer_t timer;  // TODO: review one timerfd per connection
+  // Next 2 are protected by the shard timer_heap mutex
+  uint64_t timer_deadline;    /* monotonic milliseconds */
+  size_t timer_index;         /* position in timer heap or TIMER_UNSCHEDULED */
   // Following values only changed by (sole) working context:
+  uint64_t tick_next;    // transport tick time the timer is set for, 0 if none
   uint32_t current_arm;  // active epoll io events
   uint32_t current_arm_2;  // secondary active epoll io events
   bool connected;
   bool read_blocked;
   bool write_blocked;
   bool disconnected;
+  bool zerocopy;         // SO_ZEROCOPY is enabled on the socket
   int hog_count; // thread hogging limiter
+  // MSG_ZEROCOPY output.  The kernel sends straight from memory until each
+  // send is reported complete on the socket error queue, so the frames are
+  // taken out of the transport (pni_transport_take_output()) to be left
+  // alone meanwhile, whatever the transport writes next.
+  pn_buffer_t *zc_output; // frames taken, NULL unless sending or waiting on them
+  pn_buffer_t *zc_spare;  // empty buffer given to the transport for the next take
+  size_t zc_size;        // total bytes in zc_output
+  size_t zc_sent;        // bytes of zc_output sent so far
+  uint32_t zc_sends;     // zerocopy sends not yet completed
   pn_event_batch_t batch;
+  // Counters for pn_connection_stats(). Only updated by the working context
+  // or with the context mutex held, read by any thread.
+  pn_proactor_stats_t stats;
+  uint64_t wake_nanos;        /* First pn_connection_wake() not yet delivered, protected by context mutex */
+  uint64_t batch_nanos;       /* When the current batch was returned */
+  uint64_t batch_io_nanos;    /* IO time counted when the current batch was returned */
   pn_connection_driver_t driver;
   struct pn_netaddr_t local, remote; /* Actual addresses */
   struct addrinfo *addrinfo;         /* Resolved address list */
@@ -562,29 +746,31 @@ typedef struct pconnection_t {
   epoll_extended_t *rearm_target;    /* main or secondary epollfd */
 } pconnection_t;
 
-/* Protects read/update of pn_connnection_t pointer to it's pconnection_t
+/* Read/update of pn_connnection_t pointer to it's pconnection_t
  *
- * Global because pn_connection_wake()/pn_connection_proactor() navigate from
- * the pn_connection_t before we know the proactor or driver. Critical sections
- * are small: only get/set of the pn_connection_t driver pointer.
- *
- * TODO: replace mutex with atomic load/store
+ * pn_connection_wake()/pn_connection_proactor() navigate from the
+ * pn_connection_t in any thread, before we know the proactor or driver.  The
+ * pointer is read atomically and protected by a hazard pointer while the
+ * pconnection_t is in use, pconnection_final_free() waits for such readers.
  */
-static pthread_mutex_t driver_ptr_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pconnection_t *driver_pconnection(pn_connection_driver_t *d) {
+  return d ? (pconnection_t*)((char*)d-offsetof(pconnection_t, driver)) : NULL;
+}
 
+// Only for the thread working on the connection, which keeps it alive
 static pconnection_t *get_pconnection(pn_connection_t* c) {
   if (!c) return NULL;
-  lock(&driver_ptr_mutex);
-  pn_connection_driver_t *d = *pn_connection_driver_ptr(c);
-  unlock(&driver_ptr_mutex);
-  if (!d) return NULL;
-  return (pconnection_t*)((char*)d-offsetof(pconnection_t, driver));
+  return driver_pconnection(__atomic_load_n(pn_connection_driver_ptr(c), __ATOMIC_ACQUIRE));
+}
+
+// Any thread: pconnection_t is not freed until pni_hazard_release(h)
+static pconnection_t *acquire_pconnection(pni_hazard_t *h, pn_connection_t* c) {
+  if (!c) return NULL;
+  return driver_pconnection((pn_connection_driver_t*)pni_hazard_acquire(h, (void**)pn_connection_driver_ptr(c)));
 }
 
 static void set_pconnection(pn_connection_t* c, pconnection_t *pc) {
-  lock(&driver_ptr_mutex);
-  *pn_connection_driver_ptr(c) = pc ? &pc->driver : NULL;
-  unlock(&driver_ptr_mutex);
+  pni_hazard_publish((void**)pn_connection_driver_ptr(c), pc ? &pc->driver : NULL);
 }
 
 /*
@@ -619,11 +805,12 @@ struct pn_listener_t {
   int pending_count;
   bool unclaimed;                 /* attach event dispatched but no pn_listener_attach() call yet */
   size_t backlog;
+  size_t reuseport;               /* SO_REUSEPORT sockets per address, 0 for a plain socket */
   bool close_dispatched;
   pmutex rearm_mutex;             /* orders rearms/disarms, nothing else */
 };
 
-static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events, bool timeout, bool topup, bool is_io_2);
+static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events, bool topup, bool is_io_2);
 static void write_flush(pconnection_t *pc);
 static void listener_begin_close(pn_listener_t* l);
 static void proactor_add(pcontext_t *ctx);
@@ -691,7 +878,9 @@ static pn_event_t *log_event(void* p, pn_event_t *e) {
 
 static void psocket_error_str(psocket_t *ps, const char *msg, const char* what) {
   if (!ps->listener) {
-    pn_connection_driver_t *driver = &psocket_pconnection(ps)->driver;
+    pconnection_t *pc = psocket_pconnection(ps);
+    pc->zc_size = pc->zc_sent;         /* Output taken for zerocopy is not sent */
+    pn_connection_driver_t *driver = &pc->driver;
     pn_connection_driver_bind(driver); /* Bind so errors will be reported */
     pni_proactor_set_cond(pn_transport_condition(driver->transport), what, ps->host, ps->port, msg);
     pn_connection_driver_close(driver);
@@ -717,7 +906,7 @@ static void rearm(pn_proactor_t *p, epoll_extended_t *ee) {
   ev.data.ptr = ee;
   ev.events = ee->wanted | EPOLLONESHOT;
   memory_barrier(ee);
-  if (epoll_ctl(p->epollfd, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
+  if (epoll_ctl(ee->epollfd, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
     EPOLL_FATAL("arming polled file descriptor", errno);
 }
 
@@ -728,13 +917,13 @@ static void rearm_2(pn_proactor_t *p, epoll_extended_t *ee) {
   // disabled event registered until the next EPOLLONESHOT.
   if (!ee->polling) {
     ee->fd = ee->psocket->sockfd;
-    start_polling(ee, p->epollfd_2);
+    start_polling(ee, psocket_pconnection(ee->psocket)->context.shard->epollfd_2);
   } else {
     struct epoll_event ev = {0};
     ev.data.ptr = ee;
     ev.events = ee->wanted | EPOLLONESHOT;
     memory_barrier(ee);
-    if (epoll_ctl(p->epollfd_2, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
+    if (epoll_ctl(ee->epollfd, EPOLL_CTL_MOD, ee->fd, &ev) == -1)
       EPOLL_FATAL("arming polled file descriptor (secondary)", errno);
   }
 }
@@ -814,6 +1003,114 @@ static int pclosefd(pn_proactor_t *p, int fd) {
 
 static void pconnection_tick(pconnection_t *pc);
 
+// Timer heap operations, call with the timer heap mutex held
+
+static inline void timer_heap_place(ptimer_heap_t *th, size_t i, pconnection_t *pc) {
+  th->heap[i] = pc;
+  pc->timer_index = i;
+}
+
+// Move the entry at i up or down to its place
+static void timer_heap_fix(ptimer_heap_t *th, size_t i) {
+  pconnection_t *pc = th->heap[i];
+  uint64_t deadline = pc->timer_deadline;
+  while (i > 0 && th->heap[(i - 1) / 2]->timer_deadline > deadline) {
+    timer_heap_place(th, i, th->heap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= th->size) break;
+    if (child + 1 < th->size && th->heap[child + 1]->timer_deadline < th->heap[child]->timer_deadline)
+      ++child;
+    if (th->heap[child]->timer_deadline >= deadline) break;
+    timer_heap_place(th, i, th->heap[child]);
+    i = child;
+  }
+  timer_heap_place(th, i, pc);
+}
+
+static void timer_heap_remove(ptimer_heap_t *th, pconnection_t *pc) {
+  size_t i = pc->timer_index;
+  pc->timer_index = TIMER_UNSCHEDULED;
+  pconnection_t *last = th->heap[--th->size];
+  if (i < th->size) {
+    timer_heap_place(th, i, last);
+    timer_heap_fix(th, i);
+  }
+}
+
+// Set the timerfd for the earliest deadline unless it expires before then anyway
+static void timer_heap_arm(ptimer_heap_t *th) {
+  if (!th->size) return;
+  uint64_t deadline = th->heap[0]->timer_deadline;
+  if (th->armed && th->armed <= deadline) return;
+  struct itimerspec newt;
+  memset(&newt, 0, sizeof(newt));
+  newt.it_value.tv_sec = deadline / 1000;
+  newt.it_value.tv_nsec = (deadline % 1000) * 1000000;
+  timerfd_settime(th->timerfd, TFD_TIMER_ABSTIME, &newt, NULL);
+  th->armed = deadline;
+}
+
+// Schedule a tick for pc in t_millis, 0 cancels.  Call without pc lock.
+// Return false if out of memory.
+static bool pconnection_timer_set(pconnection_t *pc, uint64_t t_millis) {
+  ptimer_heap_t *th = &pc->context.shard->timer_heap;
+  bool ok = true;
+  lock(&th->mutex);
+  if (!t_millis) {
+    if (pc->timer_index != TIMER_UNSCHEDULED)
+      timer_heap_remove(th, pc);
+  } else {
+    pc->timer_deadline = monotonic_millis() + t_millis;
+    if (pc->timer_index == TIMER_UNSCHEDULED) {
+      if (th->size == th->capacity) {
+        size_t capacity = th->capacity ? 2 * th->capacity : 64;
+        pconnection_t **heap = (pconnection_t **) realloc(th->heap, capacity * sizeof(pconnection_t *));
+        if (heap) {
+          th->heap = heap;
+          th->capacity = capacity;
+        } else {
+          ok = false;
+        }
+      }
+      if (ok) timer_heap_place(th, th->size++, pc);
+    }
+    if (ok) {
+      timer_heap_fix(th, pc->timer_index);
+      timer_heap_arm(th);
+    }
+  }
+  unlock(&th->mutex);
+  return ok;
+}
+
+// Wake the connections that are due a tick.  Their work is done in the wake.
+static pn_event_batch_t *timer_heap_process(pn_proactor_t *p, epoll_extended_t *ee) {
+  ptimer_heap_t *th = (ptimer_heap_t*)((char*)ee - offsetof(ptimer_heap_t, epoll_io));
+  (void)read_uint64(th->timerfd);
+  lock(&th->mutex);
+  th->armed = 0;
+  uint64_t now = monotonic_millis();
+  while (th->size && th->heap[0]->timer_deadline <= now) {
+    pconnection_t *pc = th->heap[0];
+    timer_heap_remove(th, pc);
+    lock(&pc->context.mutex);
+    bool notify = false;
+    if (!pc->context.closing) {
+      pc->tick_pending = true;
+      notify = wake(&pc->context);
+    }
+    unlock(&pc->context.mutex);
+    if (notify) wake_notify(&pc->context);  // pc cannot be freed while it can be in the heap
+  }
+  timer_heap_arm(th);
+  unlock(&th->mutex);
+  rearm(p, &th->epoll_io);
+  return NULL;
+}
+
 static const char *pconnection_setup(pconnection_t *pc, pn_proactor_t *p, pn_connection_t *c, pn_transport_t *t, bool server, const char *addr)
 {
   memset(pc, 0, sizeof(*pc));
@@ -824,14 +1121,15 @@ static const char *pconnection_setup(pconnection_t *pc, pn_proactor_t *p, pn_con
   }
 
   pcontext_init(&pc->context, PCONNECTION, p, pc);
+  pc->context.shard = proactor_next_shard(p);
   psocket_init(&pc->psocket, p, NULL, addr);
   pc->new_events = 0;
   pc->new_events_2 = 0;
   pc->wake_count = 0;
   pc->tick_pending = false;
-  pc->timer_armed = false;
   pc->queued_disconnect = false;
   pc->disconnect_condition = NULL;
+  pc->timer_index = TIMER_UNSCHEDULED;
 
   pc->current_arm = 0;
   pc->current_arm_2 = 0;
@@ -846,10 +1144,6 @@ static const char *pconnection_setup(pconnection_t *pc, pn_proactor_t *p, pn_con
     pn_transport_set_server(pc->driver.transport);
   }
 
-  if (!ptimer_init(&pc->timer, &pc->psocket)) {
-    psocket_error(&pc->psocket, errno, "timer setup");
-    pc->disconnected = true;    /* Already failed */
-  }
   pmutex_init(&pc->rearm_mutex);
 
   epoll_extended_t *ee = &pc->epoll_io_2;
@@ -868,10 +1162,11 @@ static const char *pconnection_setup(pconnection_t *pc, pn_proactor_t *p, pn_con
   return NULL;
 }
 
-// Call with lock held and closing == true (i.e. pn_connection_driver_finished() == true), timer cancelled.
+// Call with lock held and closing == true (i.e. pn_connection_driver_finished() == true).
 // Return true when all possible outstanding epoll events associated with this pconnection have been processed.
+// An expiring tick does not wake a closing pconnection.
 static inline bool pconnection_is_final(pconnection_t *pc) {
-  return !pc->current_arm && !pc->current_arm_2 && !pc->timer_armed && !pc->context.wake_ops;
+  return !pc->current_arm && !pc->current_arm_2 && !pc->context.wake_ops;
 }
 
 static void pconnection_final_free(pconnection_t *pc) {
@@ -881,23 +1176,25 @@ static void pconnection_final_free(pconnection_t *pc) {
   if (pc->driver.connection) {
     set_pconnection(pc->driver.connection, NULL);
   }
+  pni_hazard_wait(&pc->driver);
   if (pc->addrinfo) {
     freeaddrinfo(pc->addrinfo);
   }
   pmutex_finalize(&pc->rearm_mutex);
   pn_condition_free(pc->disconnect_condition);
   pn_connection_driver_destroy(&pc->driver);
+  pn_buffer_free(pc->zc_output);
+  pn_buffer_free(pc->zc_spare);
   pcontext_finalize(&pc->context);
   free(pc);
 }
 
 // call without lock, but only if pconnection_is_final() is true
 static void pconnection_cleanup(pconnection_t *pc) {
-  stop_polling(&pc->psocket.epoll_io, pc->psocket.proactor->epollfd);
+  pconnection_timer_set(pc, 0);
+  stop_polling(&pc->psocket.epoll_io, pc->context.shard->epollfd);
   if (pc->psocket.sockfd != -1)
     pclosefd(pc->psocket.proactor, pc->psocket.sockfd);
-  stop_polling(&pc->timer.epoll_io, pc->psocket.proactor->epollfd);
-  ptimer_finalize(&pc->timer);
   lock(&pc->context.mutex);
   bool can_free = proactor_remove(&pc->context);
   unlock(&pc->context.mutex);
@@ -916,13 +1213,6 @@ static void pconnection_begin_close(pconnection_t *pc) {
     }
 
     pn_connection_driver_close(&pc->driver);
-    if (ptimer_shutdown(&pc->timer, pc->timer_armed))
-      pc->timer_armed = false;  // disarmed in the sense that the timer will never fire again
-    else if (!pc->timer_armed) {
-      // In doubt.  One last callback to collect
-      rearm(pc->psocket.proactor, &pc->timer.epoll_io);
-      pc->timer_armed = true;
-    }
   }
 }
 
@@ -934,7 +1224,6 @@ static void pconnection_forced_shutdown(pconnection_t *pc) {
   pc->new_events_2 = 0;
   pconnection_begin_close(pc);
   // pconnection_process will never be called again.  Zero everything.
-  pc->timer_armed = false;
   pc->context.wake_ops = 0;
   pn_collector_release(pc->driver.collector);
   assert(pconnection_is_final(pc));
@@ -949,9 +1238,11 @@ static pn_event_t *pconnection_batch_next(pn_event_batch_t *batch) {
     write_flush(pc);  // May generate transport event
     e = pn_connection_driver_next_event(&pc->driver);
     if (!e && pc->hog_count < HOG_MAX) {
-      if (pconnection_process(pc, 0, false, true, false)) {
+      if (pconnection_process(pc, 0, true, false)) {
         e = pn_connection_driver_next_event(&pc->driver);
       }
+    } else if (!e && stats_enabled(pc->psocket.proactor)) {
+      stat_add(&pc->stats.hog_yields, 1);
     }
   }
   return e;
@@ -962,8 +1253,26 @@ static inline bool pconnection_rclosed(pconnection_t  *pc) {
   return pn_connection_driver_read_closed(&pc->driver);
 }
 
+/* True if output taken from the transport for zerocopy is not all sent */
+static inline bool pconnection_zc_held(pconnection_t *pc) {
+  return pc->zc_sent < pc->zc_size;
+}
+
+/* True if all taken output is sent, waiting for the zerocopy completions */
+static inline bool pconnection_zc_waiting(pconnection_t *pc) {
+  return pc->zc_output && !pconnection_zc_held(pc);
+}
+
 static inline bool pconnection_wclosed(pconnection_t  *pc) {
-  return pn_connection_driver_write_closed(&pc->driver);
+  return pn_connection_driver_write_closed(&pc->driver) && !pconnection_zc_held(pc);
+}
+
+/* True if there is output not yet written to the socket */
+static bool pconnection_write_pending(pconnection_t *pc) {
+  if (pconnection_zc_held(pc))
+    return true;
+  pn_bytes_t wbuf;
+  return pn_connection_driver_write_buffers(&pc->driver, &wbuf, 1) > 0;
 }
 
 /* Call only from working context (no competitor for pc->current_arm or
@@ -982,17 +1291,15 @@ static bool pconnection_rearm_check(pconnection_t *pc) {
   }
   uint32_t wanted_now = (pc->read_blocked && !pconnection_rclosed(pc)) ? EPOLLIN : 0;
   if (!pconnection_wclosed(pc)) {
-    if (pc->write_blocked)
+    if (pc->write_blocked || pconnection_write_pending(pc))
       wanted_now |= EPOLLOUT;
-    else {
-      pn_bytes_t wbuf = pn_connection_driver_write_buffer(&pc->driver);
-      if (wbuf.size > 0)
-        wanted_now |= EPOLLOUT;
-    }
   }
+  uint32_t have_now = pc->current_arm ?  pc->current_arm : pc->current_arm_2;
+  // Zerocopy completions are reported as EPOLLERR, which any armed event includes
+  if (!wanted_now && !have_now && pconnection_zc_waiting(pc))
+    wanted_now = EPOLLERR;
   if (!wanted_now) return false;
 
-  uint32_t have_now = pc->current_arm ?  pc->current_arm : pc->current_arm_2;
   uint32_t needed = wanted_now & ~have_now;
   if (!needed) return false;
 
@@ -1005,6 +1312,7 @@ static bool pconnection_rearm_check(pconnection_t *pc) {
     pc->current_arm_2 = pc->epoll_io_2.wanted = needed;
     pc->rearm_target = &pc->epoll_io_2;
   }
+  if (stats_enabled(pc->psocket.proactor)) stat_add(&pc->stats.rearms, 1);
   return true;                     /* ... so caller MUST call pconnection_rearm */
 }
 
@@ -1025,12 +1333,33 @@ static inline bool pconnection_work_pending(pconnection_t *pc) {
     return true;
   if (!pc->read_blocked && !pconnection_rclosed(pc))
     return true;
-  pn_bytes_t wbuf = pn_connection_driver_write_buffer(&pc->driver);
-  return (wbuf.size > 0 && !pc->write_blocked);
+  return !pc->write_blocked && pconnection_write_pending(pc);
+}
+
+// Total IO time counted for a connection.
+static inline uint64_t pconnection_io_nanos(pconnection_t *pc) {
+  return pc->stats.read_ns + pc->stats.process_ns + pc->stats.write_ns;
+}
+
+// A batch is being returned by pconnection_process().
+static pn_event_batch_t *pconnection_batch(pconnection_t *pc) {
+  if (stats_enabled(pc->psocket.proactor)) {
+    pc->batch_nanos = monotonic_nanos();
+    pc->batch_io_nanos = pconnection_io_nanos(pc);
+  } else {
+    pc->batch_nanos = 0;
+  }
+  return &pc->batch;
 }
 
 static void pconnection_done(pconnection_t *pc) {
   bool notify = false;
+  if (pc->batch_nanos) {         /* Time in the batch not spent on IO */
+    uint64_t elapsed = monotonic_nanos() - pc->batch_nanos;
+    uint64_t io = pconnection_io_nanos(pc) - pc->batch_io_nanos;
+    stat_add(&pc->stats.dispatch_ns, elapsed > io ? elapsed - io : 0);
+    pc->batch_nanos = 0;
+  }
   lock(&pc->context.mutex);
   pc->context.working = false;  // So we can wake() ourself if necessary.  We remain the de facto
                                 // working context while the lock is held.
@@ -1052,27 +1381,143 @@ static void pconnection_done(pconnection_t *pc) {
   return;
 }
 
+/* Fill iov from bufs, skipping the first skip bytes. Return the iov count. */
+static size_t pconnection_iov(struct iovec *iov, const pn_bytes_t *bufs, size_t n, size_t skip) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (skip >= bufs[i].size) {
+      skip -= bufs[i].size;
+      continue;
+    }
+    iov[count].iov_base = (void*)(bufs[i].start + skip);
+    iov[count].iov_len = bufs[i].size - skip;
+    skip = 0;
+    ++count;
+  }
+  return count;
+}
+
+/* Keep the taken output for the next take once the kernel is done with it */
+static void pconnection_zc_release(pconnection_t *pc) {
+  if (pconnection_zc_waiting(pc) && !pc->zc_sends) {
+    pn_buffer_clear(pc->zc_output);
+    if (pc->zc_spare)
+      pn_buffer_free(pc->zc_output);
+    else
+      pc->zc_spare = pc->zc_output;
+    pc->zc_output = NULL;
+    pc->zc_size = pc->zc_sent = 0;
+  }
+}
+
+/* Zerocopy completions also raise EPOLLERR, only a pending socket error is a
+   real error. Getting SO_ERROR clears it so report it here, with the context
+   mutex held by the working thread. */
+static bool pconnection_zc_error_lh(pconnection_t *pc) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(pc->psocket.sockfd, SOL_SOCKET, SO_ERROR, &err, &len) || !err)
+    return false;
+  pc->disconnected = true;
+  psocket_error(&pc->psocket, err, "disconnected");
+  return true;
+}
+
+/* Read zerocopy completions from the socket error queue */
+static void pconnection_zc_complete(pconnection_t *pc) {
+  while (pc->zc_sends) {
+    char control[128];
+    struct msghdr msg = {0};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(pc->psocket.sockfd, &msg, MSG_ERRQUEUE) < 0)
+      break;                    /* Nothing more yet */
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if ((cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR) ||
+          (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        struct sock_extended_err ee;
+        memcpy(&ee, CMSG_DATA(cm), sizeof(ee));
+        if (ee.ee_errno == 0 && ee.ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+          /* Completes sends numbered ee_info to ee_data inclusive */
+          uint32_t n = ee.ee_data - ee.ee_info + 1;
+          pc->zc_sends -= (n < pc->zc_sends) ? n : pc->zc_sends;
+        }
+      }
+    }
+  }
+  pconnection_zc_release(pc);
+}
+
 // Return true unless error
-static bool pconnection_write(pconnection_t *pc, pn_bytes_t wbuf) {
-  ssize_t n = send(pc->psocket.sockfd, wbuf.start, wbuf.size, MSG_NOSIGNAL);
+static bool pconnection_write(pconnection_t *pc) {
+  struct iovec iov[WRITE_IOV_MAX];
+  struct msghdr msg = {0};
+  msg.msg_iov = iov;
+  int flags = MSG_NOSIGNAL;
+  pn_bytes_t bufs[WRITE_IOV_MAX];
+  size_t size;
+  bool held = pconnection_zc_held(pc);
+  if (held) {                   /* Continue sending the taken output */
+    size_t count = pn_buffer_segments(pc->zc_output, bufs);
+    msg.msg_iovlen = pconnection_iov(iov, bufs, count, pc->zc_sent);
+    size = pc->zc_size - pc->zc_sent;
+    flags |= MSG_ZEROCOPY;
+  } else {
+    size_t count = pn_connection_driver_write_buffers(&pc->driver, bufs, WRITE_IOV_MAX);
+    size = 0;
+    for (size_t i = 0; i < count; ++i)
+      size += bufs[i].size;
+    if (!size) return true;
+    size_t threshold = __atomic_load_n(&pc->psocket.proactor->zerocopy_threshold, __ATOMIC_RELAXED);
+    if (pc->zerocopy && threshold && size >= threshold && !pc->zc_output) {
+      /* Take the frames, the kernel reads them until the send completes */
+      if (!pc->zc_spare) pc->zc_spare = pn_buffer(0);
+      pn_buffer_t *taken = pc->zc_spare ? pni_transport_take_output(pc->driver.transport, pc->zc_spare) : NULL;
+      if (taken) {
+        pc->zc_output = taken;
+        pc->zc_spare = NULL;
+        count = pn_buffer_segments(taken, bufs);
+        size = pc->zc_size = pn_buffer_size(taken);
+        pc->zc_sent = 0;
+        held = true;
+        flags |= MSG_ZEROCOPY;
+      }
+    }
+    msg.msg_iovlen = pconnection_iov(iov, bufs, count, 0);
+  }
+  ssize_t n = sendmsg(pc->psocket.sockfd, &msg, flags);
+  if (n < 0 && errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+    /* Over the socket's limit for pinned memory, copy this part instead */
+    flags &= ~MSG_ZEROCOPY;
+    n = sendmsg(pc->psocket.sockfd, &msg, flags);
+  }
   if (n > 0) {
-    pn_connection_driver_write_done(&pc->driver, n);
-    if ((size_t) n < wbuf.size) pc->write_blocked = true;
+    if (flags & MSG_ZEROCOPY)
+      ++pc->zc_sends;
+    if (held)
+      pc->zc_sent += n;
+    else
+      pn_connection_driver_write_done(&pc->driver, n);
+    if ((size_t) n < size) pc->write_blocked = true;
   } else if (errno == EWOULDBLOCK) {
     pc->write_blocked = true;
   } else if (!(errno == EAGAIN || errno == EINTR)) {
     return false;
   }
+  pconnection_zc_release(pc);   /* In case nothing was sent zerocopy */
   return true;
 }
 
 static void write_flush(pconnection_t *pc) {
+  if (pc->zc_output)
+    pconnection_zc_complete(pc);
   if (!pc->write_blocked && !pconnection_wclosed(pc)) {
-    pn_bytes_t wbuf = pn_connection_driver_write_buffer(&pc->driver);
-    if (wbuf.size > 0) {
-      if (!pconnection_write(pc, wbuf)) {
+    if (pconnection_write_pending(pc)) {
+      uint64_t start = stats_enabled(pc->psocket.proactor) ? monotonic_nanos() : 0;
+      if (!pconnection_write(pc)) {
         psocket_error(&pc->psocket, errno, pc->disconnected ? "disconnected" : "on write to");
       }
+      if (start) stat_add(&pc->stats.write_ns, monotonic_nanos() - start);
     }
     else {
       if (pn_connection_driver_write_closed(&pc->driver)) {
@@ -1089,46 +1534,35 @@ static void pconnection_maybe_connect_lh(pconnection_t *pc);
 /*
  * May be called concurrently from multiple threads:
  *   pn_event_batch_t loop (topup is true)
- *   timer (timeout is true)
  *   socket io (events != 0) from PCONNECTION_IO
  *      and PCONNECTION_IO_2 event masks (possibly simultaneously)
  *   one or more wake()
  * Only one thread becomes (or always was) the working thread.
  */
-static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events, bool timeout, bool topup, bool is_io_2) {
-  bool inbound_wake = !(events | timeout | topup);
-  bool rearm_timer = false;
-  bool timer_fired = false;
+static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events, bool topup, bool is_io_2) {
+  bool inbound_wake = !(events | topup);
   bool waking = false;
   bool tick_required = false;
 
   // Don't touch data exclusive to working thread (yet).
 
-  if (timeout) {
-    rearm_timer = true;
-    timer_fired = ptimer_callback(&pc->timer) != 0;
-  }
   lock(&pc->context.mutex);
 
+  bool stats = stats_enabled(pc->psocket.proactor);
+  uint64_t wake_nanos = 0;
   if (events) {
     if (is_io_2)
       pc->new_events_2 = events;
     else
       pc->new_events = events;
     events = 0;
-  }
-  else if (timer_fired) {
-    pc->tick_pending = true;
-    timer_fired = false;
+    if (stats) stat_add(&pc->stats.wakeups, 1);
   }
   else if (inbound_wake) {
     wake_done(&pc->context);
     inbound_wake = false;
   }
 
-  if (rearm_timer)
-    pc->timer_armed = false;
-
   if (topup) {
     // Only called by the batch owner.  Does not loop, just "tops up"
     // once.  May be back depending on hog_count.
@@ -1159,15 +1593,18 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
 
   if (pconnection_has_event(pc)) {
     unlock(&pc->context.mutex);
-    return &pc->batch;
+    return pconnection_batch(pc);
   }
   bool closed = pconnection_rclosed(pc) && pconnection_wclosed(pc);
   if (pc->wake_count) {
     waking = !closed;
     pc->wake_count = 0;
+    wake_nanos = pc->wake_nanos;
+    pc->wake_nanos = 0;
   }
   if (pc->tick_pending) {
     pc->tick_pending = false;
+    pc->tick_next = 0;          /* The timer heap no longer has it */
     tick_required = !closed;
   }
 
@@ -1184,7 +1621,10 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
   }
   if (update_events) {
     if (!pc->context.closing) {
-      if ((update_events & (EPOLLHUP | EPOLLERR)) && !pconnection_rclosed(pc) && !pconnection_wclosed(pc))
+      uint32_t error_events = update_events & (EPOLLHUP | EPOLLERR);
+      if ((error_events & EPOLLERR) && pc->zc_sends && !pconnection_zc_error_lh(pc))
+        error_events &= ~EPOLLERR; /* Zerocopy completions, not an error */
+      if (error_events && !pconnection_rclosed(pc) && !pconnection_wclosed(pc))
         pconnection_maybe_connect_lh(pc);
       else
         pconnection_connected_lh(pc); /* Non error event means we are connected */
@@ -1208,31 +1648,50 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
     pn_connection_t *c = pc->driver.connection;
     pn_collector_put(pn_connection_collector(c), PN_OBJECT, c, PN_CONNECTION_WAKE);
     waking = false;
+    if (stats) {
+      stat_add(&pc->stats.wakes, 1);
+      if (wake_nanos) {
+        uint64_t delay = monotonic_nanos() - wake_nanos;
+        stat_add(&pc->stats.wake_delay_ns, delay);
+        if (delay > pc->stats.wake_delay_max_ns)
+          __atomic_store_n(&pc->stats.wake_delay_max_ns, delay, __ATOMIC_RELAXED);
+      }
+    }
   }
 
   // read... tick... write
   // perhaps should be: write_if_recent_EPOLLOUT... read... tick... write
 
-  if (!pconnection_rclosed(pc)) {
+  size_t read_budget = READ_MAX;
+  while (!pconnection_rclosed(pc) && !pc->read_blocked && read_budget > 0) {
     pn_rwbytes_t rbuf = pn_connection_driver_read_buffer(&pc->driver);
-    if (rbuf.size > 0 && !pc->read_blocked) {
-      ssize_t n = read(pc->psocket.sockfd, rbuf.start, rbuf.size);
-
-      if (n > 0) {
-        pn_connection_driver_read_done(&pc->driver, n);
-        pconnection_tick(pc);         /* check for tick changes. */
-        tick_required = false;
-        if (!pn_connection_driver_read_closed(&pc->driver) && (size_t)n < rbuf.size)
-          pc->read_blocked = true;
+    if (rbuf.size == 0) break;  /* Transport can't take more input yet */
+    size_t size = rbuf.size < read_budget ? rbuf.size : read_budget;
+    uint64_t start = stats ? monotonic_nanos() : 0;
+    ssize_t n = read(pc->psocket.sockfd, rbuf.start, size);
+
+    if (n > 0) {
+      if (stats) {
+        uint64_t now = monotonic_nanos();
+        stat_add(&pc->stats.read_ns, now - start);
+        start = now;
       }
-      else if (n == 0) {
-        pn_connection_driver_read_close(&pc->driver);
-      }
-      else if (errno == EWOULDBLOCK)
-        pc->read_blocked = true;
-      else if (!(errno == EAGAIN || errno == EINTR)) {
+      pn_connection_driver_read_done(&pc->driver, n);
+      if (stats) stat_add(&pc->stats.process_ns, monotonic_nanos() - start);
+      tick_required = true;     /* check for tick changes. */
+      read_budget -= n;
+      if (!pn_connection_driver_read_closed(&pc->driver) && (size_t)n < size)
+        pc->read_blocked = true;  /* Socket drained */
+    }
+    else if (n == 0) {
+      pn_connection_driver_read_close(&pc->driver);
+    }
+    else if (errno == EWOULDBLOCK)
+      pc->read_blocked = true;
+    else if (errno != EINTR) {
+      if (errno != EAGAIN)
         psocket_error(&pc->psocket, errno, pc->disconnected ? "disconnected" : "on read from");
-      }
+      break;
     }
   }
 
@@ -1247,7 +1706,7 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
   }
 
   if (pconnection_has_event(pc)) {
-    return &pc->batch;
+    return pconnection_batch(pc);
   }
 
   write_flush(pc);
@@ -1274,10 +1733,6 @@ static pn_event_batch_t *pconnection_process(pconnection_t *pc, uint32_t events,
     }
   }
 
-  if (!pc->timer_armed && !pc->timer.shutting_down && pc->timer.timerfd >= 0) {
-    pc->timer_armed = true;
-    rearm(pc->psocket.proactor, &pc->timer.epoll_io);
-  }
   bool rearm_pc = pconnection_rearm_check(pc);  // holds rearm_mutex until pconnection_rearm() below
 
   unlock(&pc->context.mutex);
@@ -1310,9 +1765,7 @@ void pconnection_connected_lh(pconnection_t *pc) {
 
 /* multi-address connections may call pconnection_start multiple times with diffferent FDs  */
 static void pconnection_start(pconnection_t *pc) {
-  int efd = pc->psocket.proactor->epollfd;
-  /* Start timer, a no-op if the timer has already started. */
-  start_polling(&pc->timer.epoll_io, efd);  // TODO: check for error
+  int efd = pc->context.shard->epollfd;
 
   /* Get the local socket name now, get the peer name in pconnection_connected */
   socklen_t len = sizeof(pc->local.ss);
@@ -1325,6 +1778,15 @@ static void pconnection_start(pconnection_t *pc) {
     pclosefd(pc->psocket.proactor, fd);
   }
   ee->fd = pc->psocket.sockfd;
+  if (__atomic_load_n(&pc->psocket.proactor->zerocopy_threshold, __ATOMIC_RELAXED)) {
+    int on = 1;
+    pc->zerocopy = !setsockopt(pc->psocket.sockfd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on));
+  }
+  int busy_poll = __atomic_load_n(&pc->psocket.proactor->busy_poll, __ATOMIC_RELAXED);
+  if (busy_poll) {
+    /* May need CAP_NET_ADMIN, the spinning in epoll_wait() still helps without it */
+    (void)setsockopt(pc->psocket.sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll));
+  }
   pc->current_arm = ee->wanted = EPOLLIN | EPOLLOUT;
   start_polling(ee, efd);  // TODO: check for error
 }
@@ -1425,32 +1887,41 @@ void pn_proactor_connect2(pn_proactor_t *p, pn_connection_t *c, pn_transport_t *
 static void pconnection_tick(pconnection_t *pc) {
   pn_transport_t *t = pc->driver.transport;
   if (pn_transport_get_idle_timeout(t) || pn_transport_get_remote_idle_timeout(t)) {
-    ptimer_set(&pc->timer, 0);
     uint64_t now = pn_i_now2();
     uint64_t next = pn_transport_tick(t, now);
-    if (next) {
-      ptimer_set(&pc->timer, next - now);
+    /* Most reads leave the next tick time unchanged: keep the timer as it is */
+    if (next == pc->tick_next) return;
+    /* A deadline already due gets the next expiry */
+    if (!pconnection_timer_set(pc, next ? (next > now ? next - now : 1) : 0)) {
+      psocket_error(&pc->psocket, ENOMEM, "timer setup");
+    } else {
+      pc->tick_next = next;
     }
   }
 }
 
 void pn_connection_wake(pn_connection_t* c) {
   bool notify = false;
-  pconnection_t *pc = get_pconnection(c);
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
   if (pc) {
     lock(&pc->context.mutex);
     if (!pc->context.closing) {
+      if (!pc->wake_count && stats_enabled(pc->psocket.proactor))
+        pc->wake_nanos = monotonic_nanos();
       pc->wake_count++;
       notify = wake(&pc->context);
     }
     unlock(&pc->context.mutex);
   }
   if (notify) wake_notify(&pc->context);
+  pni_hazard_release(h);
 }
 
 void pn_proactor_release_connection(pn_connection_t *c) {
   bool notify = false;
-  pconnection_t *pc = get_pconnection(c);
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
   if (pc) {
     set_pconnection(c, NULL);
     lock(&pc->context.mutex);
@@ -1460,6 +1931,7 @@ void pn_proactor_release_connection(pn_connection_t *c) {
     unlock(&pc->context.mutex);
   }
   if (notify) wake_notify(&pc->context);
+  pni_hazard_release(h);
 }
 
 // ========================================================================
@@ -1492,7 +1964,8 @@ void pn_proactor_listen(pn_proactor_t *p, pn_listener_t *l, const char *addr, in
 {
   // TODO: check listener not already listening for this or another proactor
   lock(&l->context.mutex);
-  l->context.proactor = p;;
+  l->context.proactor = p;
+  l->context.shard = proactor_next_shard(p);
   l->backlog = backlog;
 
   char addr_buf[PN_MAX_ADDR];
@@ -1508,47 +1981,60 @@ void pn_proactor_listen(pn_proactor_t *p, pn_listener_t *l, const char *addr, in
       ++len;
     }
     assert(len > 0);            /* guaranteed by getaddrinfo */
-    l->acceptors = (acceptor_t*)calloc(len, sizeof(acceptor_t));
+    /* With SO_REUSEPORT, several sockets for each address */
+    size_t per_addr = l->reuseport ? l->reuseport : 1;
+    l->acceptors = (acceptor_t*)calloc(len * per_addr, sizeof(acceptor_t));
     assert(l->acceptors);      /* TODO aconway 2017-05-05: memory safety */
     l->acceptors_size = 0;
     uint16_t dynamic_port = 0;  /* Record dynamic port from first bind(0) */
+    struct pn_netaddr_t *last_addr = NULL; /* End of the distinct address list */
     /* Find working listen addresses */
     for (struct addrinfo *ai = addrinfo; ai; ai = ai->ai_next) {
-      if (dynamic_port) set_port(ai->ai_addr, dynamic_port);
-      int fd = socket(ai->ai_family, SOCK_STREAM, ai->ai_protocol);
-      static int on = 1;
-      if (fd >= 0) {
-        if (!setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) &&
-            /* We listen to v4/v6 on separate sockets, don't let v6 listen for v4 */
-            (ai->ai_family != AF_INET6 ||
-             !setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on))) &&
-            !bind(fd, ai->ai_addr, ai->ai_addrlen) &&
-            !listen(fd, backlog))
-        {
-          acceptor_t *acceptor = &l->acceptors[l->acceptors_size++];
-          /* Get actual address */
-          socklen_t len = pn_netaddr_socklen(&acceptor->addr);
-          (void)getsockname(fd, (struct sockaddr*)(&acceptor->addr.ss), &len);
-          if (acceptor == l->acceptors) { /* First acceptor, check for dynamic port */
-            dynamic_port = check_dynamic_port(ai->ai_addr, pn_netaddr_sockaddr(&acceptor->addr));
-          } else {              /* Link addr to previous addr */
-            (acceptor-1)->addr.next = &acceptor->addr;
+      bool have_addr = false;   /* Some socket for this address is listening */
+      for (size_t i = 0; i < per_addr; ++i) {
+        if (dynamic_port) set_port(ai->ai_addr, dynamic_port);
+        int fd = socket(ai->ai_family, SOCK_STREAM, ai->ai_protocol);
+        static int on = 1;
+        if (fd >= 0) {
+          if (!setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) &&
+              (!l->reuseport || !setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on))) &&
+              /* We listen to v4/v6 on separate sockets, don't let v6 listen for v4 */
+              (ai->ai_family != AF_INET6 ||
+               !setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on))) &&
+              !bind(fd, ai->ai_addr, ai->ai_addrlen) &&
+              !listen(fd, backlog))
+          {
+            acceptor_t *acceptor = &l->acceptors[l->acceptors_size++];
+            /* Get actual address */
+            socklen_t len = pn_netaddr_socklen(&acceptor->addr);
+            (void)getsockname(fd, (struct sockaddr*)(&acceptor->addr.ss), &len);
+            if (acceptor == l->acceptors) { /* First acceptor, check for dynamic port */
+              dynamic_port = check_dynamic_port(ai->ai_addr, pn_netaddr_sockaddr(&acceptor->addr));
+            }
+            if (!have_addr) {   /* Link addr to previous addr, skip SO_REUSEPORT copies */
+              if (last_addr) last_addr->next = &acceptor->addr;
+              last_addr = &acceptor->addr;
+              have_addr = true;
+            }
+
+            acceptor->accepted_fd = -1;
+            psocket_t *ps = &acceptor->psocket;
+            psocket_init(ps, p, l, addr);
+            ps->sockfd = fd;
+            ps->epoll_io.fd = fd;
+            ps->epoll_io.wanted = EPOLLIN;
+            ps->epoll_io.polling = false;
+            /* Spread the SO_REUSEPORT copies over the shards, so each
+               copy's accepts are done by the threads of its shard. */
+            pshard_t *s = i ? proactor_next_shard(p) : l->context.shard;
+            lock(&l->rearm_mutex);
+            start_polling(&ps->epoll_io, s->epollfd);  // TODO: check for error
+            l->active_count++;
+            acceptor->armed = true;
+            unlock(&l->rearm_mutex);
+          } else {
+            close(fd);
           }
-
-          acceptor->accepted_fd = -1;
-          psocket_t *ps = &acceptor->psocket;
-          psocket_init(ps, p, l, addr);
-          ps->sockfd = fd;
-          ps->epoll_io.fd = fd;
-          ps->epoll_io.wanted = EPOLLIN;
-          ps->epoll_io.polling = false;
-          lock(&l->rearm_mutex);
-          start_polling(&ps->epoll_io, ps->proactor->epollfd);  // TODO: check for error
-          l->active_count++;
-          acceptor->armed = true;
-          unlock(&l->rearm_mutex);
-        } else {
-          close(fd);
         }
       }
     }
@@ -1623,7 +2109,7 @@ static void listener_begin_close(pn_listener_t* l) {
         if (a->armed) {
           shutdown(ps->sockfd, SHUT_RD);  // Force epoll event and callback
         } else {
-          stop_polling(&ps->epoll_io, ps->proactor->epollfd);
+          stop_polling(&ps->epoll_io, ps->epoll_io.epollfd);
           close(ps->sockfd);
           ps->sockfd = -1;
           l->active_count--;
@@ -1704,7 +2190,7 @@ static pn_event_batch_t *listener_process(psocket_t *ps, uint32_t events) {
     a->armed = false;
     if (l->context.closing) {
       lock(&l->rearm_mutex);
-      stop_polling(&ps->epoll_io, ps->proactor->epollfd);
+      stop_polling(&ps->epoll_io, ps->epoll_io.epollfd);
       unlock(&l->rearm_mutex);
       close(ps->sockfd);
       ps->sockfd = -1;
@@ -1771,6 +2257,10 @@ static void listener_done(pn_listener_t *l) {
   if (notify) wake_notify(&l->context);
 }
 
+void pn_listener_set_reuseport(pn_listener_t *l, size_t sockets) {
+  l->reuseport = sockets;
+}
+
 pn_proactor_t *pn_listener_proactor(pn_listener_t* l) {
   return l ? l->acceptors[0].psocket.proactor : NULL;
 }
@@ -1867,51 +2357,115 @@ static void epoll_secondary_init(epoll_extended_t *ee, int epoll_fd_2, int epoll
   start_polling(ee, epollfd);  // TODO: check for error
 }
 
-pn_proactor_t *pn_proactor() {
+/* Set up the epoll_extended_t that chains an unattended shard into the first shard */
+static void epoll_orphan_init(epoll_extended_t *ee, int shard_epollfd, int epollfd) {
+  ee->psocket = NULL;
+  ee->fd = shard_epollfd;
+  ee->type = ORPHAN_SHARD;
+  ee->wanted = EPOLLIN;
+  ee->polling = false;
+  start_polling(ee, epollfd);  // TODO: check for error
+}
+
+static bool pshard_init(pshard_t *s) {
+  s->eventfd = s->epollfd_2 = -1;
+  wake_list_init(s);
+  pmutex_init(&s->orphan_mutex);
+  bool timers = ptimer_heap_init(&s->timer_heap);
+  if ((s->epollfd = epoll_create(1)) >= 0 && (s->epollfd_2 = epoll_create(1)) >= 0) {
+    if ((s->eventfd = eventfd(0, EFD_NONBLOCK)) >= 0 && timers) {
+      epoll_wake_init(&s->epoll_wake, s->eventfd, s->epollfd);
+      epoll_secondary_init(&s->epoll_secondary, s->epollfd_2, s->epollfd);
+      start_polling(&s->timer_heap.epoll_io, s->epollfd);  // TODO: check for error
+      return true;
+    }
+  }
+  return false;
+}
+
+static void pshard_finalize(pshard_t *s) {
+  if (s->epollfd >= 0) close(s->epollfd);
+  s->epollfd = -1;
+  if (s->epollfd_2 >= 0) close(s->epollfd_2);
+  s->epollfd_2 = -1;
+  if (s->eventfd >= 0) close(s->eventfd);
+  s->eventfd = -1;
+  ptimer_heap_finalize(&s->timer_heap);
+  pmutex_finalize(&s->orphan_mutex);
+}
+
+static void proactor_release_home(void *home);
+
+pn_proactor_t *pn_proactor_sharded(size_t shards) {
+  if (shards == 0) shards = 1;
   pn_proactor_t *p = (pn_proactor_t*)calloc(1, sizeof(*p));
   if (!p) return NULL;
-  p->epollfd = p->eventfd = p->timer.timerfd = -1;
+  p->timer.timerfd = p->interruptfd = p->wakefd = -1;
+  const char *zerocopy = getenv("PN_ZEROCOPY_THRESHOLD"); /* Default for pn_proactor_set_zerocopy_threshold() */
+  if (zerocopy) p->zerocopy_threshold = strtoul(zerocopy, NULL, 10);
   pcontext_init(&p->context, PROACTOR, p, p);
-  pmutex_init(&p->eventfd_mutex);
-  ptimer_init(&p->timer, 0);
-
-  if ((p->epollfd = epoll_create(1)) >= 0 && (p->epollfd_2 = epoll_create(1)) >= 0) {
-    if ((p->eventfd = eventfd(0, EFD_NONBLOCK)) >= 0) {
-      if ((p->interruptfd = eventfd(0, EFD_NONBLOCK)) >= 0) {
-        if (p->timer.timerfd >= 0)
-          if ((p->collector = pn_collector()) != NULL) {
-            p->batch.next_event = &proactor_batch_next;
-            start_polling(&p->timer.epoll_io, p->epollfd);  // TODO: check for error
-            p->timer_armed = true;
-            epoll_wake_init(&p->epoll_wake, p->eventfd, p->epollfd);
-            epoll_wake_init(&p->epoll_interrupt, p->interruptfd, p->epollfd);
-            epoll_secondary_init(&p->epoll_secondary, p->epollfd_2, p->epollfd);
-            return p;
+  ptimer_init(&p->timer);
+
+  bool ok = (p->shards = (pshard_t*)calloc(shards, sizeof(pshard_t))) != NULL;
+  for (size_t i = 0; ok && i < shards; ++i) {
+    p->shard_count = i + 1;
+    ok = pshard_init(&p->shards[i]);
+  }
+  if (ok && shards > 1)
+    ok = pthread_key_create(&p->home_shard, proactor_release_home) == 0;
+  if (ok) {
+    pshard_t *s0 = &p->shards[0];
+    p->context.shard = s0;
+    if ((p->interruptfd = eventfd(0, EFD_NONBLOCK)) >= 0 &&
+        (p->wakefd = eventfd(0, EFD_NONBLOCK)) >= 0) {
+      if (p->timer.timerfd >= 0)
+        if ((p->collector = pn_collector()) != NULL) {
+          p->batch.next_event = &proactor_batch_next;
+          start_polling(&p->timer.epoll_io, s0->epollfd);  // TODO: check for error
+          p->timer_armed = true;
+          for (size_t i = 0; i < shards; ++i) {
+            epoll_wake_init(&p->shards[i].epoll_interrupt, p->interruptfd, p->shards[i].epollfd);
+            epoll_wake_init(&p->shards[i].epoll_proactor_wake, p->wakefd, p->shards[i].epollfd);
           }
-      }
+          for (size_t i = 1; i < shards; ++i)
+            epoll_orphan_init(&p->shards[i].epoll_orphan, p->shards[i].epollfd, s0->epollfd);
+          return p;
+        }
     }
+    if (shards > 1) pthread_key_delete(p->home_shard);
   }
-  if (p->epollfd >= 0) close(p->epollfd);
-  if (p->epollfd_2 >= 0) close(p->epollfd_2);
-  if (p->eventfd >= 0) close(p->eventfd);
+  for (size_t i = 0; i < p->shard_count; ++i)
+    pshard_finalize(&p->shards[i]);
+  free(p->shards);
   if (p->interruptfd >= 0) close(p->interruptfd);
+  if (p->wakefd >= 0) close(p->wakefd);
   ptimer_finalize(&p->timer);
   if (p->collector) pn_free(p->collector);
   free (p);
   return NULL;
 }
 
+pn_proactor_t *pn_proactor() {
+  return pn_proactor_sharded(1);
+}
+
 void pn_proactor_free(pn_proactor_t *p) {
   //  No competing threads, not even a pending timer
   p->shutting_down = true;
-  close(p->epollfd);
-  p->epollfd = -1;
-  close(p->epollfd_2);
-  p->epollfd_2 = -1;
-  close(p->eventfd);
-  p->eventfd = -1;
+  if (p->shard_count > 1) pthread_key_delete(p->home_shard);
+  for (size_t i = 0; i < p->shard_count; ++i) {
+    pshard_t *s = &p->shards[i];
+    close(s->epollfd);
+    s->epollfd = -1;
+    close(s->epollfd_2);
+    s->epollfd_2 = -1;
+    close(s->eventfd);
+    s->eventfd = -1;
+  }
   close(p->interruptfd);
   p->interruptfd = -1;
+  close(p->wakefd);
+  p->wakefd = -1;
   ptimer_finalize(&p->timer);
   while (p->contexts) {
     pcontext_t *ctx = p->contexts;
@@ -1927,9 +2481,10 @@ void pn_proactor_free(pn_proactor_t *p) {
       break;
     }
   }
-
   pn_collector_free(p->collector);
-  pmutex_finalize(&p->eventfd_mutex);
+  for (size_t i = 0; i < p->shard_count; ++i)
+    pshard_finalize(&p->shards[i]);
+  free(p->shards);
   pcontext_finalize(&p->context);
   free(p);
 }
@@ -2004,7 +2559,7 @@ static pn_event_batch_t *proactor_process(pn_proactor_t *p, pn_event_type_t even
       return &p->batch;
     }
   }
-  bool rearm_timer = !p->timer_armed && !p->timer.shutting_down;
+  bool rearm_timer = !p->timer_armed && !p->shutting_down;
   p->timer_armed = true;
   unlock(&p->context.mutex);
   if (rearm_timer)
@@ -2012,23 +2567,23 @@ static pn_event_batch_t *proactor_process(pn_proactor_t *p, pn_event_type_t even
   return NULL;
 }
 
-static pn_event_batch_t *proactor_chained_epoll_wait(pn_proactor_t *p) {
+static pn_event_batch_t *proactor_chained_epoll_wait(pn_proactor_t *p, pshard_t *s) {
   // process one ready pconnection socket event from the secondary/chained epollfd_2
   struct epoll_event ev = {0};
-  int n = epoll_wait(p->epollfd_2, &ev, 1, 0);
+  int n = epoll_wait(s->epollfd_2, &ev, 1, 0);
   if (n < 0) {
     if (errno != EINTR)
       perror("epoll_wait"); // TODO: proper log
   } else if (n > 0) {
     assert(n == 1);
-    rearm(p, &p->epoll_secondary);
+    rearm(p, &s->epoll_secondary);
     epoll_extended_t *ee = (epoll_extended_t *) ev.data.ptr;
     memory_barrier(ee);
     assert(ee->type == PCONNECTION_IO_2);
     pconnection_t *pc = psocket_pconnection(ee->psocket);
-    return pconnection_process(pc, ev.events, false, false, true);
+    return pconnection_process(pc, ev.events, false, true);
   }
-  rearm(p, &p->epoll_secondary);
+  rearm(p, &s->epoll_secondary);
   return NULL;
 }
 
@@ -2059,6 +2614,8 @@ static bool proactor_remove(pcontext_t *ctx) {
   }
   else {
     // normal case
+    pconnection_t *pc = pcontext_pconnection(ctx);
+    if (pc) stats_sum(&p->stats, &pc->stats);  /* Keep the proactor totals */
     if (ctx->prev)
       ctx->prev->next = ctx->next;
     else {
@@ -2079,17 +2636,22 @@ static bool proactor_remove(pcontext_t *ctx) {
 
 static pn_event_batch_t *process_inbound_wake(pn_proactor_t *p, epoll_extended_t *ee) {
   if  (ee->fd == p->interruptfd) {        /* Interrupts have their own dedicated eventfd */
-    (void)read_uint64(p->interruptfd);
-    rearm(p, &p->epoll_interrupt);
-    return proactor_process(p, PN_PROACTOR_INTERRUPT);
-  }
-  pcontext_t *ctx = wake_pop_front(p);
+    uint64_t n = read_uint64(p->interruptfd);
+    rearm(p, ee);
+    /* Every shard polls the eventfd, another may have read it first */
+    return n ? proactor_process(p, PN_PROACTOR_INTERRUPT) : NULL;
+  }
+  if  (ee->fd == p->wakefd) {
+    uint64_t n = read_uint64(p->wakefd);
+    rearm(p, ee);
+    return n ? proactor_process(p, PN_EVENT_NONE) : NULL;
+  }
+  pshard_t *s = (pshard_t*)((char*)ee - offsetof(pshard_t, epoll_wake));
+  pcontext_t *ctx = wake_pop_front(p, s);
   if (ctx) {
     switch (ctx->type) {
-     case PROACTOR:
-      return proactor_process(p, PN_EVENT_NONE);
      case PCONNECTION:
-      return pconnection_process((pconnection_t *) ctx->owner, 0, false, false, false);
+      return pconnection_process((pconnection_t *) ctx->owner, 0, false, false);
      case LISTENER:
       return listener_process(&((pn_listener_t *) ctx->owner)->acceptors[0].psocket, 0);
      default:
@@ -2099,12 +2661,104 @@ static pn_event_batch_t *process_inbound_wake(pn_proactor_t *p, epoll_extended_t
   return NULL;
 }
 
+static pn_event_batch_t *proactor_orphan_epoll_wait(pn_proactor_t *p, pshard_t *s);
+
+static pn_event_batch_t *proactor_dispatch(pn_proactor_t *p, struct epoll_event *ev) {
+  epoll_extended_t *ee = (epoll_extended_t *) ev->data.ptr;
+  memory_barrier(ee);
+
+  if (ee->type == WAKE) {
+    return process_inbound_wake(p, ee);
+  } else if (ee->type == PROACTOR_TIMER) {
+    return proactor_process(p, PN_PROACTOR_TIMEOUT);
+  } else if (ee->type == PCONNECTION_TIMERS) {
+    return timer_heap_process(p, ee);
+  } else if (ee->type == CHAINED_EPOLL) {
+    pshard_t *s = (pshard_t*)((char*)ee - offsetof(pshard_t, epoll_secondary));
+    return proactor_chained_epoll_wait(p, s);  // expect a PCONNECTION_IO_2
+  } else if (ee->type == ORPHAN_SHARD) {
+    pshard_t *s = (pshard_t*)((char*)ee - offsetof(pshard_t, epoll_orphan));
+    return proactor_orphan_epoll_wait(p, s);
+  } else {
+    pconnection_t *pc = psocket_pconnection(ee->psocket);
+    if (pc) {
+      assert(ee->type == PCONNECTION_IO);
+      return pconnection_process(pc, ev->events, false, false);
+    }
+    else {
+      // TODO: can any of the listener processing be parallelized like IOCP?
+      return listener_process(ee->psocket, ev->events);
+    }
+  }
+}
+
+// Process one ready event of a shard that has no thread of its own yet.
+static pn_event_batch_t *proactor_orphan_epoll_wait(pn_proactor_t *p, pshard_t *s) {
+  struct epoll_event ev = {0};
+  lock(&s->orphan_mutex);
+  if (!s->epoll_orphan.polling) {  /* A thread has adopted the shard */
+    unlock(&s->orphan_mutex);
+    return NULL;
+  }
+  int n = epoll_wait(s->epollfd, &ev, 1, 0);
+  if (n < 0 && errno != EINTR)
+    perror("epoll_wait"); // TODO: proper log
+  rearm(p, &s->epoll_orphan);
+  unlock(&s->orphan_mutex);
+  return (n > 0) ? proactor_dispatch(p, &ev) : NULL;
+}
+
+// Thread specific data destructor: the thread is gone, orphan its shard if it was the last.
+static void proactor_release_home(void *home) {
+  pshard_t *s = (pshard_t*)home;
+  lock(&s->orphan_mutex);
+  if (--s->threads == 0 && s->epoll_orphan.type == ORPHAN_SHARD) {  /* Not the first shard */
+    s->epoll_orphan.fd = s->epollfd;
+    start_polling(&s->epoll_orphan, s->epoll_orphan.epollfd);  // TODO: check for error
+  }
+  unlock(&s->orphan_mutex);
+}
+
+// The shard polled by the calling thread. A home shard is assigned in turn on
+// the first call that can block, otherwise the thread polls the first shard.
+static pshard_t *proactor_home_shard(pn_proactor_t *p, bool can_block) {
+  if (p->shard_count == 1)
+    return &p->shards[0];
+  pshard_t *s = (pshard_t*)pthread_getspecific(p->home_shard);
+  if (s) return s;
+  if (!can_block) return &p->shards[0];
+  lock(&p->context.mutex);
+  s = &p->shards[p->next_home++ % p->shard_count];
+  unlock(&p->context.mutex);
+  lock(&s->orphan_mutex);
+  if (s->threads++ == 0 && s != &p->shards[0])
+    stop_polling(&s->epoll_orphan, p->shards[0].epollfd);
+  unlock(&s->orphan_mutex);
+  pthread_setspecific(p->home_shard, s);
+  return s;
+}
+
+// epoll_wait() for one event. If blocking with busy polling set, poll without
+// blocking until the busy poll time is up, saving the latency of a sleeping
+// thread being woken by the kernel.
+static int proactor_epoll_wait(pn_proactor_t *p, pshard_t *s, struct epoll_event *ev, bool can_block) {
+  uint32_t busy_poll = can_block ? __atomic_load_n(&p->busy_poll, __ATOMIC_RELAXED) : 0;
+  if (busy_poll) {
+    uint64_t deadline = monotonic_nanos() + (uint64_t)busy_poll * 1000;
+    do {
+      int n = epoll_wait(s->epollfd, ev, 1, 0);
+      if (n != 0) return n;
+    } while (monotonic_nanos() < deadline);
+  }
+  return epoll_wait(s->epollfd, ev, 1, can_block ? -1 : 0);
+}
+
 static pn_event_batch_t *proactor_do_epoll(struct pn_proactor_t* p, bool can_block) {
-  int timeout = can_block ? -1 : 0;
+  pshard_t *s = proactor_home_shard(p, can_block);
   while(true) {
     pn_event_batch_t *batch = NULL;
     struct epoll_event ev = {0};
-    int n = epoll_wait(p->epollfd, &ev, 1, timeout);
+    int n = proactor_epoll_wait(p, s, &ev, can_block);
 
     if (n < 0) {
       if (errno != EINTR)
@@ -2122,31 +2776,8 @@ static pn_event_batch_t *proactor_do_epoll(struct pn_proactor_t* p, bool can_blo
       }
     }
     assert(n == 1);
-    epoll_extended_t *ee = (epoll_extended_t *) ev.data.ptr;
-    memory_barrier(ee);
-
-    if (ee->type == WAKE) {
-      batch = process_inbound_wake(p, ee);
-    } else if (ee->type == PROACTOR_TIMER) {
-      batch = proactor_process(p, PN_PROACTOR_TIMEOUT);
-    } else if (ee->type == CHAINED_EPOLL) {
-      batch = proactor_chained_epoll_wait(p);  // expect a PCONNECTION_IO_2
-    } else {
-      pconnection_t *pc = psocket_pconnection(ee->psocket);
-      if (pc) {
-        if (ee->type == PCONNECTION_IO) {
-          batch = pconnection_process(pc, ev.events, false, false, false);
-        } else {
-          assert(ee->type == PCONNECTION_TIMER);
-          batch = pconnection_process(pc, 0, true, false, false);
-        }
-      }
-      else {
-        // TODO: can any of the listener processing be parallelized like IOCP?
-        batch = listener_process(ee->psocket, ev.events);
-      }
-    }
-
+    if (stats_enabled(p)) __atomic_fetch_add(&s->wakeups, 1, __ATOMIC_RELAXED);
+    batch = proactor_dispatch(p, &ev);
     if (batch) return batch;
     // No Proton event generated.  epoll_wait() again.
   }
@@ -2196,6 +2827,43 @@ void pn_proactor_done(pn_proactor_t *p, pn_event_batch_t *batch) {
   }
 }
 
+void pn_proactor_set_busy_poll(pn_proactor_t *p, uint32_t usec) {
+  __atomic_store_n(&p->busy_poll, usec, __ATOMIC_RELAXED);
+}
+
+void pn_proactor_set_zerocopy_threshold(pn_proactor_t *p, size_t bytes) {
+  __atomic_store_n(&p->zerocopy_threshold, bytes, __ATOMIC_RELAXED);
+}
+
+void pn_proactor_stats_enable(pn_proactor_t *p, bool enable) {
+  __atomic_store_n(&p->stats_enabled, enable, __ATOMIC_RELAXED);
+}
+
+bool pn_proactor_stats(pn_proactor_t *p, pn_proactor_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  lock(&p->context.mutex);
+  stats_sum(stats, &p->stats);
+  for (pcontext_t *ctx = p->contexts; ctx; ctx = ctx->next) {
+    pconnection_t *pc = pcontext_pconnection(ctx);
+    if (pc) stats_sum(stats, &pc->stats);
+  }
+  unlock(&p->context.mutex);
+  /* Returns from epoll_wait(), the connections' IO notifications are among them */
+  stats->wakeups = 0;
+  for (size_t i = 0; i < p->shard_count; ++i)
+    stats->wakeups += __atomic_load_n(&p->shards[i].wakeups, __ATOMIC_RELAXED);
+  return true;
+}
+
+bool pn_connection_stats(pn_connection_t *c, pn_proactor_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
+  if (pc) stats_sum(stats, &pc->stats);
+  pni_hazard_release(h);
+  return pc != NULL;
+}
+
 void pn_proactor_interrupt(pn_proactor_t *p) {
   if (p->interruptfd == -1)
     return;
@@ -2230,8 +2898,11 @@ void pn_proactor_cancel_timeout(pn_proactor_t *p) {
 }
 
 pn_proactor_t *pn_connection_proactor(pn_connection_t* c) {
-  pconnection_t *pc = get_pconnection(c);
-  return pc ? pc->psocket.proactor : NULL;
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
+  pn_proactor_t *p = pc ? pc->psocket.proactor : NULL;
+  pni_hazard_release(h);
+  return p;
 }
 
 void pn_proactor_disconnect(pn_proactor_t *p, pn_condition_t *cond) {
@@ -2247,6 +2918,8 @@ void pn_proactor_disconnect(pn_proactor_t *p, pn_condition_t *cond) {
     ctx->disconnecting = true;
     ctx->disconnect_ops = 2;   // Second pass below and proactor_remove(), in any order.
     p->disconnects_pending++;
+    pconnection_t *pc = pcontext_pconnection(ctx);
+    if (pc) stats_sum(&p->stats, &pc->stats);  /* Keep the proactor totals, closing work is not counted */
     ctx = ctx->next;
   }
   notify = wake_if_inactive(p);
@@ -2301,6 +2974,8 @@ void pn_proactor_disconnect(pn_proactor_t *p, pn_condition_t *cond) {
 
     lock(&p->context.mutex);
     if (--ctx->disconnect_ops == 0) {
+      // proactor_remove() has already run, the context closed by itself
+      --p->disconnects_pending;
       do_free = true;
       ctx_notify = false;
       notify = wake_if_inactive(p);
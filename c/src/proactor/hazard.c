@@ -0,0 +1,108 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Enable POSIX features beyond c99 for modern pthread */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "hazard.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Records are never freed: a record released by an exiting thread is reused
+   by the next new thread, so the list is as long as the most threads that
+   ever used hazards at once. */
+struct pni_hazard_t {
+  void *value;                  /* Atomic, protected pointer or NULL */
+  bool active;                  /* Atomic, record belongs to a live thread */
+  struct pni_hazard_t *next;    /* Immutable once in the list */
+};
+
+static pni_hazard_t *hazards;   /* Atomic, head of the list of all records */
+static pthread_key_t hazard_key;
+static pthread_once_t hazard_once = PTHREAD_ONCE_INIT;
+
+static void hazard_thread_exit(void *v) {
+  pni_hazard_t *h = (pni_hazard_t*)v;
+  __atomic_store_n(&h->value, NULL, __ATOMIC_RELEASE);
+  __atomic_store_n(&h->active, false, __ATOMIC_RELEASE);
+}
+
+static void hazard_init(void) {
+  if (pthread_key_create(&hazard_key, hazard_thread_exit) != 0) {
+    perror("pthread_key_create");
+    abort();
+  }
+}
+
+pni_hazard_t *pni_hazard(void) {
+  pthread_once(&hazard_once, hazard_init);
+  pni_hazard_t *h = (pni_hazard_t*)pthread_getspecific(hazard_key);
+  if (h) return h;
+  for (h = __atomic_load_n(&hazards, __ATOMIC_ACQUIRE); h; h = h->next) {
+    bool inactive = false;
+    if (__atomic_compare_exchange_n(&h->active, &inactive, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      break;
+  }
+  if (!h) {
+    h = (pni_hazard_t*)calloc(1, sizeof(*h));
+    if (!h) {
+      perror("hazard record");
+      abort();
+    }
+    h->active = true;
+    h->next = __atomic_load_n(&hazards, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&hazards, &h->next, h, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      ;
+  }
+  pthread_setspecific(hazard_key, h);
+  return h;
+}
+
+void *pni_hazard_acquire(pni_hazard_t *h, void *const *ptr) {
+  void *value = __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+  while (true) {
+    __atomic_store_n(&h->value, value, __ATOMIC_SEQ_CST);
+    /* Still published after the hazard is visible: a later free waits for us */
+    void *again = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+    if (again == value) return value;
+    value = again;
+  }
+}
+
+void pni_hazard_release(pni_hazard_t *h) {
+  __atomic_store_n(&h->value, NULL, __ATOMIC_RELEASE);
+}
+
+void pni_hazard_publish(void **ptr, void *value) {
+  __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+void pni_hazard_wait(void *value) {
+  if (!value) return;
+  for (pni_hazard_t *h = __atomic_load_n(&hazards, __ATOMIC_ACQUIRE); h; h = h->next) {
+    while (__atomic_load_n(&h->value, __ATOMIC_SEQ_CST) == value)
+      sched_yield();
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef PROACTOR_HAZARD_H
+#define PROACTOR_HAZARD_H
+
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Hazard pointers: lock-free reads of a shared pointer to an object that
+ * another thread may free.
+ *
+ * Each thread has one hazard record. A reader publishes the pointer it is
+ * using with pni_hazard_acquire() and clears it with pni_hazard_release().
+ * Before freeing the object, its owner clears the shared pointer and calls
+ * pni_hazard_wait(), which returns once no reader still holds the old value.
+ * Readers must only hold a hazard for short, non-blocking sections, and must
+ * not hold it while freeing.
+ *
+ * The shared pointer must only be written with pni_hazard_publish().
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pni_hazard_t pni_hazard_t;
+
+/* The calling thread's hazard record, created on first use */
+pni_hazard_t *pni_hazard(void);
+
+/* Read *ptr and protect the value read from being freed until release */
+void *pni_hazard_acquire(pni_hazard_t *h, void *const *ptr);
+
+void pni_hazard_release(pni_hazard_t *h);
+
+/* Set *ptr visible to pni_hazard_acquire() and pni_hazard_wait() */
+void pni_hazard_publish(void **ptr, void *value);
+
+/* Wait until no thread holds value, which must no longer be published */
+void pni_hazard_wait(void *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /*!PROACTOR_HAZARD_H*/
@@ -25,6 +25,7 @@
 #endif
 
 #include "../core/log_private.h"
+#include "hazard.h"
 #include "proactor-internal.h"
 
 #include <proton/condition.h>
@@ -294,34 +295,31 @@ static void parse_addr(addr_t *addr, const char *str) {
   pni_parse_addr(str, addr->addr_buf, sizeof(addr->addr_buf), &addr->host, &addr->port);
 }
 
-/* Protect read/update of pn_connnection_t pointer to it's pconnection_t
+/* Read/update of pn_connnection_t pointer to it's pconnection_t
  *
- * Global because pn_connection_wake()/pn_connection_proactor() navigate from
- * the pn_connection_t before we know the proactor or driver. Critical sections
- * are small: only get/set of the pn_connection_t driver pointer.
- *
- * TODO: replace mutex with atomic load/store
+ * pn_connection_wake()/pn_connection_proactor() navigate from the
+ * pn_connection_t in any thread, before we know the proactor or driver. The
+ * pointer is read atomically and protected by a hazard pointer while the
+ * pconnection_t is in use, pconnection_free() waits for such readers.
  */
-static pthread_mutex_t driver_ptr_mutex;
-
-static uv_once_t global_init_once = UV_ONCE_INIT;
-static void global_init_fn(void) {  /* Call via uv_once(&global_init_once, global_init_fn) */
-  uv_mutex_init(&driver_ptr_mutex);
+static pconnection_t *driver_pconnection(pn_connection_driver_t *d) {
+  return d ? (pconnection_t*)((char*)d-offsetof(pconnection_t, driver)) : NULL;
 }
 
+/* Only for the thread working on the connection, which keeps it alive */
 static pconnection_t *get_pconnection(pn_connection_t* c) {
   if (!c) return NULL;
-  uv_mutex_lock(&driver_ptr_mutex);
-  pn_connection_driver_t *d = *pn_connection_driver_ptr(c);
-  uv_mutex_unlock(&driver_ptr_mutex);
-  if (!d) return NULL;
-  return (pconnection_t*)((char*)d-offsetof(pconnection_t, driver));
+  return driver_pconnection(__atomic_load_n(pn_connection_driver_ptr(c), __ATOMIC_ACQUIRE));
+}
+
+/* Any thread: pconnection_t is not freed until pni_hazard_release(h) */
+static pconnection_t *acquire_pconnection(pni_hazard_t *h, pn_connection_t* c) {
+  if (!c) return NULL;
+  return driver_pconnection((pn_connection_driver_t*)pni_hazard_acquire(h, (void**)pn_connection_driver_ptr(c)));
 }
 
 static void set_pconnection(pn_connection_t* c, pconnection_t *pc) {
-  uv_mutex_lock(&driver_ptr_mutex);
-  *pn_connection_driver_ptr(c) = pc ? &pc->driver : NULL;
-  uv_mutex_unlock(&driver_ptr_mutex);
+  pni_hazard_publish((void**)pn_connection_driver_ptr(c), pc ? &pc->driver : NULL);
 }
 
 static pconnection_t *pconnection(pn_proactor_t *p, pn_connection_t *c, pn_transport_t *t, bool server) {
@@ -343,6 +341,7 @@ static pconnection_t *pconnection(pn_proactor_t *p, pn_connection_t *c, pn_trans
 static void pconnection_free(pconnection_t *pc) {
   pn_connection_t *c = pc->driver.connection;
   if (c) set_pconnection(c, NULL);
+  pni_hazard_wait(&pc->driver);
   pn_connection_driver_destroy(&pc->driver);
   if (pc->addr.getaddrinfo.addrinfo) {
     uv_freeaddrinfo(pc->addr.getaddrinfo.addrinfo); /* Interrupted after resolve */
@@ -930,6 +929,7 @@ static bool leader_process_pconnection(pconnection_t *pc) {
       if (!err && rbuf.size > 0) {
         what = "read";
         err = uv_read_start((uv_stream_t*)&pc->tcp, alloc_read_buffer, on_read);
+        if (err == UV_EALREADY) err = 0; /* libuv >= 1.38 if already reading */
       }
       if (err) {
         /* Some IO requests failed, generate the error events */
@@ -1111,6 +1111,30 @@ pn_proactor_t *pn_event_proactor(pn_event_t *e) {
   return NULL;
 }
 
+void pn_proactor_set_busy_poll(pn_proactor_t *p, uint32_t usec) {
+  (void)p; (void)usec;          /* Not supported */
+}
+
+void pn_proactor_set_zerocopy_threshold(pn_proactor_t *p, size_t bytes) {
+  (void)p; (void)bytes;         /* Not supported */
+}
+
+void pn_proactor_stats_enable(pn_proactor_t *p, bool enable) {
+  (void)p; (void)enable;        /* Not supported */
+}
+
+bool pn_proactor_stats(pn_proactor_t *p, pn_proactor_stats_t *stats) {
+  (void)p;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
+bool pn_connection_stats(pn_connection_t *c, pn_proactor_stats_t *stats) {
+  (void)c;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
 void pn_proactor_interrupt(pn_proactor_t *p) {
   /* NOTE: pn_proactor_interrupt must be async-signal-safe so we cannot use
      locks to update shared proactor state here. Instead we use a dedicated
@@ -1195,7 +1219,6 @@ static void work_free(work_t *w) {
 }
 
 pn_proactor_t *pn_proactor() {
-  uv_once(&global_init_once, global_init_fn);
   pn_proactor_t *p = (pn_proactor_t*)calloc(1, sizeof(pn_proactor_t));
   p->collector = pn_collector();
   if (!p->collector) {
@@ -1215,6 +1238,10 @@ pn_proactor_t *pn_proactor() {
   return p;
 }
 
+pn_proactor_t *pn_proactor_sharded(size_t shards) {
+  return pn_proactor();        /* Not supported, all threads share one queue */
+}
+
 void pn_proactor_free(pn_proactor_t *p) {
   /* Close all open handles */
   uv_walk(&p->loop, on_proactor_free, NULL);
@@ -1237,13 +1264,17 @@ void pn_proactor_free(pn_proactor_t *p) {
 }
 
 pn_proactor_t *pn_connection_proactor(pn_connection_t* c) {
-  pconnection_t *pc = get_pconnection(c);
-  return pc ? pc->work.proactor : NULL;
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
+  pn_proactor_t *p = pc ? pc->work.proactor : NULL;
+  pni_hazard_release(h);
+  return p;
 }
 
 void pn_connection_wake(pn_connection_t* c) {
   /* May be called from any thread */
-  pconnection_t *pc = get_pconnection(c);
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
   if (pc) {
     bool notify = false;
     uv_mutex_lock(&pc->lock);
@@ -1256,14 +1287,18 @@ void pn_connection_wake(pn_connection_t* c) {
       work_notify(&pc->work);
     }
   }
+  pni_hazard_release(h);
 }
 
 void pn_proactor_release_connection(pn_connection_t *c) {
-  pconnection_t *pc = get_pconnection(c);
+  /* As in pn_connection_wake(): the connection may not be ours to keep alive */
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
   if (pc) {
     set_pconnection(c, NULL);
     pn_connection_driver_release_connection(&pc->driver);
   }
+  pni_hazard_release(h);
 }
 
 pn_listener_t *pn_listener(void) {
@@ -1289,6 +1324,10 @@ void pn_listener_close(pn_listener_t* l) {
   uv_mutex_unlock(&l->lock);
 }
 
+void pn_listener_set_reuseport(pn_listener_t *l, size_t sockets) {
+  (void)l; (void)sockets;       /* Not supported, one socket per address */
+}
+
 pn_proactor_t *pn_listener_proactor(pn_listener_t* l) {
   return l ? l->work.proactor : NULL;
 }
@@ -0,0 +1,1666 @@
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+/* Enable POSIX features beyond c99 for modern pthread, and syscall() for io_uring */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "../core/log_private.h"
+#include "hazard.h"
+#include "proactor-internal.h"
+
+#include <proton/condition.h>
+#include <proton/connection_driver.h>
+#include <proton/engine.h>
+#include <proton/listener.h>
+#include <proton/proactor.h>
+#include <proton/transport.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "netaddr-internal.h"   /* Include after socket headers */
+
+/* All asserts are cheap and should remain in a release build for debuggability */
+#undef NDEBUG
+#include <assert.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Proactor built on a Linux io_uring, needs Linux 5.19 or later.
+
+  Sockets are never polled for readiness: reads, writes, connects and accepts
+  are submitted to the ring and the proactor acts on their completions. Only
+  one thread at a time may use the ring, so this uses the same
+  "leader-worker-follower" model as the libuv proactor:
+
+  - At most one thread at a time is the "leader". The leader submits requests
+  to the ring, waits for completions and processes them till there are events
+  to process, then becomes a "worker"
+
+  - Concurrent "worker" threads process events for separate connections or
+  listeners. When they run out of work they become "followers"
+
+  - A "follower" is idle, waiting for work. When the leader becomes a worker,
+  one follower takes over as the new leader.
+
+  While a read or write is in flight the kernel owns part of the connection's
+  transport buffers, so a connection is only handed to a worker once its
+  requests have completed. A pending read is cancelled to hand over a
+  connection that has events.
+
+  Each request carries the address of an op_t as its user_data, a request
+  with no op_t (user_data 0) has an ignored completion. The leader counts the
+  requests in flight for each connection or listener, which is not freed
+  while it still has any.
+
+  Connection ticks use a timeout linked to the pending read, or a plain
+  timeout if there is no read. The proactor timeout is the wait timeout of
+  io_uring_enter().
+
+  Function naming:
+  - leader_* - only called in leader thread
+  - *_lh - called with the relevant lock held
+*/
+
+const char *AMQP_PORT = "5672";
+const char *AMQP_PORT_NAME = "amqp";
+
+/* pn_proactor_t and pn_listener_t are plain C structs with normal memory management.
+   CLASSDEF is for identification when used as a pn_event_t context.
+*/
+PN_STRUCT_CLASSDEF(pn_proactor, CID_pn_proactor)
+PN_STRUCT_CLASSDEF(pn_listener, CID_pn_listener)
+
+#define RING_ENTRIES 1024
+
+typedef char strerrorbuf[1024];      /* used for pstrerror message buffer */
+
+/* Like strerror_r but provide a default message if strerror_r fails */
+static void pstrerror(int err, strerrorbuf msg) {
+  int e = strerror_r(err, msg, sizeof(strerrorbuf));
+  if (e) snprintf(msg, sizeof(strerrorbuf), "unknown error %d", err);
+}
+
+/* Internal error, no recovery */
+#define URING_FATAL(EXPR, SYSERRNO)                                     \
+  do {                                                                  \
+    strerrorbuf msg;                                                    \
+    pstrerror((SYSERRNO), msg);                                         \
+    fprintf(stderr, "io_uring proactor failure in %s:%d: %s: %s\n",     \
+            __FILE__, __LINE__ , #EXPR, msg);                           \
+    abort();                                                            \
+  } while (0)
+
+/* ================ Queues ================ */
+static int unqueued;            /* Provide invalid address for _unqueued pointers */
+
+#define QUEUE_DECL(T)                                                   \
+  typedef struct T##_queue_t { T##_t *front, *back; } T##_queue_t;      \
+                                                                        \
+  static T##_t *T##_unqueued = (T##_t*)&unqueued;                       \
+                                                                        \
+  static void T##_push(T##_queue_t *q, T##_t *x) {                      \
+    assert(x->next == T##_unqueued);                                    \
+    x->next = NULL;                                                     \
+    if (!q->front) {                                                    \
+      q->front = q->back = x;                                           \
+    } else {                                                            \
+      q->back->next = x;                                                \
+      q->back =  x;                                                     \
+    }                                                                   \
+  }                                                                     \
+                                                                        \
+  static T##_t* T##_pop(T##_queue_t *q) {                               \
+    T##_t *x = q->front;                                                \
+    if (x) {                                                            \
+      q->front = x->next;                                               \
+      x->next = T##_unqueued;                                           \
+    }                                                                   \
+    return x;                                                           \
+  }
+
+
+typedef enum { T_CONNECTION, T_LISTENER } struct_type;
+
+/* A stream of serialized work for the proactor */
+typedef struct work_t {
+  /* Immutable */
+  struct_type type;
+  pn_proactor_t *proactor;
+
+  /* Protected by proactor.lock */
+  struct work_t *next;
+  struct work_t *all_prev, *all_next; /* List of all work items */
+  bool working;                      /* Owned by a worker thread */
+  bool disconnect;                   /* pn_proactor_disconnect() pending */
+
+  /* Only used by leader */
+  size_t inflight;                   /* Requests in the ring with an op_t for this item */
+  bool closed;                       /* Ready to free once off all queues */
+} work_t;
+
+QUEUE_DECL(work)
+
+static void work_init(work_t* w, pn_proactor_t* p, struct_type type) {
+  w->proactor = p;
+  w->next = work_unqueued;
+  w->type = type;
+  w->working = true;
+}
+
+/* ================ IO ================ */
+
+typedef enum {
+  OP_NOTIFY, OP_INTERRUPT,                       /* Proactor eventfd polls */
+  OP_CONNECT, OP_READ, OP_WRITE, OP_TICK, OP_LINK_TICK, OP_UPDATE, /* Connection */
+  OP_ACCEPT                                      /* Listening socket */
+} op_type;
+
+/* The user_data of a request, identifies the request and its owner */
+typedef struct op_t {
+  op_type type;
+  work_t *work;                 /* NULL for proactor requests */
+} op_t;
+
+static void op_init(op_t *op, op_type type, work_t *w) {
+  op->type = type;
+  op->work = w;
+}
+
+/* The mmapped submission and completion rings */
+typedef struct uring_t {
+  int fd;
+  unsigned entries;
+  unsigned unsubmitted;         /* SQEs queued since the last io_uring_enter() */
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ring, *cq_ring;
+  size_t sq_ring_size, cq_ring_size, sqes_size;
+} uring_t;
+
+/* A single listening socket, a listener can have more than one */
+typedef struct lsocket_t {
+  op_t accept;
+  int fd;
+  bool accepting;               /* Multishot accept in flight */
+  struct pn_netaddr_t addr;     /* Actual listening address */
+} lsocket_t;
+
+typedef enum { W_NONE, W_PENDING, W_CLOSED } wake_state;
+
+/* An incoming or outgoing connection. */
+typedef struct pconnection_t {
+  work_t work;                  /* Must be first to allow casting */
+
+  /* Only used by owner thread */
+  pn_connection_driver_t driver;
+
+  /* Only used by leader */
+  int fd;
+  char addr_buf[PN_MAX_ADDR];
+  const char *host, *port;
+  struct addrinfo *addrinfo;    /* Outgoing connection only, resolved addresses */
+  struct addrinfo *ai;          /* The next address to try */
+  int connected;      /* 0: not connected, <0: connect failed, 1 = connected ok */
+  int connect_err;              /* First connect error in case they all fail */
+
+  struct pn_netaddr_t local, remote; /* Actual addresses */
+  op_t connect, read, write, tick, link_tick, update;
+  struct __kernel_timespec tick_ts, link_ts;
+  uint64_t tick_deadline;       /* Expiry of the plain tick timeout */
+  size_t writing;               /* size of pending write request, 0 if none pending */
+  bool connecting;
+  bool reading;
+  bool cancelling;              /* Cancel requested for the pending read */
+  bool ticking;                 /* Plain tick timeout pending */
+  bool write_shutdown;
+  bool closing;
+
+  /* Locked for thread-safe access */
+  pthread_mutex_t lock;
+  wake_state wake;
+} pconnection_t;
+
+typedef enum {
+  L_LISTENING,                  /**<< Listening */
+  L_CLOSE,                      /**<< Close requested  */
+  L_CLOSING,                    /**<< Accepts cancelled, wait for them to complete */
+  L_CLOSED                      /**<< User saw PN_LISTENER_CLOSED, all done  */
+} listener_state;
+
+/* A listener */
+struct pn_listener_t {
+  work_t work;                  /* Must be first to allow casting */
+
+  /* Only used by owner thread */
+  pn_event_batch_t batch;
+  pn_record_t *attachments;
+  void *context;
+  size_t backlog;
+
+  /* Immutable after pn_proactor_listen() */
+  char addr_buf[PN_MAX_ADDR];
+  const char *host, *port;
+  lsocket_t *lsockets;
+  size_t lsockets_len;
+
+  /* Locked for thread-safe access. Accepts complete in the leader thread
+   * while the listener's batch is processed by a worker.
+   */
+  pthread_mutex_t lock;
+  pn_condition_t *condition;
+  pn_collector_t *collector;
+  int *accepted;                /* Accepted sockets, one PN_LISTENER_ACCEPT at a time */
+  size_t accepted_head, accepted_len, accepted_cap;
+  listener_state state;
+};
+
+typedef enum { TM_NONE, TM_REQUEST, TM_PENDING, TM_FIRED } timeout_state_t;
+
+struct pn_proactor_t {
+  /* Leader thread  */
+  uring_t ring;
+  op_t notify_op, interrupt_op;
+  size_t inflight;              /* Requests in the ring with an op_t */
+  bool freeing;
+
+  /* Notification, interruptfd is written by pn_proactor_interrupt() */
+  int notifyfd;
+  int interruptfd;
+  bool notified;                /* Atomic, notifyfd written and not yet read */
+
+  /* Owner thread: proactor collector and batch can belong to leader or a worker */
+  pn_collector_t *collector;
+  pn_event_batch_t batch;
+
+  /* Protected by lock */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  work_queue_t worker_q; /* ready for work, to be returned via pn_proactor_wait()  */
+  work_queue_t leader_q; /* waiting for attention by the leader thread */
+  work_t *all;           /* all connections and listeners */
+  timeout_state_t timeout_state;
+  pn_millis_t timeout;
+  uint64_t deadline;     /* Expiry of a TM_PENDING timeout */
+  size_t active;         /* connection/listener count for INACTIVE events */
+  pn_condition_t *disconnect_cond; /* disconnect condition */
+
+  bool has_leader;             /* A thread is working as leader */
+  bool batch_working;          /* batch is being processed in a worker thread */
+  bool need_interrupt;         /* Need a PN_PROACTOR_INTERRUPT event */
+  bool need_inactive;          /* need INACTIVE event */
+};
+
+static void lock(pthread_mutex_t *m) { pthread_mutex_lock(m); }
+static void unlock(pthread_mutex_t *m) { pthread_mutex_unlock(m); }
+
+static uint64_t monotonic_millis(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec) * 1000 + t.tv_nsec / 1000000;
+}
+
+/* Set ts to the time from now till deadline, or 0 if it has passed */
+static void set_timespec(struct __kernel_timespec *ts, uint64_t deadline, uint64_t now) {
+  uint64_t ms = deadline > now ? deadline - now : 0;
+  ts->tv_sec = ms / 1000;
+  ts->tv_nsec = (ms % 1000) * 1000000;
+}
+
+/* ================ Ring ================ */
+
+static void uring_finalize(uring_t *r) {
+  if (r->sqes) munmap(r->sqes, r->sqes_size);
+  if (r->cq_ring && r->cq_ring != r->sq_ring) munmap(r->cq_ring, r->cq_ring_size);
+  if (r->sq_ring) munmap(r->sq_ring, r->sq_ring_size);
+  if (r->fd >= 0) close(r->fd);
+  memset(r, 0, sizeof(*r));
+  r->fd = -1;
+}
+
+static void *uring_mmap(uring_t *r, size_t size, off_t offset) {
+  void *m = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, offset);
+  return (m == MAP_FAILED) ? NULL : m;
+}
+
+/* Return 0 or an errno value */
+static int uring_init(uring_t *r, unsigned entries) {
+  struct io_uring_params params;
+  memset(r, 0, sizeof(*r));
+  memset(&params, 0, sizeof(params));
+  r->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (r->fd < 0) return errno;
+  /* Need wait timeouts without a timeout request, and no lost completions */
+  if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+    uring_finalize(r);
+    return ENOSYS;
+  }
+  r->entries = params.sq_entries;
+  r->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  r->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  r->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && r->cq_ring_size > r->sq_ring_size) r->sq_ring_size = r->cq_ring_size;
+  r->sq_ring = uring_mmap(r, r->sq_ring_size, IORING_OFF_SQ_RING);
+  r->cq_ring = single ? r->sq_ring : uring_mmap(r, r->cq_ring_size, IORING_OFF_CQ_RING);
+  r->sqes = (struct io_uring_sqe*)uring_mmap(r, r->sqes_size, IORING_OFF_SQES);
+  if (!r->sq_ring || !r->cq_ring || !r->sqes) {
+    int err = errno;
+    uring_finalize(r);
+    return err;
+  }
+  char *sq = (char*)r->sq_ring, *cq = (char*)r->cq_ring;
+  r->sq_head = (unsigned*)(sq + params.sq_off.head);
+  r->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  r->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  r->sq_array = (unsigned*)(sq + params.sq_off.array);
+  r->cq_head = (unsigned*)(cq + params.cq_off.head);
+  r->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  r->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return 0;
+}
+
+/* Submit queued SQEs and wait for min_complete completions, or till ts expires
+ * if it is not NULL. Return 0 or an errno value.
+ */
+static int uring_enter(uring_t *r, unsigned min_complete, struct __kernel_timespec *ts) {
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = (uintptr_t)ts;
+  unsigned flags = IORING_ENTER_EXT_ARG | (min_complete ? IORING_ENTER_GETEVENTS : 0);
+  long n = syscall(__NR_io_uring_enter, r->fd, r->unsubmitted, min_complete, flags, &arg, sizeof(arg));
+  if (n < 0) return errno;
+  r->unsubmitted -= (unsigned)n;
+  return 0;
+}
+
+/* Make sure the next n SQEs can be queued without an intervening submit */
+static void uring_reserve(uring_t *r, unsigned n) {
+  while (*r->sq_tail + n - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) > r->entries) {
+    int err = uring_enter(r, 0, NULL);
+    if (err && err != EINTR && err != EAGAIN && err != EBUSY) URING_FATAL(io_uring_enter, err);
+  }
+}
+
+/* Queue a zeroed SQE, it is submitted by the next uring_enter() */
+static struct io_uring_sqe *uring_sqe(uring_t *r) {
+  uring_reserve(r, 1);
+  unsigned tail = *r->sq_tail;
+  unsigned i = tail & *r->sq_mask;
+  struct io_uring_sqe *sqe = &r->sqes[i];
+  memset(sqe, 0, sizeof(*sqe));
+  r->sq_array[i] = i;
+  __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ++r->unsubmitted;
+  return sqe;
+}
+
+/* Queue a request, its completion is passed to leader_complete() with op */
+static struct io_uring_sqe *leader_sqe(pn_proactor_t *p, op_t *op, int opcode, int fd) {
+  struct io_uring_sqe *sqe = uring_sqe(&p->ring);
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->user_data = (uintptr_t)op;
+  if (op) {
+    ++p->inflight;
+    if (op->work) ++op->work->inflight;
+  }
+  return sqe;
+}
+
+/* Cancel the request for op, if any. The cancel itself has no op */
+static void leader_cancel(pn_proactor_t *p, op_t *op) {
+  struct io_uring_sqe *sqe = leader_sqe(p, NULL, IORING_OP_ASYNC_CANCEL, -1);
+  sqe->addr = (uintptr_t)op;
+}
+
+/* Multishot poll for an eventfd */
+static void leader_poll_fd(pn_proactor_t *p, op_t *op, int fd) {
+  struct io_uring_sqe *sqe = leader_sqe(p, op, IORING_OP_POLL_ADD, fd);
+  sqe->poll32_events = POLLIN;
+  sqe->len = IORING_POLL_ADD_MULTI;
+}
+
+/* ================ Work ================ */
+
+/* Notify the leader thread that there is something to do outside of the ring.
+   Coalesced: the flag is cleared by the leader after it reads notifyfd.
+*/
+static void notify(pn_proactor_t* p) {
+  if (!__atomic_exchange_n(&p->notified, true, __ATOMIC_ACQ_REL)) {
+    uint64_t one = 1;
+    if (write(p->notifyfd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+      URING_FATAL(notify, errno);
+    }
+  }
+}
+
+static bool work_queue_lh(work_t *w) {
+  /* If the socket is in use by a worker or is already queued then leave it where it is.
+     It will be processed in pn_proactor_done() or when the queue it is on is processed.
+  */
+  if (!w->working && w->next == work_unqueued) {
+    work_push(&w->proactor->leader_q, w);
+    return true;
+  }
+  return false;
+}
+
+/* Notify that this work item needs attention from the leader at the next opportunity */
+static void work_notify(work_t *w) {
+  lock(&w->proactor->lock);
+  bool queued = work_queue_lh(w);
+  unlock(&w->proactor->lock);
+  if (queued) notify(w->proactor);
+}
+
+/* Like work_notify() but called by the leader, which will look at leader_q before waiting */
+static void leader_notify(work_t *w) {
+  lock(&w->proactor->lock);
+  work_queue_lh(w);
+  unlock(&w->proactor->lock);
+}
+
+/* Notify the leader of a newly-created work item */
+static void work_start(work_t *w) {
+  pn_proactor_t *p = w->proactor;
+  lock(&p->lock);
+  w->all_next = p->all;
+  if (p->all) p->all->all_prev = w;
+  p->all = w;
+  ++p->active;
+  w->working = false;
+  work_push(&p->leader_q, w);
+  unlock(&p->lock);
+  notify(p);
+}
+
+static void work_remove_lh(work_t *w) {
+  pn_proactor_t *p = w->proactor;
+  if (w->all_prev) w->all_prev->all_next = w->all_next;
+  else p->all = w->all_next;
+  if (w->all_next) w->all_next->all_prev = w->all_prev;
+}
+
+static int pgetaddrinfo(const char *host, const char *port, int flags, struct addrinfo **res)
+{
+  struct addrinfo hints = { 0 };
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_V4MAPPED | AI_ADDRCONFIG | flags;
+  return getaddrinfo(host, port, &hints, res);
+}
+
+static void configure_socket(int sock) {
+  int tcp_nodelay = 1;
+  (void)setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void*) &tcp_nodelay, sizeof(tcp_nodelay));
+}
+
+/* Read/update of pn_connnection_t pointer to it's pconnection_t
+ *
+ * pn_connection_wake()/pn_connection_proactor() navigate from the
+ * pn_connection_t in any thread, before we know the proactor or driver. The
+ * pointer is read atomically and protected by a hazard pointer while the
+ * pconnection_t is in use, leader_close() waits for such readers.
+ */
+static pconnection_t *driver_pconnection(pn_connection_driver_t *d) {
+  return d ? (pconnection_t*)((char*)d-offsetof(pconnection_t, driver)) : NULL;
+}
+
+/* Only for the owner thread, which keeps the connection alive */
+static pconnection_t *get_pconnection(pn_connection_t* c) {
+  if (!c) return NULL;
+  return driver_pconnection(__atomic_load_n(pn_connection_driver_ptr(c), __ATOMIC_ACQUIRE));
+}
+
+/* Any thread: pconnection_t is not freed until pni_hazard_release(h) */
+static pconnection_t *acquire_pconnection(pni_hazard_t *h, pn_connection_t* c) {
+  if (!c) return NULL;
+  return driver_pconnection((pn_connection_driver_t*)pni_hazard_acquire(h, (void**)pn_connection_driver_ptr(c)));
+}
+
+static void set_pconnection(pn_connection_t* c, pconnection_t *pc) {
+  pni_hazard_publish((void**)pn_connection_driver_ptr(c), pc ? &pc->driver : NULL);
+}
+
+/* Takes ownership of c and t, they are freed if there is no memory for the pconnection */
+static pconnection_t *pconnection(pn_proactor_t *p, pn_connection_t *c, pn_transport_t *t, bool server) {
+  pconnection_t *pc = (pconnection_t*)calloc(1, sizeof(*pc));
+  if (!pc) {
+    if (c) pn_connection_free(c);
+    if (t) pn_transport_free(t);
+    return NULL;
+  }
+  if (pn_connection_driver_init(&pc->driver, c, t) != 0) { /* Frees c and t */
+    free(pc);
+    return NULL;
+  }
+  work_init(&pc->work, p,  T_CONNECTION);
+  pc->fd = -1;
+  op_init(&pc->connect, OP_CONNECT, &pc->work);
+  op_init(&pc->read, OP_READ, &pc->work);
+  op_init(&pc->write, OP_WRITE, &pc->work);
+  op_init(&pc->tick, OP_TICK, &pc->work);
+  op_init(&pc->link_tick, OP_LINK_TICK, &pc->work);
+  op_init(&pc->update, OP_UPDATE, &pc->work);
+  pthread_mutex_init(&pc->lock, NULL);
+  if (server) {
+    pn_transport_set_server(pc->driver.transport);
+  }
+  set_pconnection(pc->driver.connection, pc);
+  return pc;
+}
+
+static void pconnection_free(pconnection_t *pc) {
+  pn_connection_t *c = pc->driver.connection;
+  if (c) set_pconnection(c, NULL);
+  pni_hazard_wait(&pc->driver);
+  pn_connection_driver_destroy(&pc->driver);
+  if (pc->addrinfo) freeaddrinfo(pc->addrinfo);
+  if (pc->fd >= 0) close(pc->fd);
+  pthread_mutex_destroy(&pc->lock);
+  free(pc);
+}
+
+static pn_event_t *listener_batch_next(pn_event_batch_t *batch);
+static pn_event_t *proactor_batch_next(pn_event_batch_t *batch);
+
+static inline pn_proactor_t *batch_proactor(pn_event_batch_t *batch) {
+  return (batch->next_event == proactor_batch_next) ?
+    (pn_proactor_t*)((char*)batch - offsetof(pn_proactor_t, batch)) : NULL;
+}
+
+static inline pn_listener_t *batch_listener(pn_event_batch_t *batch) {
+  return (batch->next_event == listener_batch_next) ?
+    (pn_listener_t*)((char*)batch - offsetof(pn_listener_t, batch)) : NULL;
+}
+
+static inline pconnection_t *batch_pconnection(pn_event_batch_t *batch) {
+  pn_connection_driver_t *d = pn_event_batch_connection_driver(batch);
+  return d ? (pconnection_t*)((char*)d - offsetof(pconnection_t, driver)) : NULL;
+}
+
+static inline work_t *batch_work(pn_event_batch_t *batch) {
+  pconnection_t *pc = batch_pconnection(batch);
+  if (pc) return &pc->work;
+  pn_listener_t *l = batch_listener(batch);
+  if (l) return &l->work;
+  return NULL;
+}
+
+static void remove_active_lh(pn_proactor_t *p) {
+  assert(p->active > 0);
+  if (--p->active == 0) {
+    p->need_inactive = true;
+  }
+}
+
+/* Set the error condition, but don't close the driver. */
+static void pconnection_set_error(pconnection_t *pc, int err, const char* what) {
+  strerrorbuf msg;
+  pstrerror(err, msg);
+  pn_connection_driver_t *driver = &pc->driver;
+  pn_connection_driver_bind(driver); /* Make sure we are bound so errors will be reported */
+  pni_proactor_set_cond(pn_transport_condition(driver->transport), what, pc->host, pc->port, msg);
+}
+
+/* Set the error condition and close the driver. */
+static void pconnection_error(pconnection_t *pc, int err, const char* what) {
+  assert(err);
+  pconnection_set_error(pc, err, what);
+  pn_connection_driver_close(&pc->driver);
+}
+
+static void pconnection_addresses(pconnection_t *pc) {
+  socklen_t len = sizeof(pc->local.ss);
+  (void)getsockname(pc->fd, (struct sockaddr*)&pc->local.ss, &len);
+  len = sizeof(pc->remote.ss);
+  (void)getpeername(pc->fd, (struct sockaddr*)&pc->remote.ss, &len);
+}
+
+static void listener_close_lh(pn_listener_t* l) {
+  if (l->state < L_CLOSE) {
+    l->state = L_CLOSE;
+  }
+  work_notify(&l->work);
+}
+
+static void listener_error_lh(pn_listener_t *l, const char *msg, const char* what) {
+  if (!pn_condition_is_set(l->condition)) {
+    pni_proactor_set_cond(l->condition, what, l->host, l->port, msg);
+  }
+  listener_close_lh(l);
+}
+
+/* Try the next address for an outgoing connection, or fail if there are none left */
+static void leader_connect(pconnection_t *pc) {
+  pn_proactor_t *p = pc->work.proactor;
+  while (pc->ai && !pn_connection_driver_write_closed(&pc->driver)) {
+    struct addrinfo *ai = pc->ai;
+    pc->ai = ai->ai_next;       /* Move to next address in case this fails */
+    int fd = socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, ai->ai_protocol);
+    if (fd < 0) {
+      if (!pc->connect_err) pc->connect_err = errno;
+      continue;
+    }
+    configure_socket(fd);
+    pc->fd = fd;
+    struct io_uring_sqe *sqe = leader_sqe(p, &pc->connect, IORING_OP_CONNECT, fd);
+    sqe->addr = (uintptr_t)ai->ai_addr;
+    sqe->off = ai->ai_addrlen;
+    pc->connecting = true;
+    return;
+  }
+  freeaddrinfo(pc->addrinfo);
+  pc->addrinfo = pc->ai = NULL;
+  pc->connected = -1;
+  if (!pn_connection_driver_write_closed(&pc->driver)) { /* Not closed by disconnect */
+    pconnection_error(pc, pc->connect_err ? pc->connect_err : EHOSTUNREACH, "connect to");
+  }
+}
+
+/* Return true if pc can be handed to a worker: the kernel must not own any of
+ * its buffers, so cancel the pending read if there is one.
+ */
+static bool leader_detach(pconnection_t *pc) {
+  if (pc->reading && !pc->cancelling) {
+    pc->cancelling = true;
+    leader_cancel(pc->work.proactor, &pc->read);
+  }
+  return !pc->reading && !pc->writing;
+}
+
+/* Start a read, with a linked timeout for the next tick if there is one */
+static void leader_read(pconnection_t *pc, pn_rwbytes_t rbuf, uint64_t next, uint64_t now) {
+  pn_proactor_t *p = pc->work.proactor;
+  uring_reserve(&p->ring, 2);   /* Linked requests must be submitted together */
+  struct io_uring_sqe *sqe = leader_sqe(p, &pc->read, IORING_OP_RECV, pc->fd);
+  sqe->addr = (uintptr_t)rbuf.start;
+  sqe->len = rbuf.size;
+  pc->reading = true;
+  if (next) {
+    sqe->flags |= IOSQE_IO_LINK;
+    set_timespec(&pc->link_ts, next, now);
+    sqe = leader_sqe(p, &pc->link_tick, IORING_OP_LINK_TIMEOUT, -1);
+    sqe->addr = (uintptr_t)&pc->link_ts;
+    sqe->len = 1;
+  }
+}
+
+/* Start or bring forward the plain tick timeout. An early tick is harmless,
+ * it just computes the next deadline again.
+ */
+static void leader_timer(pconnection_t *pc, uint64_t next, uint64_t now) {
+  if (!next || (pc->ticking && pc->tick_deadline <= next)) return;
+  pn_proactor_t *p = pc->work.proactor;
+  set_timespec(&pc->tick_ts, next, now);
+  struct io_uring_sqe *sqe;
+  if (pc->ticking) {
+    sqe = leader_sqe(p, &pc->update, IORING_OP_TIMEOUT_REMOVE, -1);
+    sqe->addr = (uintptr_t)&pc->tick;
+    sqe->addr2 = (uintptr_t)&pc->tick_ts;
+    sqe->timeout_flags = IORING_TIMEOUT_UPDATE;
+  } else {
+    sqe = leader_sqe(p, &pc->tick, IORING_OP_TIMEOUT, -1);
+    sqe->addr = (uintptr_t)&pc->tick_ts;
+    sqe->len = 1;
+    pc->ticking = true;
+  }
+  pc->tick_deadline = next;
+}
+
+/* Driver is finished, stop all IO and mark pc to be freed once it has none in flight */
+static void leader_close(pconnection_t *pc) {
+  if (!pc->closing) {
+    pc->closing = true;
+    lock(&pc->lock);
+    pc->wake = W_CLOSED;        /* wake() is a no-op from now on */
+    unlock(&pc->lock);
+    /* Wait for threads in pn_connection_wake(), they may still queue pc */
+    pn_connection_t *c = pc->driver.connection;
+    if (c) set_pconnection(c, NULL);
+    pni_hazard_wait(&pc->driver);
+    pn_proactor_t *p = pc->work.proactor;
+    if (pc->reading && !pc->cancelling) {
+      pc->cancelling = true;
+      leader_cancel(p, &pc->read);
+    }
+    if (pc->ticking) {
+      struct io_uring_sqe *sqe = leader_sqe(p, NULL, IORING_OP_TIMEOUT_REMOVE, -1);
+      sqe->addr = (uintptr_t)&pc->tick;
+    }
+  }
+  if (!pc->work.inflight) {
+    pc->work.closed = true;
+  }
+}
+
+/* Generate tick events and return the next tick deadline or 0 if no tick is required */
+static uint64_t leader_tick(pconnection_t *pc, uint64_t now) {
+  return pn_transport_tick(pc->driver.transport, now);
+}
+
+/* Return true if a wake is pending, closed connections drop wakes. If put,
+ * generate the WAKE event. That is left till the connection is handed to a
+ * worker, so a disconnect in the meantime drops it.
+ */
+static bool check_wake(pconnection_t *pc, bool put) {
+  pn_connection_t *c = pc->driver.connection;
+  bool closed = !c || (pn_connection_driver_read_closed(&pc->driver) &&
+                       pn_connection_driver_write_closed(&pc->driver));
+  lock(&pc->lock);
+  bool waking = (pc->wake == W_PENDING) && !closed;
+  if (pc->wake == W_PENDING && (closed || put)) {
+    pc->wake = W_NONE;
+  }
+  unlock(&pc->lock);
+  if (waking && put) {
+    pn_collector_put(pn_connection_collector(c), PN_OBJECT, c, PN_CONNECTION_WAKE);
+  }
+  return waking;
+}
+
+/* Close the driver for pn_proactor_disconnect() */
+static void pconnection_disconnect_lh(pconnection_t *pc) {
+  pn_condition_copy(pn_transport_condition(pc->driver.transport), pc->work.proactor->disconnect_cond);
+  pn_connection_driver_close(&pc->driver);
+}
+
+/* Process a pconnection, return true if it has events for a worker thread */
+static bool leader_process_pconnection(pconnection_t *pc, bool disconnect) {
+  pn_proactor_t *p = pc->work.proactor;
+  if (disconnect) {
+    lock(&p->lock);
+    pconnection_disconnect_lh(pc);
+    unlock(&p->lock);
+    if (pc->connecting) leader_cancel(p, &pc->connect);
+  }
+  /* Important to do the following steps in order */
+  if (!pc->connected) {
+    if (!pc->connecting) leader_connect(pc);
+    if (!pc->connected) return false;
+  }
+  if (pc->writing) {
+    /* We can't do anything while a write request is pending */
+    return false;
+  }
+  /* Must process INIT and BOUND events before we do any IO-related stuff  */
+  if (pn_connection_driver_has_event(&pc->driver)) {
+    return leader_detach(pc);
+  }
+  if (pn_connection_driver_finished(&pc->driver)) {
+    leader_close(pc);
+    return false;
+  }
+  /* Check for events that can be generated without blocking for IO */
+  bool waking = check_wake(pc, false);
+  uint64_t now = monotonic_millis();
+  uint64_t next_tick = leader_tick(pc, now);
+  /* If we still have no events, make IO requests */
+  if (!waking && !pn_connection_driver_has_event(&pc->driver)) {
+    pn_bytes_t wbuf = pn_connection_driver_write_buffer(&pc->driver);
+    if (wbuf.size > 0) {
+      struct io_uring_sqe *sqe = leader_sqe(p, &pc->write, IORING_OP_SEND, pc->fd);
+      sqe->addr = (uintptr_t)wbuf.start;
+      sqe->len = wbuf.size;
+      sqe->msg_flags = MSG_NOSIGNAL;
+      pc->writing = wbuf.size;
+    } else if (pn_connection_driver_write_closed(&pc->driver) && !pc->write_shutdown) {
+      pc->write_shutdown = true;
+      (void)shutdown(pc->fd, SHUT_WR);
+    }
+    if (!pc->reading) {
+      pn_rwbytes_t rbuf = pn_connection_driver_read_buffer(&pc->driver);
+      if (rbuf.size > 0) {
+        leader_read(pc, rbuf, next_tick, now);
+      } else {
+        leader_timer(pc, next_tick, now);
+      }
+    }
+    /* A pending read has a linked timeout for the tick deadline when it started.
+       The deadline only moves earlier when events are processed, which first
+       cancels the read.
+    */
+  }
+  return (waking || pn_connection_driver_has_event(&pc->driver)) && leader_detach(pc);
+}
+
+static void pconnection_complete(pconnection_t *pc, op_type type, int res) {
+  switch (type) {
+   case OP_CONNECT:
+    pc->connecting = false;
+    if (res == 0) {
+      pc->connected = 1;
+      pconnection_addresses(pc);
+      freeaddrinfo(pc->addrinfo); /* Done with address info */
+      pc->addrinfo = pc->ai = NULL;
+    } else {
+      if (!pc->connect_err && res != -ECANCELED) pc->connect_err = -res;
+      close(pc->fd);
+      pc->fd = -1;
+    }
+    break;
+
+   case OP_READ:
+    pc->reading = pc->cancelling = false;
+    if (res > 0) {
+      pn_connection_driver_read_done(&pc->driver, res);
+    } else if (res == 0) {
+      pn_connection_driver_read_close(&pc->driver);
+    } else if (res != -ECANCELED && res != -EINTR && res != -EAGAIN) {
+      pconnection_error(pc, -res, "on read from");
+    }
+    break;
+
+   case OP_WRITE: {
+     size_t size = pc->writing;
+     pc->writing = 0;
+     if (res < 0) {
+       pconnection_set_error(pc, -res, "on write to");
+       pn_connection_driver_write_close(&pc->driver);
+     } else if (!pn_connection_driver_write_closed(&pc->driver)) {
+       assert((size_t)res <= size);
+       pn_connection_driver_write_done(&pc->driver, res);
+     }
+     break;
+   }
+
+   case OP_TICK:
+    pc->ticking = false;
+    break;
+
+   default:                     /* Linked timeouts and timer updates just need a look */
+    break;
+  }
+  leader_notify(&pc->work);
+}
+
+static void lsocket_complete(lsocket_t *ls, pn_listener_t *l, int res, bool more) {
+  lock(&l->lock);
+  if (!more) ls->accepting = false;
+  if (res >= 0) {
+    if (l->state == L_LISTENING) {
+      if (l->accepted_len == l->accepted_cap) {
+        size_t cap = l->accepted_cap ? 2 * l->accepted_cap : 8;
+        int *accepted = (int*)realloc(l->accepted, cap * sizeof(int));
+        if (!accepted) {
+          close(res);
+          listener_error_lh(l, "out of memory", "accept from");
+          unlock(&l->lock);
+          return;
+        }
+        l->accepted = accepted;
+        l->accepted_cap = cap;
+      }
+      l->accepted[l->accepted_len++] = res;
+      /* Identical events are coalesced, pn_listener_accept2() puts the next one */
+      if (l->accepted_len - l->accepted_head == 1) {
+        pn_collector_put(l->collector, pn_listener__class(), l, PN_LISTENER_ACCEPT);
+      }
+    } else {
+      close(res);               /* Listener is closing */
+    }
+  } else if (res != -ECANCELED) {
+    strerrorbuf msg;
+    pstrerror(-res, msg);
+    listener_error_lh(l, msg, "accept from");
+  }
+  unlock(&l->lock);
+  leader_notify(&l->work);
+}
+
+/* Handle a completion, in the leader thread */
+static void leader_complete(pn_proactor_t *p, struct io_uring_cqe *cqe) {
+  op_t *op = (op_t*)(uintptr_t)cqe->user_data;
+  if (!op) return;
+  bool more = cqe->flags & IORING_CQE_F_MORE; /* Multishot request continues */
+  if (!more) {
+    --p->inflight;
+    if (op->work) --op->work->inflight;
+  }
+  switch (op->type) {
+   case OP_NOTIFY: {
+     uint64_t n;
+     (void)read(p->notifyfd, &n, sizeof(n));
+     __atomic_store_n(&p->notified, false, __ATOMIC_RELEASE);
+     if (!more && !p->freeing) leader_poll_fd(p, &p->notify_op, p->notifyfd);
+     break;
+   }
+   case OP_INTERRUPT: {
+     uint64_t n;
+     if (read(p->interruptfd, &n, sizeof(n)) == sizeof(n)) {
+       lock(&p->lock);
+       p->need_interrupt = true;
+       unlock(&p->lock);
+     }
+     if (!more && !p->freeing) leader_poll_fd(p, &p->interrupt_op, p->interruptfd);
+     break;
+   }
+   case OP_ACCEPT: {
+     lsocket_t *ls = (lsocket_t*)((char*)op - offsetof(lsocket_t, accept));
+     lsocket_complete(ls, (pn_listener_t*)op->work, cqe->res, more);
+     break;
+   }
+   default:
+    pconnection_complete((pconnection_t*)op->work, op->type, cqe->res);
+    break;
+  }
+}
+
+/* Handle all available completions */
+static void leader_reap(pn_proactor_t *p) {
+  uring_t *r = &p->ring;
+  unsigned head = *r->cq_head;
+  unsigned tail;
+  while (head != (tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))) {
+    for (; head != tail; ++head) {
+      struct io_uring_cqe cqe = r->cqes[head & *r->cq_mask];
+      __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+      leader_complete(p, &cqe);
+    }
+  }
+}
+
+/* Submit requests and handle completions. If wait, block for at least one
+ * completion or until deadline if it is not 0.
+ */
+static void leader_poll(pn_proactor_t *p, bool wait, uint64_t deadline) {
+  struct __kernel_timespec ts, *tsp = NULL;
+  if (wait && deadline) {
+    set_timespec(&ts, deadline, monotonic_millis());
+    tsp = &ts;
+  }
+  if (!wait && !p->ring.unsubmitted) {
+    leader_reap(p);
+    return;
+  }
+  int err = uring_enter(&p->ring, wait ? 1 : 0, tsp);
+  if (err && err != EINTR && err != ETIME && err != EAGAIN && err != EBUSY) {
+    URING_FATAL(io_uring_enter, err);
+  }
+  leader_reap(p);
+}
+
+static pn_event_batch_t *proactor_batch_lh(pn_proactor_t *p, pn_event_type_t t) {
+  pn_collector_put(p->collector, pn_proactor__class(), p, t);
+  p->batch_working = true;
+  return &p->batch;
+}
+
+static pn_event_t *log_event(void* p, pn_event_t *e) {
+  if (e) {
+    pn_logf("[%p]:(%s)", (void*)p, pn_event_type_name(pn_event_type(e)));
+  }
+  return e;
+}
+
+static pn_event_t *listener_batch_next(pn_event_batch_t *batch) {
+  pn_listener_t *l = batch_listener(batch);
+  lock(&l->lock);
+  pn_event_t *e = pn_collector_next(l->collector);
+  unlock(&l->lock);
+  return log_event(l, e);
+}
+
+static pn_event_t *proactor_batch_next(pn_event_batch_t *batch) {
+  pn_proactor_t *p = batch_proactor(batch);
+  assert(p->batch_working);
+  return log_event(p, pn_collector_next(p->collector));
+}
+
+/* Return the next event batch or NULL if no events are available */
+static pn_event_batch_t *get_batch_lh(pn_proactor_t *p) {
+  if (!p->batch_working) {       /* Can generate proactor events */
+    if (p->need_inactive) {
+      p->need_inactive = false;
+      return proactor_batch_lh(p, PN_PROACTOR_INACTIVE);
+    }
+    if (p->need_interrupt) {
+      p->need_interrupt = false;
+      return proactor_batch_lh(p, PN_PROACTOR_INTERRUPT);
+    }
+    if (p->timeout_state == TM_FIRED) {
+      p->timeout_state = TM_NONE;
+      remove_active_lh(p);
+      return proactor_batch_lh(p, PN_PROACTOR_TIMEOUT);
+    }
+  }
+  for (work_t *w = work_pop(&p->worker_q); w; w = work_pop(&p->worker_q)) {
+    assert(w->working);
+    switch (w->type) {
+     case T_CONNECTION: {
+       /* The calling thread owns the connection now */
+       pconnection_t *pc = (pconnection_t*)w;
+       if (w->disconnect) {
+         w->disconnect = false;
+         pconnection_disconnect_lh(pc);
+       }
+       check_wake(pc, true);
+       return &pc->driver.batch;
+     }
+     case T_LISTENER:
+      return &((pn_listener_t*)w)->batch;
+     default:
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Close the sockets of a listener, when no accept is in flight */
+static void listener_close_sockets_lh(pn_listener_t *l) {
+  for (size_t i = 0; i < l->lsockets_len; ++i) {
+    if (l->lsockets[i].fd >= 0) {
+      close(l->lsockets[i].fd);
+      l->lsockets[i].fd = -1;
+    }
+  }
+  for (; l->accepted_head < l->accepted_len; ++l->accepted_head) {
+    close(l->accepted[l->accepted_head]); /* Never accepted by the application */
+  }
+}
+
+/* Process a listener, return true if it has events for a worker thread */
+static bool leader_process_listener(pn_listener_t *l, bool disconnect) {
+  pn_proactor_t *p = l->work.proactor;
+  lock(&l->lock);
+  if (disconnect) {
+    lock(&p->lock);
+    pn_condition_copy(l->condition, p->disconnect_cond);
+    unlock(&p->lock);
+    if (l->state < L_CLOSE) l->state = L_CLOSE;
+  }
+  switch (l->state) {
+
+   case L_LISTENING:
+    for (size_t i = 0; i < l->lsockets_len; ++i) {
+      lsocket_t *ls = &l->lsockets[i];
+      if (!ls->accepting) {
+        struct io_uring_sqe *sqe = leader_sqe(p, &ls->accept, IORING_OP_ACCEPT, ls->fd);
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        ls->accepting = true;
+      }
+    }
+    break;
+
+   case L_CLOSE:                /* Close requested, cancel accepts */
+    l->state = L_CLOSING;
+    for (size_t i = 0; i < l->lsockets_len; ++i) {
+      if (l->lsockets[i].accepting) leader_cancel(p, &l->lsockets[i].accept);
+    }
+    /* NOTE: Fall through in case we have 0 sockets - e.g. resolver error */
+
+   case L_CLOSING:              /* Closing - can we send PN_LISTENER_CLOSE? */
+    if (!l->work.inflight) {
+      listener_close_sockets_lh(l);
+      l->state = L_CLOSED;
+      pn_collector_put(l->collector, pn_listener__class(), l, PN_LISTENER_CLOSE);
+    }
+    break;
+
+   case L_CLOSED:              /* Closed, has LISTENER_CLOSE has been processed? */
+    if (!pn_collector_peek(l->collector)) {
+      l->work.closed = true;
+    }
+  }
+  bool has_work = !l->work.closed && pn_collector_peek(l->collector);
+  unlock(&l->lock);
+  return has_work;
+}
+
+static void work_free(work_t *w) {
+  switch (w->type) {
+   case T_CONNECTION: pconnection_free((pconnection_t*)w); break;
+   case T_LISTENER: pn_listener_free((pn_listener_t*)w); break;
+   default: break;
+  }
+}
+
+static void check_timeout_lh(pn_proactor_t *p) {
+  if (p->timeout_state == TM_PENDING && monotonic_millis() >= p->deadline) {
+    p->timeout_state = TM_FIRED;
+  }
+}
+
+/* Process the leader_q and the ring, in the leader thread */
+static pn_event_batch_t *leader_lead_lh(pn_proactor_t *p, bool wait) {
+  /* Set timeout deadline if there was a request, let it count down while we process work */
+  if (p->timeout_state == TM_REQUEST) {
+    p->timeout_state = TM_PENDING;
+    p->deadline = monotonic_millis() + p->timeout;
+  }
+  check_timeout_lh(p);
+  for (work_t *w = work_pop(&p->leader_q); w; w = work_pop(&p->leader_q)) {
+    assert(!w->working);
+    bool disconnect = w->disconnect;
+    w->disconnect = false;
+
+    unlock(&p->lock);  /* Unlock to process each item, may add more items to leader_q */
+    bool has_work = false;
+    switch (w->type) {
+     case T_CONNECTION:
+      has_work = leader_process_pconnection((pconnection_t*)w, disconnect);
+      break;
+     case T_LISTENER:
+      has_work = leader_process_listener((pn_listener_t*)w, disconnect);
+      break;
+     default:
+      break;
+    }
+    lock(&p->lock);
+
+    if (w->closed) {
+      if (w->next == work_unqueued) { /* Not re-queued while we were processing it */
+        work_remove_lh(w);
+        remove_active_lh(p);
+        unlock(&p->lock);
+        work_free(w);
+        lock(&p->lock);
+      }
+    } else if (has_work && !w->working && w->next == work_unqueued) {
+      w->working = true;
+      work_push(&p->worker_q, w);
+    }
+  }
+  pn_event_batch_t *batch = get_batch_lh(p);      /* Check for work */
+  if (!batch) {                 /* No work, submit requests and wait for completions */
+    if (p->leader_q.front) wait = false;          /* Completions queued more work */
+    uint64_t deadline = (p->timeout_state == TM_PENDING) ? p->deadline : 0;
+    unlock(&p->lock);
+    leader_poll(p, wait, deadline);
+    lock(&p->lock);
+    check_timeout_lh(p);
+    batch = get_batch_lh(p);
+  }
+  return batch;
+}
+
+/**** public API ****/
+
+pn_event_batch_t *pn_proactor_get(struct pn_proactor_t* p) {
+  lock(&p->lock);
+  pn_event_batch_t *batch = get_batch_lh(p);
+  if (batch == NULL && !p->has_leader) {
+    /* Try a non-blocking lead to generate some work */
+    p->has_leader = true;
+    batch = leader_lead_lh(p, false);
+    p->has_leader = false;
+    pthread_cond_broadcast(&p->cond);   /* Signal followers for possible work */
+  }
+  unlock(&p->lock);
+  return batch;
+}
+
+pn_event_batch_t *pn_proactor_wait(struct pn_proactor_t* p) {
+  lock(&p->lock);
+  pn_event_batch_t *batch = get_batch_lh(p);
+  while (!batch && p->has_leader) {
+    pthread_cond_wait(&p->cond, &p->lock); /* Follow the leader */
+    batch = get_batch_lh(p);
+  }
+  if (!batch) {                 /* Become leader */
+    p->has_leader = true;
+    do {
+      batch = leader_lead_lh(p, true);
+    } while (!batch);
+    p->has_leader = false;
+    pthread_cond_broadcast(&p->cond); /* Signal a followers. One takes over, many can work. */
+  }
+  unlock(&p->lock);
+  return batch;
+}
+
+void pn_proactor_done(pn_proactor_t *p, pn_event_batch_t *batch) {
+  if (!batch) return;
+  lock(&p->lock);
+  work_t *w = batch_work(batch);
+  if (w) {
+    assert(w->working);
+    assert(w->next == work_unqueued);
+    w->working = false;
+    work_push(&p->leader_q, w);
+  }
+  pn_proactor_t *bp = batch_proactor(batch); /* Proactor events */
+  if (bp == p) {
+    p->batch_working = false;
+  }
+  unlock(&p->lock);
+  notify(p);
+}
+
+pn_listener_t *pn_event_listener(pn_event_t *e) {
+  return (pn_event_class(e) == pn_listener__class()) ? (pn_listener_t*)pn_event_context(e) : NULL;
+}
+
+pn_proactor_t *pn_event_proactor(pn_event_t *e) {
+  if (pn_event_class(e) == pn_proactor__class()) {
+    return (pn_proactor_t*)pn_event_context(e);
+  }
+  pn_listener_t *l = pn_event_listener(e);
+  if (l) {
+    return l->work.proactor;
+  }
+  pn_connection_t *c = pn_event_connection(e);
+  if (c) {
+    return pn_connection_proactor(pn_event_connection(e));
+  }
+  return NULL;
+}
+
+void pn_proactor_set_busy_poll(pn_proactor_t *p, uint32_t usec) {
+  (void)p; (void)usec;          /* Not supported */
+}
+
+void pn_proactor_set_zerocopy_threshold(pn_proactor_t *p, size_t bytes) {
+  (void)p; (void)bytes;         /* Not supported */
+}
+
+void pn_proactor_stats_enable(pn_proactor_t *p, bool enable) {
+  (void)p; (void)enable;        /* Not supported */
+}
+
+bool pn_proactor_stats(pn_proactor_t *p, pn_proactor_stats_t *stats) {
+  (void)p;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
+bool pn_connection_stats(pn_connection_t *c, pn_proactor_stats_t *stats) {
+  (void)c;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
+void pn_proactor_interrupt(pn_proactor_t *p) {
+  /* NOTE: pn_proactor_interrupt must be async-signal-safe so we cannot use
+     locks to update shared proactor state here. Instead we use a dedicated
+     eventfd, the leader sets the interrupt flag when it completes a poll.
+   */
+  uint64_t one = 1;
+  (void)write(p->interruptfd, &one, sizeof(one));
+}
+
+void pn_proactor_disconnect(pn_proactor_t *p, pn_condition_t *cond) {
+  lock(&p->lock);
+  if (cond) {
+    pn_condition_copy(p->disconnect_cond, cond);
+  } else {
+    pn_condition_clear(p->disconnect_cond);
+  }
+  /* Mark every connection and listener, including those waiting for a worker */
+  if (p->active) {
+    for (work_t *w = p->all; w; w = w->all_next) {
+      w->disconnect = true;
+      work_queue_lh(w);
+    }
+  } else {
+    p->need_inactive = true;  /* Send INACTIVE right away, nothing to do. */
+  }
+  unlock(&p->lock);
+  notify(p);
+}
+
+void pn_proactor_set_timeout(pn_proactor_t *p, pn_millis_t t) {
+  lock(&p->lock);
+  p->timeout = t;
+  // This timeout *replaces* any existing timeout
+  if (p->timeout_state == TM_NONE) ++p->active;
+  p->timeout_state = TM_REQUEST;
+  unlock(&p->lock);
+  notify(p);
+}
+
+void pn_proactor_cancel_timeout(pn_proactor_t *p) {
+  lock(&p->lock);
+  if (p->timeout_state != TM_NONE) {
+    p->timeout_state = TM_NONE;
+    remove_active_lh(p);
+    notify(p);
+  }
+  unlock(&p->lock);
+}
+
+void pn_proactor_connect2(pn_proactor_t *p, pn_connection_t *c, pn_transport_t *t, const char *addr) {
+  pconnection_t *pc = pconnection(p, c, t, false);
+  if (!pc) return;              /* Out of memory, nothing left to report on */
+  pn_connection_open(pc->driver.connection);   /* Auto-open */
+  pni_parse_addr(addr, pc->addr_buf, sizeof(pc->addr_buf), &pc->host, &pc->port);
+  /* Resolve in the calling thread, so the leader never blocks on a lookup */
+  int gai_err = pgetaddrinfo(pc->host, pc->port, 0, &pc->addrinfo);
+  if (gai_err) {
+    pn_connection_driver_bind(&pc->driver);
+    pni_proactor_set_cond(pn_transport_condition(pc->driver.transport),
+                          "connect to", pc->host, pc->port, gai_strerror(gai_err));
+    pn_connection_driver_close(&pc->driver);
+    pc->connected = -1;
+  } else {
+    pc->ai = pc->addrinfo;
+  }
+  work_start(&pc->work);
+}
+
+/* Bind and listen on all the addresses for a listener, in the calling thread */
+void pn_proactor_listen(pn_proactor_t *p, pn_listener_t *l, const char *addr, int backlog) {
+  work_init(&l->work, p, T_LISTENER);
+  pni_parse_addr(addr, l->addr_buf, sizeof(l->addr_buf), &l->host, &l->port);
+  l->backlog = backlog;
+
+  struct addrinfo *addrinfo = NULL;
+  int gai_err = pgetaddrinfo(l->host, l->port, AI_PASSIVE | AI_ALL, &addrinfo);
+  int err = 0;
+  if (!gai_err) {
+    /* Count addresses, allocate enough space for sockets */
+    size_t len = 0;
+    for (struct addrinfo *ai = addrinfo; ai; ai = ai->ai_next) {
+      ++len;
+    }
+    l->lsockets = (lsocket_t*)calloc(len, sizeof(lsocket_t));
+    if (!l->lsockets) err = ENOMEM; /* Reported below as all addresses failing */
+    uint16_t dynamic_port = 0;  /* Record dynamic port from first bind(0) */
+    /* Find working listen addresses */
+    for (struct addrinfo *ai = addrinfo; l->lsockets && ai; ai = ai->ai_next) {
+      if (dynamic_port) set_port(ai->ai_addr, dynamic_port);
+      int fd = socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, ai->ai_protocol);
+      static int on = 1;
+      if (fd >= 0) {
+        if (!setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) &&
+            /* We listen to v4/v6 on separate sockets, don't let v6 listen for v4 */
+            (ai->ai_family != AF_INET6 ||
+             !setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on))) &&
+            !bind(fd, ai->ai_addr, ai->ai_addrlen) &&
+            !listen(fd, backlog))
+        {
+          lsocket_t *ls = &l->lsockets[l->lsockets_len++];
+          op_init(&ls->accept, OP_ACCEPT, &l->work);
+          ls->fd = fd;
+          /* Get actual address */
+          socklen_t len = sizeof(ls->addr.ss);
+          (void)getsockname(fd, (struct sockaddr*)(&ls->addr.ss), &len);
+          if (ls == l->lsockets) { /* First socket, check for dynamic port */
+            dynamic_port = check_dynamic_port(ai->ai_addr, pn_netaddr_sockaddr(&ls->addr));
+          } else {              /* Link addr to previous addr */
+            (ls-1)->addr.next = &ls->addr;
+          }
+        } else {
+          err = errno;
+          close(fd);
+        }
+      } else {
+        err = errno;
+      }
+    }
+  }
+  if (addrinfo) {
+    freeaddrinfo(addrinfo);
+  }
+  lock(&l->lock);
+  if (l->lsockets_len == 0) {   /* All failed */
+    if (gai_err) {
+      listener_error_lh(l, gai_strerror(gai_err), "listen on");
+    } else {
+      strerrorbuf msg;
+      pstrerror(err, msg);
+      listener_error_lh(l, msg, "listen on");
+    }
+  } else {
+    l->state = L_LISTENING;
+    pn_collector_put(l->collector, pn_listener__class(), l, PN_LISTENER_OPEN);
+  }
+  unlock(&l->lock);
+  work_start(&l->work);
+}
+
+pn_proactor_t *pn_proactor() {
+  pn_proactor_t *p = (pn_proactor_t*)calloc(1, sizeof(pn_proactor_t));
+  if (!p) return NULL;
+  p->notifyfd = p->interruptfd = -1;
+  p->ring.fd = -1;
+  p->collector = pn_collector();
+  p->disconnect_cond = pn_condition();
+  if (p->collector && p->disconnect_cond &&
+      (p->notifyfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0 &&
+      (p->interruptfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0 &&
+      uring_init(&p->ring, RING_ENTRIES) == 0)
+  {
+    p->batch.next_event = &proactor_batch_next;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    op_init(&p->notify_op, OP_NOTIFY, NULL);
+    op_init(&p->interrupt_op, OP_INTERRUPT, NULL);
+    leader_poll_fd(p, &p->notify_op, p->notifyfd);
+    leader_poll_fd(p, &p->interrupt_op, p->interruptfd);
+    return p;
+  }
+  if (p->interruptfd >= 0) close(p->interruptfd);
+  if (p->notifyfd >= 0) close(p->notifyfd);
+  if (p->disconnect_cond) pn_condition_free(p->disconnect_cond);
+  if (p->collector) pn_collector_free(p->collector);
+  free(p);
+  return NULL;
+}
+
+pn_proactor_t *pn_proactor_sharded(size_t shards) {
+  return pn_proactor();        /* Not supported, all threads share one ring */
+}
+
+void pn_proactor_free(pn_proactor_t *p) {
+  /* No other threads use the proactor now. Shut down the sockets and cancel
+     every request, then wait till the kernel is done with our memory.
+  */
+  p->freeing = true;
+  for (work_t *w = p->all; w; w = w->all_next) {
+    if (w->type == T_CONNECTION && ((pconnection_t*)w)->fd >= 0) {
+      (void)shutdown(((pconnection_t*)w)->fd, SHUT_RDWR);
+    }
+  }
+  struct io_uring_sqe *sqe = leader_sqe(p, NULL, IORING_OP_ASYNC_CANCEL, -1);
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+  leader_poll(p, false, 0);
+  while (p->inflight) {
+    leader_poll(p, true, 0);
+  }
+  /* Free all work items */
+  while (p->all) {
+    work_t *w = p->all;
+    p->all = w->all_next;
+    work_free(w);
+  }
+  uring_finalize(&p->ring);
+  close(p->notifyfd);
+  close(p->interruptfd);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->cond);
+  pn_collector_free(p->collector);
+  pn_condition_free(p->disconnect_cond);
+  free(p);
+}
+
+pn_proactor_t *pn_connection_proactor(pn_connection_t* c) {
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
+  pn_proactor_t *p = pc ? pc->work.proactor : NULL;
+  pni_hazard_release(h);
+  return p;
+}
+
+void pn_connection_wake(pn_connection_t* c) {
+  /* May be called from any thread */
+  pni_hazard_t *h = pni_hazard();
+  pconnection_t *pc = acquire_pconnection(h, c);
+  if (pc) {
+    bool notify = false;
+    lock(&pc->lock);
+    if (pc->wake == W_NONE) {
+      pc->wake = W_PENDING;
+      notify = true;
+    }
+    unlock(&pc->lock);
+    if (notify) {
+      work_notify(&pc->work);
+    }
+  }
+  pni_hazard_release(h);
+}
+
+void pn_proactor_release_connection(pn_connection_t *c) {
+  pconnection_t *pc = get_pconnection(c);
+  if (pc) {
+    set_pconnection(c, NULL);
+    pn_connection_driver_release_connection(&pc->driver);
+    work_notify(&pc->work);     /* Driver is closed, let the leader clean up */
+  }
+}
+
+pn_listener_t *pn_listener(void) {
+  pn_listener_t *l = (pn_listener_t*)calloc(1, sizeof(pn_listener_t));
+  if (l) {
+    l->batch.next_event = listener_batch_next;
+    l->collector = pn_collector();
+    l->condition = pn_condition();
+    l->attachments = pn_record();
+    if (!l->condition || !l->collector || !l->attachments) {
+      pn_listener_free(l);
+      return NULL;
+    }
+    pthread_mutex_init(&l->lock, NULL);
+  }
+  return l;
+}
+
+void pn_listener_free(pn_listener_t *l) {
+  if (l) {
+    if (l->collector) pn_collector_free(l->collector);
+    if (l->condition) pn_condition_free(l->condition);
+    if (l->attachments) pn_free(l->attachments);
+    listener_close_sockets_lh(l);
+    free(l->lsockets);
+    free(l->accepted);
+    pthread_mutex_destroy(&l->lock);
+    free(l);
+  }
+}
+
+void pn_listener_close(pn_listener_t* l) {
+  /* May be called from any thread */
+  lock(&l->lock);
+  listener_close_lh(l);
+  unlock(&l->lock);
+}
+
+void pn_listener_set_reuseport(pn_listener_t *l, size_t sockets) {
+  (void)l; (void)sockets;       /* Not supported, one socket per address */
+}
+
+pn_proactor_t *pn_listener_proactor(pn_listener_t* l) {
+  return l ? l->work.proactor : NULL;
+}
+
+pn_condition_t* pn_listener_condition(pn_listener_t* l) {
+  return l->condition;
+}
+
+void *pn_listener_get_context(pn_listener_t *l) {
+  return l->context;
+}
+
+void pn_listener_set_context(pn_listener_t *l, void *context) {
+  l->context = context;
+}
+
+pn_record_t *pn_listener_attachments(pn_listener_t *l) {
+  return l->attachments;
+}
+
+void pn_listener_accept2(pn_listener_t *l, pn_connection_t *c, pn_transport_t *t) {
+  pconnection_t *pc = pconnection(l->work.proactor, c, t, true);
+  /* Take the socket for the accept event that we are processing */
+  lock(&l->lock);
+  int fd = -1;
+  if (l->accepted_head < l->accepted_len) {
+    fd = l->accepted[l->accepted_head++];
+    if (l->accepted_head == l->accepted_len) {
+      l->accepted_head = l->accepted_len = 0;
+    } else {
+      pn_collector_put(l->collector, pn_listener__class(), l, PN_LISTENER_ACCEPT);
+    }
+  }
+  unlock(&l->lock);
+  if (!pc) {                    /* Out of memory, drop the accepted socket */
+    if (fd >= 0) close(fd);
+    return;
+  }
+  if (fd >= 0) {
+    pc->fd = fd;
+    pc->connected = 1;          /* Don't need to connect() */
+    configure_socket(fd);
+    pconnection_addresses(pc);
+  } else {
+    pc->host = l->host;
+    pc->port = l->port;
+    pconnection_error(pc, EAGAIN, "accept from");
+    pc->connected = -1;
+  }
+  work_start(&pc->work);
+}
+
+const pn_netaddr_t *pn_transport_local_addr(pn_transport_t *t) {
+  pconnection_t *pc = get_pconnection(pn_transport_connection(t));
+  return pc? &pc->local : NULL;
+}
+
+const pn_netaddr_t *pn_transport_remote_addr(pn_transport_t *t) {
+  pconnection_t *pc = get_pconnection(pn_transport_connection(t));
+  return pc ? &pc->remote : NULL;
+}
+
+const pn_netaddr_t *pn_listener_addr(pn_listener_t *l) {
+  return l->lsockets_len > 0 ? &l->lsockets[0].addr : NULL;
+}
+
+pn_millis_t pn_proactor_now(void) {
+  return monotonic_millis();
+}
@@ -2568,6 +2568,30 @@ pn_event_batch_t *pn_proactor_get(struct pn_proactor_t* p) {
   return proactor_completion_loop(p, false);
 }
 
+void pn_proactor_set_busy_poll(pn_proactor_t *p, uint32_t usec) {
+  (void)p; (void)usec;          /* Not supported */
+}
+
+void pn_proactor_set_zerocopy_threshold(pn_proactor_t *p, size_t bytes) {
+  (void)p; (void)bytes;         /* Not supported */
+}
+
+void pn_proactor_stats_enable(pn_proactor_t *p, bool enable) {
+  (void)p; (void)enable;        /* Not supported */
+}
+
+bool pn_proactor_stats(pn_proactor_t *p, pn_proactor_stats_t *stats) {
+  (void)p;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
+bool pn_connection_stats(pn_connection_t *c, pn_proactor_stats_t *stats) {
+  (void)c;
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
 void pn_proactor_interrupt(pn_proactor_t *p) {
   csguard g(&p->context.cslock);
   if (p->context.working)
@@ -3021,6 +3045,10 @@ pn_proactor_t *pn_proactor() {
   return NULL;
 }
 
+pn_proactor_t *pn_proactor_sharded(size_t shards) {
+  return pn_proactor();        /* Not supported, all threads share one queue */
+}
+
 void pn_proactor_free(pn_proactor_t *p) {
   DeleteTimerQueueEx(p->timer_queue, INVALID_HANDLE_VALUE);
   DeleteCriticalSection(&p->timer_lock);
@@ -3112,6 +3140,10 @@ void pn_listener_close(pn_listener_t* l) {
   wakeup(&l->psockets[0]);
 }
 
+void pn_listener_set_reuseport(pn_listener_t *l, size_t sockets) {
+  (void)l; (void)sockets;       /* Not supported, one socket per address */
+}
+
 pn_proactor_t *pn_listener_proactor(pn_listener_t* l) {
   return l ? l->context.proactor : NULL;
 }
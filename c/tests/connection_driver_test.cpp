@@ -28,8 +28,15 @@
 #include <proton/session.h>
 #include <proton/transport.h>
 
+#include "core/engine-internal.h"
+#include "core/transport-internal.h"
+
 #include <string.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 using Catch::Matchers::EndsWith;
 using Catch::Matchers::Equals;
 using namespace pn_test;
@@ -231,6 +238,647 @@ TEST_CASE("driver_message_stream") {
   free(buf2.start);
 }
 
+namespace {
+/* Give bytes to dst as input */
+void read_bytes(pn_connection_driver_t &dst, pn_bytes_t bytes) {
+  for (size_t done = 0; done < bytes.size;) {
+    pn_rwbytes_t rb = pn_connection_driver_read_buffer(&dst);
+    size_t size = std::min(rb.size, bytes.size - done);
+    if (!size) break;
+    std::copy(bytes.start + done, bytes.start + done + size, rb.start);
+    pn_connection_driver_read_done(&dst, size);
+    done += size;
+  }
+}
+
+/* Like driver::read() but transfer data from src using the scatter/gather
+ * write buffers */
+size_t gather_read(pn_connection_driver_t &dst, pn_connection_driver_t &src) {
+  pn_bytes_t bufs[4];
+  size_t n = pn_connection_driver_write_buffers(&src, bufs, 4);
+  size_t total = 0;
+  for (size_t i = 0; i < n; ++i) {
+    read_bytes(dst, bufs[i]);
+    total += bufs[i].size;
+  }
+  pn_connection_driver_write_done(&src, total);
+  return total;
+}
+} // namespace
+
+/* Send a message using the gather write buffers for output */
+TEST_CASE("driver_message_write_buffers") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  /* Big enough to span several frames */
+  std::string body(100000, 'x');
+  pn_delivery_t *sd = pn_delivery(snd, pn_bytes("x"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+  CHECK(pn_link_advance(snd));
+
+  size_t n = 0;
+  do {
+    d.client.run();
+    n = gather_read(d.server, d.client);
+  } while (n);
+  CHECK(PN_DELIVERY == d.server.run());
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  std::string received(pn_delivery_pending(dlv), '\0');
+  CHECK((ssize_t)received.size() ==
+        pn_link_recv(rcv, &received[0], received.size()));
+  CHECK(body == received);
+
+  /* Frames in both directions after the transfer still work */
+  pn_delivery_update(dlv, PN_ACCEPTED);
+  pn_delivery_settle(dlv);
+  while (d.run())
+    ;
+  CHECK(PN_ACCEPTED == pn_delivery_remote_state(sd));
+}
+
+namespace {
+/* Like driver::read() but transfer at most max bytes at a time, leaving
+ * partially read and written data in the transport buffers */
+size_t trickle_read(pn_connection_driver_t &dst, pn_connection_driver_t &src,
+                    size_t max) {
+  size_t total = 0, size = 0;
+  do {
+    pn_bytes_t wb = pn_connection_driver_write_buffer(&src);
+    pn_rwbytes_t rb = pn_connection_driver_read_buffer(&dst);
+    size = std::min(std::min(rb.size, wb.size), max);
+    if (size) {
+      std::copy(wb.start, wb.start + size, rb.start);
+      pn_connection_driver_write_done(&src, size);
+      pn_connection_driver_read_done(&dst, size);
+      total += size;
+    }
+  } while (size);
+  return total;
+}
+} // namespace
+
+/* Send a large message a few bytes at a time */
+TEST_CASE("driver_message_trickle") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  std::string body(100000, 'x');
+  for (size_t i = 0; i < body.size(); ++i) body[i] = char(i % 251);
+  pn_delivery(snd, pn_bytes("x"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+  CHECK(pn_link_advance(snd));
+
+  size_t n = 0;
+  do {
+    d.client.run();
+    n = trickle_read(d.server, d.client, 7);
+  } while (n);
+  CHECK(PN_DELIVERY == d.server.run());
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  std::string received(pn_delivery_pending(dlv), '\0');
+  CHECK((ssize_t)received.size() ==
+        pn_link_recv(rcv, &received[0], received.size()));
+  CHECK(body == received);
+}
+
+/* Outcomes with details, and reuse of deliveries with a limited pool */
+TEST_CASE("driver_delivery_pool") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_connection_t *sc = pn_session_connection(pn_link_session(rcv));
+  CHECK(SIZE_MAX == pn_connection_get_delivery_pool_max(sc));
+  pn_connection_set_delivery_pool_max(sc, 1);
+  CHECK(1 == pn_connection_get_delivery_pool_max(sc));
+
+  for (int round = 0; round < 3; ++round) {
+    pn_link_flow(rcv, 3);
+    d.run();
+    pn_delivery_t *sent[3];
+    for (int i = 0; i < 3; ++i) {
+      char tag = char('a' + i);
+      sent[i] = pn_delivery(snd, pn_bytes(1, &tag));
+      CHECK(1 == pn_link_send(snd, "m", 1));
+      CHECK(pn_link_advance(snd));
+    }
+    while (d.run())
+      ;
+
+    for (int i = 0; i < 3; ++i) {
+      pn_delivery_t *dlv = pn_link_current(rcv);
+      REQUIRE(dlv);
+      CHECK(std::string(1, char('a' + i)) ==
+            std::string(pn_delivery_tag(dlv).start, pn_delivery_tag(dlv).size));
+      char c;
+      CHECK(1 == pn_link_recv(rcv, &c, 1));
+      pn_link_advance(rcv);
+      pn_disposition_t *local = pn_delivery_local(dlv);
+      switch (i) {
+      case 0:
+        pn_delivery_update(dlv, PN_ACCEPTED);
+        break;
+      case 1:
+        pn_condition_set_name(pn_disposition_condition(local), "x:bad");
+        pn_delivery_update(dlv, PN_REJECTED);
+        break;
+      case 2:
+        pn_disposition_set_failed(local, true);
+        pn_data_put_map(pn_disposition_annotations(local));
+        pn_delivery_update(dlv, PN_MODIFIED);
+        break;
+      }
+      pn_delivery_settle(dlv);
+    }
+    while (d.run())
+      ;
+
+    CHECK(PN_ACCEPTED == pn_delivery_remote_state(sent[0]));
+    CHECK(!pn_condition_is_set(pn_disposition_condition(pn_delivery_remote(sent[0]))));
+    CHECK(PN_REJECTED == pn_delivery_remote_state(sent[1]));
+    CHECK_THAT("x:bad", Equals(pn_condition_get_name(
+                            pn_disposition_condition(pn_delivery_remote(sent[1])))));
+    CHECK(PN_MODIFIED == pn_delivery_remote_state(sent[2]));
+    CHECK(pn_disposition_is_failed(pn_delivery_remote(sent[2])));
+    for (int i = 0; i < 3; ++i) pn_delivery_settle(sent[i]);
+    d.run();
+  }
+  pn_connection_set_delivery_pool_max(sc, 0);
+}
+
+namespace {
+/* Bytes that show if any are lost, duplicated or out of order */
+std::string pattern(size_t offset, size_t size) {
+  std::string s(size, '\0');
+  for (size_t i = 0; i < size; ++i) s[i] = char((offset + i) % 251);
+  return s;
+}
+
+std::string delivery_tag(pn_delivery_t *d) {
+  pn_delivery_tag_t tag = pn_delivery_tag(d);
+  return std::string(tag.start, tag.size);
+}
+} // namespace
+
+/* A payload that wraps around in the delivery's inline storage
+ * (PN_DELIVERY_INLINE_PAYLOAD, 256 by default) and then outgrows it */
+TEST_CASE("driver_delivery_inline_payload_grow") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  pn_delivery(snd, pn_bytes("x"));
+  std::string received;
+  /* 100 bytes then receive 60 so the payload starts part way in, 200 more wrap
+   * around the end of the inline storage, 400 more must grow it */
+  const size_t chunks[] = {100, 200, 400};
+  size_t sent = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    std::string chunk = pattern(sent, chunks[i]);
+    CHECK((ssize_t)chunk.size() == pn_link_send(snd, chunk.data(), chunk.size()));
+    sent += chunk.size();
+    d.run();
+    if (i == 0) {
+      char buf[60];
+      REQUIRE((ssize_t)sizeof(buf) == pn_link_recv(rcv, buf, sizeof(buf)));
+      received.append(buf, sizeof(buf));
+    }
+  }
+  CHECK(pn_link_advance(snd));
+  d.run();
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  CHECK(sent - received.size() == pn_delivery_pending(dlv));
+  std::string rest(pn_delivery_pending(dlv), '\0');
+  CHECK((ssize_t)rest.size() == pn_link_recv(rcv, &rest[0], rest.size()));
+  received += rest;
+  CHECK(pattern(0, sent) == received);
+}
+
+/* Tags up to the longest AMQP allows are kept inline, longer ones still work */
+TEST_CASE("driver_delivery_tag_size") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  std::string tag32 = pattern(1, 32);
+  pn_delivery_t *sd = pn_delivery(snd, pn_bytes(tag32.size(), tag32.data()));
+  CHECK(tag32 == delivery_tag(sd));
+  CHECK(1 == pn_link_send(snd, "m", 1));
+  CHECK(pn_link_advance(snd));
+  CHECK(PN_DELIVERY == d.run());
+  REQUIRE(server.delivery);
+  CHECK(tag32 == delivery_tag(server.delivery));
+
+  std::string tag40 = pattern(2, 40);
+  pn_delivery_t *ld = pn_delivery(snd, pn_bytes(tag40.size(), tag40.data()));
+  CHECK(tag40 == delivery_tag(ld));
+}
+
+/* A pooled delivery that held a large payload goes back to its inline storage
+ * when released, and is reused for a small one */
+TEST_CASE("driver_delivery_pool_large_payload") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_connection_set_delivery_pool_max(d.server.connection, 1);
+
+  const size_t sizes[] = {5000, 10, 300};
+  for (size_t i = 0; i < 3; ++i) {
+    pn_link_flow(rcv, 1);
+    d.run();
+    std::string tag = pattern(i, i + 1);
+    std::string body = pattern(i, sizes[i]);
+    pn_delivery_t *sd = pn_delivery(snd, pn_bytes(tag.size(), tag.data()));
+    CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+    CHECK(pn_link_advance(snd));
+    while (d.run())
+      ;
+    pn_delivery_t *dlv = server.delivery;
+    REQUIRE(dlv);
+    CHECK(tag == delivery_tag(dlv));
+    std::string received(pn_delivery_pending(dlv), '\0');
+    CHECK((ssize_t)received.size() == pn_link_recv(rcv, &received[0], received.size()));
+    CHECK(body == received);
+    pn_link_advance(rcv);
+    pn_delivery_update(dlv, PN_ACCEPTED);
+    pn_delivery_settle(dlv);
+    while (d.run())
+      ;
+    CHECK(PN_ACCEPTED == pn_delivery_remote_state(sd));
+    pn_delivery_settle(sd);
+    d.run();
+  }
+  pn_connection_set_delivery_pool_max(d.server.connection, 0);
+}
+
+/* Many unsettled deliveries, settled out of order and in ranges */
+TEST_CASE("driver_delivery_map") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  const int n = 100;
+  for (int round = 0; round < 2; ++round) {
+    pn_link_flow(rcv, n);
+    d.run();
+    std::vector<pn_delivery_t *> sent, received;
+    for (int i = 0; i < n; ++i) {
+      std::string tag = std::to_string(i);
+      sent.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+      CHECK(1 == pn_link_send(snd, "m", 1));
+      CHECK(pn_link_advance(snd));
+    }
+    while (d.run())
+      ;
+    for (int i = 0; i < n; ++i) {
+      pn_delivery_t *dlv = pn_link_current(rcv);
+      REQUIRE(dlv);
+      received.push_back(dlv);
+      char c;
+      CHECK(1 == pn_link_recv(rcv, &c, 1));
+      pn_link_advance(rcv);
+    }
+    /* Every third in reverse, then the rest in order */
+    for (int i = n - 1; i >= 0; --i) {
+      if (i % 3 == 0) {
+        pn_delivery_update(received[i], PN_ACCEPTED);
+        pn_delivery_settle(received[i]);
+      }
+    }
+    while (d.run())
+      ;
+    for (int i = 0; i < n; ++i) {
+      if (i % 3 != 0) {
+        pn_delivery_update(received[i], PN_RELEASED);
+        pn_delivery_settle(received[i]);
+      }
+    }
+    while (d.run())
+      ;
+    for (int i = 0; i < n; ++i) {
+      INFO("delivery " << i);
+      CHECK((i % 3 ? PN_RELEASED : PN_ACCEPTED) == pn_delivery_remote_state(sent[i]));
+      CHECK(pn_delivery_settled(sent[i]));
+      pn_delivery_settle(sent[i]);
+    }
+    d.run();
+  }
+}
+
+/* A delivery left unsettled does not keep the delivery maps as large as the
+   span of ids sent since */
+TEST_CASE("driver_delivery_map_straggler") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_delivery_map_t *outgoing = &pn_link_session(snd)->state.outgoing;
+  pn_delivery_map_t *incoming = &pn_link_session(rcv)->state.incoming;
+  pn_delivery_t *first_sent = NULL, *first_received = NULL;
+  const int rounds = 100, n = 100;
+  for (int round = 0; round < rounds; ++round) {
+    pn_link_flow(rcv, n);
+    d.run();
+    std::vector<pn_delivery_t *> sent;
+    for (int i = 0; i < n; ++i) {
+      std::string tag = std::to_string(round * n + i);
+      sent.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+      CHECK(1 == pn_link_send(snd, "m", 1));
+      CHECK(pn_link_advance(snd));
+    }
+    while (d.run())
+      ;
+    for (int i = 0; i < n; ++i) {
+      pn_delivery_t *dlv = pn_link_current(rcv);
+      REQUIRE(dlv);
+      char c;
+      CHECK(1 == pn_link_recv(rcv, &c, 1));
+      pn_link_advance(rcv);
+      if (!first_received) {
+        first_received = dlv;   /* Left unsettled */
+      } else {
+        pn_delivery_update(dlv, PN_ACCEPTED);
+        pn_delivery_settle(dlv);
+      }
+    }
+    while (d.run())
+      ;
+    for (int i = 0; i < n; ++i) {
+      if (!first_sent) {
+        first_sent = sent[i];
+        continue;
+      }
+      CHECK(pn_delivery_settled(sent[i]));
+      pn_delivery_settle(sent[i]);
+    }
+    d.run();
+  }
+  CHECK(1 == incoming->size);
+  CHECK(1 == outgoing->size);
+  CHECK(incoming->capacity < 1024);
+  CHECK(outgoing->capacity < 1024);
+
+  /* The straggler is still found by id */
+  pn_delivery_update(first_received, PN_REJECTED);
+  pn_delivery_settle(first_received);
+  while (d.run())
+    ;
+  CHECK(PN_REJECTED == pn_delivery_remote_state(first_sent));
+  CHECK(pn_delivery_settled(first_sent));
+  pn_delivery_settle(first_sent);
+  d.run();
+  CHECK(0 == incoming->size);
+  CHECK(0 == outgoing->size);
+}
+
+static int dispositions_sent = 0;
+
+// Count outgoing DISPOSITION frames, traced by name or by descriptor code
+static void count_dispositions(pn_transport_t *, const char *message) {
+  if (strstr(message, "-> @disposition") || strstr(message, "-> @21,"))
+    ++dispositions_sent;
+}
+
+// Settlements made between two runs go out as the fewest ranged dispositions
+TEST_CASE("driver_disposition_batch") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+  pn_transport_trace(d.server.transport, PN_TRACE_FRM);
+  pn_transport_set_tracer(d.server.transport, count_dispositions);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  const int n = 100;
+  pn_link_flow(rcv, n);
+  d.run();
+  std::vector<pn_delivery_t *> sent, received;
+  for (int i = 0; i < n; ++i) {
+    std::string tag = std::to_string(i);
+    sent.push_back(pn_delivery(snd, pn_bytes(tag.size(), tag.data())));
+    CHECK(1 == pn_link_send(snd, "m", 1));
+    CHECK(pn_link_advance(snd));
+  }
+  while (d.run())
+    ;
+  for (int i = 0; i < n; ++i) {
+    pn_delivery_t *dlv = pn_link_current(rcv);
+    REQUIRE(dlv);
+    received.push_back(dlv);
+    pn_link_advance(rcv);
+  }
+
+  /* The first half settled in a scrambled order, then a gap */
+  dispositions_sent = 0;
+  for (int i = 0; i < n / 2; ++i) {
+    pn_delivery_t *dlv = received[(i * 37) % (n / 2)];
+    pn_delivery_update(dlv, PN_ACCEPTED);
+    pn_delivery_settle(dlv);
+  }
+  pn_delivery_update(received[n / 2 + 1], PN_REJECTED);
+  pn_delivery_settle(received[n / 2 + 1]);
+  while (d.run())
+    ;
+  CHECK(2 == dispositions_sent);
+  CHECK(n / 2 - 1 == pn_link_unsettled(rcv));
+
+  /* Everything left, around the rejected one */
+  dispositions_sent = 0;
+  pn_delivery_settle_upto(received[n - 1], PN_RELEASED);
+  CHECK(0 == pn_link_unsettled(rcv));
+  while (d.run())
+    ;
+  CHECK(2 == dispositions_sent);
+
+  for (int i = 0; i < n; ++i) {
+    INFO("delivery " << i);
+    uint64_t expect = (i < n / 2) ? PN_ACCEPTED : (i == n / 2 + 1) ? PN_REJECTED : PN_RELEASED;
+    CHECK(expect == pn_delivery_remote_state(sent[i]));
+    CHECK(pn_delivery_settled(sent[i]));
+    pn_delivery_settle(sent[i]);
+  }
+  d.run();
+}
+
+/* Output handed out in place stays in place until it is written, it is not
+ * copied into the transport's flat output buffer */
+TEST_CASE("driver_message_write_buffers_in_place") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 1);
+  d.run();
+
+  std::string body(10000, 'x');
+  pn_delivery(snd, pn_bytes("x"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+  CHECK(pn_link_advance(snd));
+
+  d.client.run();
+  pn_bytes_t bufs[4];
+  size_t n = pn_connection_driver_write_buffers(&d.client, bufs, 4);
+  REQUIRE(n > 0);
+  CHECK(NULL == pn_transport_head(d.client.transport));
+  REQUIRE(bufs[0].size > 1);
+
+  /* Write part of the first buffer, the rest is not moved or copied */
+  pn_bytes_t part = pn_bytes(bufs[0].size / 2, bufs[0].start);
+  read_bytes(d.server, part);
+  pn_connection_driver_write_done(&d.client, part.size);
+  CHECK(NULL == pn_transport_head(d.client.transport));
+  pn_bytes_t rest[4];
+  REQUIRE(pn_connection_driver_write_buffers(&d.client, rest, 4) > 0);
+  CHECK(bufs[0].start + part.size == rest[0].start);
+  CHECK(bufs[0].size - part.size == rest[0].size);
+
+  while (gather_read(d.server, d.client))
+    d.client.run();
+  CHECK(PN_DELIVERY == d.server.run());
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  CHECK((size_t)pn_delivery_pending(dlv) == body.size());
+}
+
+namespace {
+std::string buffer_string(pn_buffer_t *buf) {
+  pn_bytes_t segments[2];
+  size_t n = pn_buffer_segments(buf, segments);
+  std::string s;
+  for (size_t i = 0; i < n; ++i) s.append(segments[i].start, segments[i].size);
+  return s;
+}
+} // namespace
+
+/* Output taken from the transport is not touched by frames written later */
+TEST_CASE("driver_message_take_output") {
+  send_client_handler client;
+  delivery_handler server;
+  pn_test::driver_pair d(client, server);
+
+  d.run();
+  pn_link_t *rcv = server.link;
+  pn_link_t *snd = client.link;
+  pn_link_flow(rcv, 3);
+  d.run();
+
+  std::string body(10000, 'x');
+  pn_delivery(snd, pn_bytes("x"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+  CHECK(pn_link_advance(snd));
+  d.client.run();
+
+  pn_buffer_t *spare = pn_buffer(0);
+  pn_buffer_t *taken = pni_transport_take_output(d.client.transport, spare);
+  REQUIRE(taken);
+  CHECK(taken != spare);
+  std::string first = buffer_string(taken);
+  CHECK(first.size() > body.size());
+  pn_bytes_t bufs[4];
+  CHECK(0 == pn_connection_driver_write_buffers(&d.client, bufs, 4));
+
+  /* Enough frames to grow the transport's buffer */
+  std::string body2(100000, 'y');
+  pn_delivery(snd, pn_bytes("y"));
+  CHECK((ssize_t)body2.size() == pn_link_send(snd, body2.data(), body2.size()));
+  CHECK(pn_link_advance(snd));
+  d.client.run();
+  CHECK(first == buffer_string(taken));
+
+  read_bytes(d.server, pn_bytes(first.size(), first.data()));
+  while (gather_read(d.server, d.client))
+    d.client.run();
+  CHECK(PN_DELIVERY == d.server.run());
+  pn_delivery_t *dlv = server.delivery;
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  std::string received(pn_delivery_pending(dlv), '\0');
+  CHECK((ssize_t)received.size() == pn_link_recv(rcv, &received[0], received.size()));
+  CHECK(body == received);
+  CHECK(pn_link_advance(rcv));
+  d.server.run();
+  dlv = pn_link_current(rcv);
+  REQUIRE(dlv);
+  CHECK(!pn_delivery_partial(dlv));
+  CHECK((size_t)pn_delivery_pending(dlv) == body2.size());
+
+  /* Bad input swaps in the error layers, the taken output stays as it was */
+  pn_buffer_clear(taken);
+  std::swap(spare, taken);
+  pn_delivery(snd, pn_bytes("z"));
+  CHECK((ssize_t)body.size() == pn_link_send(snd, body.data(), body.size()));
+  CHECK(pn_link_advance(snd));
+  d.client.run();
+  taken = pni_transport_take_output(d.client.transport, spare);
+  REQUIRE(taken);
+  first = buffer_string(taken);
+  static const char bad_frame[] = "\x00\x00\x00\x02\x02\x00\x00\x00"; /* Size 2 */
+  read_bytes(d.client, pn_bytes(sizeof(bad_frame) - 1, bad_frame));
+  d.client.run();
+  CHECK(first == buffer_string(taken));
+  CHECK_THAT(*pn_transport_condition(d.client.transport),
+             pn_test::cond_matches("amqp:connection:framing-error"));
+  size_t n;
+  while ((n = pn_connection_driver_write_buffers(&d.client, bufs, 4))) {
+    size_t size = 0;
+    for (size_t i = 0; i < n; ++i) size += bufs[i].size;
+    pn_connection_driver_write_done(&d.client, size);
+  }
+  CHECK(pn_connection_driver_write_closed(&d.client));
+
+  pn_buffer_free(taken); /* The transport has the spare */
+}
+
 // Test aborting a delivery
 TEST_CASE("driver_message_abort") {
   send_client_handler client;
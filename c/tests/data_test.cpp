@@ -22,10 +22,14 @@
 #include "./pn_test.hpp"
 
 #include "core/data.h"
+#include "core/consumers.h"
+#include "core/emitters.h"
 
 #include <proton/codec.h>
 #include <proton/error.h>
 
+#include <string>
+
 using namespace pn_test;
 
 // Make sure we can grow the capacity of a pn_data_t all the way to the max and
@@ -90,3 +94,145 @@ TEST_CASE("data_multiple") {
   pn_data_fill(data, "M", src.get());
   CHECK(":baz" == inspect(data));
 }
+
+namespace {
+std::string encode(pn_data_t *data) {
+  std::string s(pn_data_encoded_size(data), '\0');
+  CHECK((ssize_t)s.size() == pn_data_encode(data, &s[0], s.size()));
+  return s;
+}
+
+// Emit a described list like "DL[I?o?DLCn?o]" with the emitters
+std::string emit(uint64_t descriptor, uint32_t i, bool has_o, uint64_t code,
+                 pn_data_t *state, bool last) {
+  std::string s(2, '\0');
+  size_t size = 0;
+  for (;;) {
+    pni_emitter_t emitter = pni_emitter(pn_rwbytes(s.size(), &s[0]));
+    pni_compound_t top = pni_emitter_top();
+    pni_compound_t described = pni_emit_descriptor(&emitter, &top, descriptor);
+    pni_compound_t list = pni_emit_list(&emitter, &described);
+    pni_emit_uint(&emitter, &list, i);
+    if (has_o) pni_emit_bool(&emitter, &list, false);
+    else pni_emit_null(&emitter, &list);
+    if (code) {
+      pni_compound_t outcome = pni_emit_descriptor(&emitter, &list, code);
+      pni_emit_copy(&emitter, &outcome, state);
+    } else {
+      pni_emit_null(&emitter, &list);
+    }
+    pni_emit_null(&emitter, &list);
+    if (last) pni_emit_bool(&emitter, &list, true);
+    else pni_emit_null(&emitter, &list);
+    pni_emit_end_list(&emitter, &list);
+    size = emitter.position;
+    if (!pni_emitter_overflow(&emitter)) break;
+    s.resize(size);
+  }
+  s.resize(size);
+  return s;
+}
+} // namespace
+
+// The emitters must give exactly the same encoding as pn_data_encode()
+TEST_CASE("data_emitters") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  auto_free<pn_data_t, pn_data_free> state(pn_data(0));
+  pn_data_fill(state, "[IL]", 42, (uint64_t)1 << 40);
+  pn_data_t *states[] = {NULL, state.get()};
+  uint32_t ints[] = {0, 255, 256, 0xFFFFFFFF};
+  uint64_t codes[] = {0, 0x24, 0x12345};
+  for (size_t i = 0; i < sizeof(ints) / sizeof(*ints); ++i) {
+    for (size_t c = 0; c < sizeof(codes) / sizeof(*codes); ++c) {
+      for (size_t st = 0; st < 2; ++st) {
+        for (int flags = 0; flags < 4; ++flags) {
+          bool has_o = flags & 1, last = flags & 2;
+          pn_data_clear(data);
+          pn_data_fill(data, "DL[I?o?DLCn?o]", (uint64_t)0x14, ints[i], has_o,
+                       false, (bool)codes[c], codes[c], states[st], last,
+                       true);
+          INFO("data: " << inspect(data));
+          CHECK(encode(data) ==
+                emit(0x14, ints[i], has_o, codes[c], states[st], last));
+        }
+      }
+    }
+  }
+
+  /* Empty described list */
+  pn_data_clear(data);
+  pn_data_fill(data, "DL[]", (uint64_t)0x1000);
+  std::string s(16, '\0');
+  pni_emitter_t emitter = pni_emitter(pn_rwbytes(s.size(), &s[0]));
+  pni_compound_t top = pni_emitter_top();
+  pni_compound_t described = pni_emit_descriptor(&emitter, &top, 0x1000);
+  pni_compound_t list = pni_emit_list(&emitter, &described);
+  pni_emit_null(&emitter, &list);
+  pni_emit_end_list(&emitter, &list);
+  s.resize(emitter.position);
+  CHECK(encode(data) == s);
+}
+
+// The consumers must read what pn_data_encode() writes, like pn_data_scan()
+TEST_CASE("data_consumers") {
+  auto_free<pn_data_t, pn_data_free> data(pn_data(0));
+  pn_data_fill(data, "DL[IIn?ozDL[L]Io]", (uint64_t)0x14, 7, 0x12345, true,
+               false, 3, "tag", (uint64_t)0x24, (uint64_t)1 << 40, 42, true);
+  std::string s = encode(data);
+
+  pni_consumer_t consumer = pni_consumer(pn_bytes(s.size(), s.data()));
+  uint64_t descriptor = 0;
+  pn_bytes_t value;
+  REQUIRE(pni_consume_described(&consumer, &descriptor, &value));
+  CHECK(descriptor == 0x14);
+  CHECK(consumer.position == s.size());
+  pni_consumer_t performative = pni_consumer(value);
+  pni_consumer_t fields;
+  REQUIRE(pni_consume_list(&performative, &fields));
+  uint32_t u = 0;
+  bool b = true;
+  pn_bytes_t tag = pn_bytes(0, NULL);
+  CHECK(pni_consume_uint(&fields, &u));
+  CHECK(u == 7);
+  CHECK(pni_consume_uint(&fields, &u));
+  CHECK(u == 0x12345);
+  CHECK(!pni_consume_uint(&fields, &u)); /* null */
+  CHECK(pni_consume_bool(&fields, &b));
+  CHECK(!b);
+  CHECK(pni_consume_binary(&fields, &tag));
+  CHECK(std::string(tag.start, tag.size) == "tag");
+  CHECK(pni_consume_described(&fields, &descriptor, &value));
+  CHECK(descriptor == 0x24);
+  CHECK(!pni_consume_bool(&fields, &b)); /* wrong type, skipped */
+  CHECK(pni_consume_bool(&fields, &b));
+  CHECK(b);
+  CHECK(!pni_consume_uint(&fields, &u)); /* past the end */
+  CHECK(pni_consumer_ok(&fields));
+
+  /* list8 and the compact uint encodings */
+  const char list8[] = {'\xc0', 5, 3, '\x43', '\x52', 9, '\x41'};
+  consumer = pni_consumer(pn_bytes(sizeof(list8), list8));
+  REQUIRE(pni_consume_list(&consumer, &fields));
+  CHECK(pni_consume_uint(&fields, &u));
+  CHECK(u == 0);
+  CHECK(pni_consume_uint(&fields, &u));
+  CHECK(u == 9);
+  CHECK(pni_consume_bool(&fields, &b));
+  CHECK(b);
+  CHECK(pni_consumer_ok(&fields));
+
+  /* Truncated input fails, never reads past the end */
+  for (size_t n = 0; n < s.size(); ++n) {
+    std::string t = s.substr(0, n);
+    INFO("truncated to " << n);
+    consumer = pni_consumer(pn_bytes(t.size(), t.data()));
+    if (pni_consume_described(&consumer, &descriptor, &value)) {
+      performative = pni_consumer(value);
+      if (pni_consume_list(&performative, &fields)) {
+        while (pni_consumer_ok(&fields) && fields.count)
+          pni_consume_skip(&fields);
+      }
+    }
+    CHECK(!pni_consumer_ok(&consumer));
+  }
+}
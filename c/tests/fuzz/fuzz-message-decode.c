@@ -20,6 +20,7 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
 
 #include "proton/message.h"
 
@@ -35,6 +36,12 @@ int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
   if (ret == 0) {
     // FUTURE: do something like encode msg and compare again with Data
   }
+  /* The same input decoded on demand, encoding forces every section */
+  if (pn_message_decode_lazy(msg, (const char *)Data, Size) == 0) {
+    pn_rwbytes_t buf = {0};
+    pn_message_encode2(msg, &buf);
+    free(buf.start);
+  }
   if (msg != NULL) {
     pn_message_free(msg);
   }
@@ -24,6 +24,9 @@
 #include <proton/error.h>
 #include <proton/message.h>
 #include <stdarg.h>
+#include <string.h>
+
+#include <string>
 
 using namespace pn_test;
 
@@ -82,3 +85,107 @@ TEST_CASE("message_inferred") {
   pn_message_free(src);
   pn_message_free(dst);
 }
+
+static pn_message_t *full_message() {
+  pn_message_t *m = pn_message();
+  pn_message_set_durable(m, true);
+  pn_message_set_ttl(m, 1000);
+  pn_message_set_address(m, "to");
+  pn_message_set_subject(m, "subject");
+  pn_message_set_group_id(m, "group");
+  pn_data_put_map(pn_message_instructions(m));
+  pn_data_enter(pn_message_instructions(m));
+  pn_data_put_symbol(pn_message_instructions(m), pn_bytes("x-opt-i"));
+  pn_data_put_int(pn_message_instructions(m), 1);
+  pn_data_put_map(pn_message_annotations(m));
+  pn_data_enter(pn_message_annotations(m));
+  pn_data_put_symbol(pn_message_annotations(m), pn_bytes("x-opt-a"));
+  pn_data_put_int(pn_message_annotations(m), 2);
+  pn_data_put_map(pn_message_properties(m));
+  pn_data_enter(pn_message_properties(m));
+  pn_data_put_string(pn_message_properties(m), pn_bytes("key"));
+  pn_data_put_string(pn_message_properties(m), pn_bytes("value"));
+  pn_data_put_binary(pn_message_body(m), pn_bytes("hello"));
+  pn_message_set_inferred(m, true);
+  return m;
+}
+
+TEST_CASE("message_decode_lazy") {
+  pn_message_t *src = full_message();
+  pn_rwbytes_t buf = {0};
+  ssize_t size = pn_message_encode2(src, &buf);
+  REQUIRE(size > 0);
+
+  pn_message_t *eager = pn_message();
+  pn_message_t *lazy = pn_message();
+  REQUIRE(0 == pn_message_decode(eager, buf.start, size));
+
+  /* Same content however the sections are decoded */
+  REQUIRE(0 == pn_message_decode_lazy(lazy, buf.start, size));
+  memset(buf.start, 0, size); /* The lazy message keeps its own copy */
+  CHECK(inspect(eager) == inspect(lazy));
+
+  /* Fields of one section only */
+  REQUIRE(size == pn_message_encode2(eager, &buf));
+  REQUIRE(0 == pn_message_decode_lazy(lazy, buf.start, size));
+  CHECK(std::string("to") == pn_message_get_address(lazy));
+  CHECK(inspect(pn_message_properties(lazy)) == "{\"key\"=\"value\"}");
+  CHECK(pn_message_is_durable(lazy));
+  CHECK(pn_message_is_inferred(lazy));
+
+  /* Changes before a section is decoded are not lost */
+  REQUIRE(0 == pn_message_decode_lazy(lazy, buf.start, size));
+  pn_message_set_subject(lazy, "changed");
+  pn_message_set_inferred(lazy, false);
+  CHECK(std::string("changed") == pn_message_get_subject(lazy));
+  CHECK(std::string("group") == pn_message_get_group_id(lazy));
+  CHECK(!pn_message_is_inferred(lazy));
+  CHECK(inspect(pn_message_body(lazy)) == "b\"hello\"");
+
+  /* Encoding the lazy message gives the same bytes */
+  REQUIRE(0 == pn_message_decode_lazy(lazy, buf.start, size));
+  pn_rwbytes_t buf2 = {0};
+  REQUIRE(size == pn_message_encode2(lazy, &buf2));
+  CHECK(std::string(buf.start, size) == std::string(buf2.start, size));
+  free(buf2.start);
+
+  /* Truncated sections are found up front */
+  CHECK(0 != pn_message_decode_lazy(lazy, buf.start, size - 1));
+
+  free(buf.start);
+  pn_message_free(src);
+  pn_message_free(eager);
+  pn_message_free(lazy);
+}
+
+TEST_CASE("message_decode_lazy_passthrough") {
+  /* Properties as a list8, which pn_message_encode() never writes */
+  const std::string properties("\x00\x53\x73\xc0\x06\x03\x40\x40\xa1\x01\x61", 11);
+  const std::string body("\x00\x53\x77\xa1\x02hi", 7);
+  const std::string header("\x00\x53\x70\x45", 4); /* Default header */
+  std::string in = properties + body;
+
+  pn_message_t *m = pn_message();
+  REQUIRE(0 == pn_message_decode_lazy(m, in.data(), in.size()));
+
+  /* Unused sections are copied as they are */
+  char out[64];
+  size_t size = sizeof(out);
+  REQUIRE(0 == pn_message_encode(m, out, &size));
+  CHECK(header + in == std::string(out, size));
+
+  /* Only the section that was used is encoded again */
+  CHECK(std::string("a") == pn_message_get_address(m));
+  size = sizeof(out);
+  REQUIRE(0 == pn_message_encode(m, out, &size));
+  std::string encoded(out, size);
+  CHECK(encoded.size() > header.size() + in.size());
+  CHECK(encoded.substr(encoded.size() - body.size()) == body);
+
+  /* Not enough space */
+  size = header.size() + 1;
+  REQUIRE(0 == pn_message_decode_lazy(m, in.data(), in.size()));
+  CHECK(PN_OVERFLOW == pn_message_encode(m, out, &size));
+
+  pn_message_free(m);
+}
@@ -41,8 +41,9 @@ std::string listening_port(pn_listener_t *l) {
   return port;
 }
 
-proactor::proactor(struct handler *h)
-    : auto_free<pn_proactor_t, pn_proactor_free>(pn_proactor()), handler(h) {}
+proactor::proactor(struct handler *h, size_t shards)
+    : auto_free<pn_proactor_t, pn_proactor_free>(pn_proactor_sharded(shards)),
+      handler(h) {}
 
 bool proactor::dispatch(pn_event_t *e) {
   void *ctx = NULL;
@@ -38,7 +38,7 @@ std::string listening_port(pn_listener_t *l);
 struct proactor : auto_free<pn_proactor_t, pn_proactor_free> {
   struct handler *handler;
 
-  proactor(struct handler *h = 0);
+  proactor(struct handler *h = 0, size_t shards = 1);
 
   // Listen on addr using optional listener handler lh
   pn_listener_t *listen(const std::string &addr = ":0", struct handler *lh = 0);
@@ -20,6 +20,7 @@
 #include "../src/proactor/proactor-internal.h"
 #include "./pn_test_proactor.hpp"
 #include "./test_config.h"
+#include "./thread.h"
 
 #include <proton/condition.h>
 #include <proton/connection.h>
@@ -35,7 +36,9 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 using namespace pn_test;
 using Catch::Matchers::Contains;
@@ -202,6 +205,637 @@ TEST_CASE("proactor_connection_wake") {
   pn_decref(c);
 }
 
+namespace {
+/* Count wakes posted by producer threads and PN_CONNECTION_WAKE events.
+ * Stop when a wake event has seen every posted wake, or on timeout. */
+struct wake_producers_handler : public common_handler {
+  std::vector<pn_connection_t *> connections; /* One per producer */
+  pthread_mutex_t lock;
+  size_t posted, expected, seen, events;
+  size_t per_thread, started;
+
+  wake_producers_handler()
+      : posted(0), expected(0), seen(0), events(0), per_thread(0), started(0) {
+    pthread_mutex_init(&lock, NULL);
+  }
+  ~wake_producers_handler() { pthread_mutex_destroy(&lock); }
+
+  bool handle(pn_event_t *e) CATCH_OVERRIDE {
+    switch (pn_event_type(e)) {
+    case PN_CONNECTION_WAKE:
+      ++events;
+      pthread_mutex_lock(&lock);
+      seen = posted;
+      pthread_mutex_unlock(&lock);
+      return seen == expected;
+    case PN_PROACTOR_TIMEOUT:
+      return true;
+    default:
+      return common_handler::handle(e);
+    }
+  }
+
+  static void *produce(void *arg) {
+    wake_producers_handler *h = static_cast<wake_producers_handler *>(arg);
+    pthread_mutex_lock(&h->lock);
+    pn_connection_t *c = h->connections[h->started++];
+    pthread_mutex_unlock(&h->lock);
+    for (size_t i = 0; i < h->per_thread; ++i) {
+      pthread_mutex_lock(&h->lock);
+      ++h->posted;
+      pthread_mutex_unlock(&h->lock);
+      pn_connection_wake(c);
+    }
+    return NULL;
+  }
+};
+
+/* Each of nthreads threads wakes its own connection n times. Returns the
+ * elapsed milliseconds. */
+pn_millis_t wake_producers(wake_producers_handler &wh, size_t nthreads, size_t n) {
+  common_handler h;
+  proactor p(&h);
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  for (size_t i = 0; i < nthreads; ++i) {
+    wh.connections.push_back(p.connect(l, &wh));
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+  }
+
+  wh.per_thread = n;
+  wh.expected = nthreads * n;
+  pn_proactor_set_timeout(p, 60000); /* Fail rather than hang on a lost wake */
+  pn_millis_t start = pn_proactor_now();
+  std::vector<pthread_t> threads(nthreads);
+  for (size_t i = 0; i < nthreads; ++i)
+    pthread_create(&threads[i], NULL, &wake_producers_handler::produce, &wh);
+  CHECK(PN_CONNECTION_WAKE == p.run());
+  pn_millis_t elapsed = pn_proactor_now() - start;
+  for (size_t i = 0; i < nthreads; ++i)
+    pthread_join(threads[i], NULL);
+  CHECK(wh.expected == wh.seen);
+  CHECK(wh.events <= wh.expected);
+
+  pn_proactor_cancel_timeout(p);
+  pn_proactor_disconnect(p, NULL);
+  for (pn_event_type_t et = p.run(); et != PN_PROACTOR_INACTIVE; et = p.run()) {
+    /* A proactor may deliver a wake posted while the last one was handled */
+    if (et == PN_TRANSPORT_ERROR || et == PN_CONNECTION_WAKE) continue;
+    CHECK(et == PN_LISTENER_CLOSE);
+  }
+  return elapsed;
+}
+} // namespace
+
+/* Many threads waking connections at once: no wake is lost */
+TEST_CASE("proactor_wake_producers") {
+  wake_producers_handler wh;
+  wake_producers(wh, 8, 1000);
+}
+
+/* Wake throughput from many threads, run explicitly with "[benchmark]" */
+TEST_CASE("proactor_wake_benchmark", "[!hide][benchmark]") {
+  const size_t nthreads = 8, n = 200000;
+  wake_producers_handler wh;
+  pn_millis_t ms = wake_producers(wh, nthreads, n);
+  std::cout << "proactor_wake_benchmark: " << nthreads << " threads, "
+            << nthreads * n << " wakes, " << wh.events << " wake events in "
+            << ms << "ms, " << (nthreads * n * 1000.0 / (ms ? ms : 1))
+            << " wakes/s" << std::endl;
+}
+
+namespace {
+/* Threads that each call pn_connection_wake() and pn_connection_proactor()
+ * on their own connection in a loop, n times or until stopped. */
+struct connection_callers {
+  std::vector<pn_connection_t *> connections;
+  std::vector<pthread_t> threads;
+  pn_proactor_t *proactor;
+  pthread_mutex_t lock;
+  size_t started, n, wrong;
+  bool wake, stop;
+
+  connection_callers(pn_proactor_t *p, size_t n_, bool wake_)
+      : proactor(p), started(0), n(n_), wrong(0), wake(wake_), stop(false) {
+    pthread_mutex_init(&lock, NULL);
+  }
+  ~connection_callers() { pthread_mutex_destroy(&lock); }
+
+  void start() {
+    threads.resize(connections.size());
+    for (size_t i = 0; i < threads.size(); ++i)
+      pthread_create(&threads[i], NULL, &connection_callers::run, this);
+  }
+
+  void join() {
+    pthread_mutex_lock(&lock);
+    stop = true;
+    pthread_mutex_unlock(&lock);
+    for (size_t i = 0; i < threads.size(); ++i)
+      pthread_join(threads[i], NULL);
+  }
+
+  static void *run(void *arg) {
+    connection_callers *cc = static_cast<connection_callers *>(arg);
+    pthread_mutex_lock(&cc->lock);
+    pn_connection_t *c = cc->connections[cc->started++];
+    pthread_mutex_unlock(&cc->lock);
+    size_t wrong = 0;
+    for (size_t i = 0; i < cc->n; ++i) {
+      if (cc->wake) pn_connection_wake(c);
+      pn_proactor_t *p = pn_connection_proactor(c);
+      if (p && p != cc->proactor) ++wrong;
+      if (i % 1000 == 0) {
+        pthread_mutex_lock(&cc->lock);
+        bool stop = cc->stop;
+        pthread_mutex_unlock(&cc->lock);
+        if (stop) break;
+      }
+    }
+    pthread_mutex_lock(&cc->lock);
+    cc->wrong += wrong;
+    pthread_mutex_unlock(&cc->lock);
+    return NULL;
+  }
+};
+} // namespace
+
+/* Wake and look up connections from other threads while they are closed and
+ * freed by the proactor */
+TEST_CASE("proactor_wake_close") {
+  common_handler h;
+  proactor p(&h);
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  connection_callers cc(p, size_t(-1), true);
+  for (size_t i = 0; i < 4; ++i) {
+    pn_connection_t *c = p.connect(l);
+    pn_incref(c); /* Keep a reference for wake() after free */
+    cc.connections.push_back(c);
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+  }
+  cc.start();
+  pn_proactor_disconnect(p, NULL);
+  for (pn_event_type_t et = p.run(); et != PN_PROACTOR_INACTIVE; et = p.run()) {
+    if (et == PN_TRANSPORT_ERROR) continue;
+    CHECK(et == PN_LISTENER_CLOSE);
+  }
+  cc.join();
+  CHECK(0 == cc.wrong);
+  for (size_t i = 0; i < cc.connections.size(); ++i) {
+    CHECK(pn_connection_proactor(cc.connections[i]) == NULL);
+    pn_decref(cc.connections[i]);
+  }
+}
+
+/* pn_connection_proactor() from many threads, run explicitly with "[benchmark]" */
+TEST_CASE("proactor_connection_proactor_benchmark", "[!hide][benchmark]") {
+  const size_t nthreads = 8, n = 2000000;
+  common_handler h;
+  proactor p(&h);
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  connection_callers cc(p, n, false);
+  for (size_t i = 0; i < nthreads; ++i) {
+    cc.connections.push_back(p.connect(l));
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+  }
+  pn_millis_t start = pn_proactor_now();
+  cc.start();
+  for (size_t i = 0; i < cc.threads.size(); ++i)
+    pthread_join(cc.threads[i], NULL);
+  pn_millis_t ms = pn_proactor_now() - start;
+  CHECK(0 == cc.wrong);
+  std::cout << "proactor_connection_proactor_benchmark: " << nthreads
+            << " threads, " << nthreads * n << " calls in " << ms << "ms, "
+            << (nthreads * n * 1000.0 / (ms ? ms : 1)) << " calls/s"
+            << std::endl;
+  pn_proactor_disconnect(p, NULL);
+  for (pn_event_type_t et = p.run(); et != PN_PROACTOR_INACTIVE; et = p.run()) {
+    if (et == PN_TRANSPORT_ERROR) continue;
+    CHECK(et == PN_LISTENER_CLOSE);
+  }
+}
+
+namespace {
+/* Set a short idle timeout on every connection, stop on proactor timeout */
+struct idle_timeout_handler : public common_handler {
+  std::vector<pn_transport_t *> transports;
+
+  bool handle(pn_event_t *e) CATCH_OVERRIDE {
+    switch (pn_event_type(e)) {
+    case PN_CONNECTION_BOUND:
+      pn_transport_set_idle_timeout(pn_event_transport(e), 100);
+      transports.push_back(pn_event_transport(e));
+      return false;
+    case PN_PROACTOR_TIMEOUT:
+      return true;
+    default:
+      return common_handler::handle(e);
+    }
+  }
+};
+} // namespace
+
+// Connections with idle timeouts share their shard's timer, check that each
+// one keeps sending heartbeats so none of them times out.
+static void run_idle_timeout(size_t shards) {
+  idle_timeout_handler h;
+  proactor p(&h, shards);
+  pn_listener_t *l = p.listen(":0", &h);
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  const size_t n = 4;
+  for (size_t i = 0; i < n; ++i) {
+    p.connect(l);
+  }
+  pn_proactor_set_timeout(p, 1000);
+  REQUIRE_RUN(p, PN_PROACTOR_TIMEOUT);
+  REQUIRE(2 * n == h.transports.size());
+  for (size_t i = 0; i < h.transports.size(); ++i) {
+    INFO("transport " << i);
+    CHECK(!pn_condition_is_set(pn_transport_condition(h.transports[i])));
+    /* Open frame and at least one heartbeat every 50ms */
+    CHECK(pn_transport_get_frames_output(h.transports[i]) > 10);
+  }
+  pn_proactor_disconnect(p, NULL);
+  for (pn_event_type_t et = p.run(); et != PN_PROACTOR_INACTIVE; et = p.run()) {
+    if (et == PN_TRANSPORT_ERROR) continue;
+    CHECK(et == PN_LISTENER_CLOSE);
+  }
+}
+
+TEST_CASE("proactor_idle_timeout") {
+  run_idle_timeout(1);
+  /* Connections on several shards, each with its own timer */
+  run_idle_timeout(3);
+}
+
+namespace {
+/* Threads of a sharded proactor, each blocks on its own home shard until
+   interrupted */
+struct sharded_workers {
+  pn_proactor_t *proactor;
+  pthread_mutex_t lock;
+  size_t started, opened, closed;
+  std::vector<size_t> batches; /* Event batches processed by each thread */
+
+  sharded_workers(pn_proactor_t *p, size_t threads)
+      : proactor(p), started(0), opened(0), closed(0), batches(threads) {
+    pthread_mutex_init(&lock, NULL);
+  }
+  ~sharded_workers() { pthread_mutex_destroy(&lock); }
+
+  size_t get(size_t sharded_workers::*n) {
+    pthread_mutex_lock(&lock);
+    size_t v = this->*n;
+    pthread_mutex_unlock(&lock);
+    return v;
+  }
+
+  void handle(pn_event_t *e) {
+    pn_connection_t *c = pn_event_connection(e);
+    switch (pn_event_type(e)) {
+    case PN_LISTENER_OPEN:
+      pthread_mutex_lock(&lock);
+      ++opened;
+      pthread_mutex_unlock(&lock);
+      break;
+    case PN_LISTENER_ACCEPT:
+      pn_listener_accept2(pn_event_listener(e), NULL, NULL);
+      break;
+    case PN_CONNECTION_REMOTE_OPEN: /* Server opens, client closes */
+      if (pn_connection_state(c) & PN_LOCAL_UNINIT)
+        pn_connection_open(c);
+      else
+        pn_connection_close(c);
+      break;
+    case PN_CONNECTION_REMOTE_CLOSE:
+      pn_connection_close(c);
+      break;
+    case PN_TRANSPORT_CLOSED:
+      pthread_mutex_lock(&lock);
+      ++closed;
+      pthread_mutex_unlock(&lock);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void run(size_t i) {
+    pthread_mutex_lock(&lock);
+    ++started;
+    pthread_mutex_unlock(&lock);
+    while (true) {
+      pn_event_batch_t *eb = pn_proactor_wait(proactor);
+      bool stop = false;
+      for (pn_event_t *e = pn_event_batch_next(eb); e; e = pn_event_batch_next(eb)) {
+        if (pn_event_type(e) == PN_PROACTOR_INTERRUPT)
+          stop = true;
+        else
+          handle(e);
+      }
+      pn_proactor_done(proactor, eb);
+      if (stop) { /* Pass the interrupt on to the next thread */
+        pn_proactor_interrupt(proactor);
+        return;
+      }
+      ++batches[i];
+    }
+  }
+
+  struct arg {
+    sharded_workers *w;
+    size_t i;
+  };
+  static void *start(void *a) {
+    static_cast<arg *>(a)->w->run(static_cast<arg *>(a)->i);
+    return NULL;
+  }
+};
+} // namespace
+
+/* Run connections through a sharded proactor with a number of threads,
+   optionally listening with SO_REUSEPORT sockets */
+static void run_sharded(size_t shards, size_t nthreads, size_t reuseport = 0) {
+  const size_t n = 6;
+  pn_proactor_t *p = pn_proactor_sharded(shards);
+  REQUIRE(p);
+  sharded_workers w(p, nthreads);
+  std::vector<pthread_t> threads(nthreads);
+  std::vector<sharded_workers::arg> args(nthreads);
+  for (size_t i = 0; i < nthreads; ++i) {
+    args[i].w = &w;
+    args[i].i = i;
+    pthread_create(&threads[i], NULL, &sharded_workers::start, &args[i]);
+  }
+  /* All threads are blocked on their home shard before there is any work */
+  while (w.get(&sharded_workers::started) < nthreads) millisleep(1);
+  millisleep(10);
+
+  pn_listener_t *l = pn_listener();
+  pn_listener_set_reuseport(l, reuseport);
+  pn_proactor_listen(p, l, "127.0.0.1:0", 16);
+  while (w.get(&sharded_workers::opened) == 0) millisleep(1);
+  std::string addr = "127.0.0.1:" + listening_port(l);
+  for (size_t i = 0; i < n; ++i)
+    pn_proactor_connect2(p, NULL, NULL, addr.c_str());
+
+  for (int ms = 0; w.get(&sharded_workers::closed) < 2 * n && ms < 10000; ++ms)
+    millisleep(1);
+  CHECK(2 * n == w.get(&sharded_workers::closed));
+
+  pn_proactor_interrupt(p);
+  for (size_t i = 0; i < nthreads; ++i) {
+    pthread_join(threads[i], NULL);
+#ifdef PN_TEST_EPOLL
+    INFO("thread " << i);
+    CHECK(w.batches[i] > 0); /* Every shard has connections */
+#endif
+  }
+  pn_proactor_free(p);
+}
+
+/* pn_proactor_get() does not give a thread a shard of its own: a thread that
+   stops polling must not leave a shard without a thread */
+static void *get_once(void *p) {
+  pn_event_batch_t *eb = pn_proactor_get(static_cast<pn_proactor_t *>(p));
+  if (eb) pn_proactor_done(static_cast<pn_proactor_t *>(p), eb);
+  return NULL;
+}
+
+TEST_CASE("proactor_sharded") {
+  /* One thread per shard */
+  run_sharded(3, 3);
+  /* Shards without a thread are served by the first shard's thread */
+  run_sharded(3, 1);
+}
+
+TEST_CASE("proactor_sharded_get") {
+  common_handler h;
+  proactor p(&h, 2);
+  pthread_t t;
+  pthread_create(&t, NULL, &get_once, (pn_proactor_t *)p);
+  pthread_join(t, NULL);
+  /* The connection's sockets are on both shards, a single thread gets all the
+     events */
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  p.connect(l);
+  REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+  REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+}
+
+TEST_CASE("proactor_stats") {
+  common_handler h;
+  proactor p(&h);
+  pn_proactor_stats_enable(p, true);
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  pn_connection_t *c = p.connect(l);
+  REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+  REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+
+  pn_proactor_stats_t cs, ps;
+  if (!pn_connection_stats(c, &cs)) { /* Not supported by this proactor */
+    CHECK(!pn_proactor_stats(p, &ps));
+    return;
+  }
+  pn_connection_wake(c);
+  REQUIRE_RUN(p, PN_CONNECTION_WAKE);
+  REQUIRE(pn_connection_stats(c, &cs));
+  CHECK(cs.read_ns > 0);
+  CHECK(cs.process_ns > 0);
+  CHECK(cs.write_ns > 0);
+  CHECK(cs.wakeups > 0);
+  CHECK(cs.rearms > 0);
+  CHECK(cs.wakes == 1);
+  CHECK(cs.wake_delay_ns > 0);
+  CHECK(cs.wake_delay_max_ns == cs.wake_delay_ns);
+
+  REQUIRE(pn_proactor_stats(p, &ps));
+  CHECK(ps.read_ns > cs.read_ns); /* Both ends of the connection */
+  CHECK(ps.wakeups > 0); /* Poll returns, not the sum of the connections' */
+  CHECK(ps.wakes == 1);
+
+  /* The totals keep the counters of freed connections */
+  pn_proactor_disconnect(p, NULL);
+  while (p.run() != PN_PROACTOR_INACTIVE) {
+  }
+  pn_proactor_stats_t after;
+  REQUIRE(pn_proactor_stats(p, &after));
+  CHECK(after.read_ns >= ps.read_ns);
+  CHECK(after.rearms >= ps.rearms);
+  CHECK(after.wakeups >= ps.wakeups);
+  CHECK(after.wakes == 1);
+}
+
+TEST_CASE("proactor_reuseport") {
+  common_handler h;
+  proactor p(&h);
+  pn_listener_t *l = pn_listener();
+  pn_listener_set_reuseport(l, 4);
+  pn_proactor_listen(p, l, "127.0.0.1:0", 16);
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+  CHECK(!pn_netaddr_next(pn_listener_addr(l))); /* Copies are not listed */
+  const int n = 8;
+  for (int i = 0; i < n; ++i)
+    p.connect(l);
+  for (int i = 0; i < 2 * n; ++i)
+    REQUIRE_RUN(p, PN_CONNECTION_REMOTE_OPEN);
+
+  /* Sockets spread over the shards, one thread per shard */
+  run_sharded(3, 3, 3);
+}
+
+namespace {
+/* Client sends one message at a time, the round trip ends when the server
+   settles it. Events are handled by threads blocking in pn_proactor_wait() */
+struct ping_pong {
+  pn_proactor_t *proactor;
+  pthread_mutex_t lock;
+  size_t n, sent;
+  bool opened, done;
+  Catch::Timer timer;
+  std::vector<unsigned> latency; /* Microseconds per round trip */
+
+  ping_pong(pn_proactor_t *p, size_t count)
+      : proactor(p), n(count), sent(0), opened(false), done(false) {
+    pthread_mutex_init(&lock, NULL);
+    latency.reserve(n);
+  }
+  ~ping_pong() { pthread_mutex_destroy(&lock); }
+
+  bool get(bool ping_pong::*b) {
+    pthread_mutex_lock(&lock);
+    bool v = this->*b;
+    pthread_mutex_unlock(&lock);
+    return v;
+  }
+
+  void send(pn_link_t *s) {
+    ++sent;
+    pn_delivery(s, pn_dtag((const char *)&sent, sizeof(sent)));
+    timer.start();
+    pn_link_send(s, "x", 1);
+    pn_link_advance(s);
+  }
+
+  void handle(pn_event_t *e) {
+    pn_link_t *l = pn_event_link(e);
+    pn_delivery_t *d = pn_event_delivery(e);
+    switch (pn_event_type(e)) {
+    case PN_LISTENER_OPEN:
+      pthread_mutex_lock(&lock);
+      opened = true;
+      pthread_mutex_unlock(&lock);
+      break;
+    case PN_LISTENER_ACCEPT:
+      pn_listener_accept2(pn_event_listener(e), NULL, NULL);
+      break;
+    case PN_CONNECTION_REMOTE_OPEN:
+      if (pn_connection_state(pn_event_connection(e)) & PN_LOCAL_UNINIT)
+        pn_connection_open(pn_event_connection(e));
+      break;
+    case PN_SESSION_REMOTE_OPEN:
+      if (pn_session_state(pn_event_session(e)) & PN_LOCAL_UNINIT)
+        pn_session_open(pn_event_session(e));
+      break;
+    case PN_LINK_REMOTE_OPEN:
+      if (pn_link_state(l) & PN_LOCAL_UNINIT) {
+        pn_link_open(l);
+        pn_link_flow(l, 1);
+      }
+      break;
+    case PN_LINK_FLOW:
+      if (pn_link_is_sender(l) && sent == 0 && pn_link_credit(l) > 0) send(l);
+      break;
+    case PN_DELIVERY:
+      if (pn_link_is_receiver(l)) {
+        char buf[16];
+        pn_link_recv(l, buf, sizeof(buf));
+        pn_link_advance(l);
+        pn_delivery_update(d, PN_ACCEPTED);
+        pn_delivery_settle(d);
+        pn_link_flow(l, 1);
+      } else if (pn_delivery_remote_state(d) == PN_ACCEPTED) {
+        latency.push_back(timer.getElapsedMicroseconds());
+        pn_delivery_settle(d);
+        if (sent < n) {
+          send(l);
+        } else {
+          pthread_mutex_lock(&lock);
+          done = true;
+          pthread_mutex_unlock(&lock);
+        }
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  static void *run(void *arg) {
+    ping_pong *pp = static_cast<ping_pong *>(arg);
+    while (true) {
+      pn_event_batch_t *eb = pn_proactor_wait(pp->proactor);
+      bool stop = false;
+      for (pn_event_t *e = pn_event_batch_next(eb); e; e = pn_event_batch_next(eb)) {
+        if (pn_event_type(e) == PN_PROACTOR_INTERRUPT) stop = true;
+        pp->handle(e);
+      }
+      pn_proactor_done(pp->proactor, eb);
+      if (stop) { /* Interrupts may be coalesced, pass it on to the next thread */
+        pn_proactor_interrupt(pp->proactor);
+        return NULL;
+      }
+    }
+  }
+};
+
+void ping_pong_latency(uint32_t busy_poll_usec) {
+  const size_t n = 20000, nthreads = 2;
+  pn_proactor_t *p = pn_proactor();
+  pn_proactor_set_busy_poll(p, busy_poll_usec);
+  ping_pong pp(p, n);
+  std::vector<pthread_t> threads(nthreads);
+  for (size_t i = 0; i < nthreads; ++i)
+    pthread_create(&threads[i], NULL, &ping_pong::run, &pp);
+
+  pn_listener_t *l = pn_listener();
+  pn_proactor_listen(p, l, "127.0.0.1:0", 16);
+  while (!pp.get(&ping_pong::opened)) millisleep(1);
+  std::string addr = "127.0.0.1:" + listening_port(l);
+  pn_connection_t *c = pn_connection();
+  pn_session_t *ssn = pn_session(c);
+  pn_link_t *s = pn_sender(ssn, "ping");
+  pn_connection_open(c);
+  pn_session_open(ssn);
+  pn_link_open(s);
+  pn_proactor_connect2(p, c, NULL, addr.c_str());
+
+  while (!pp.get(&ping_pong::done)) millisleep(10);
+  pn_proactor_interrupt(p);
+  for (size_t i = 0; i < nthreads; ++i) pthread_join(threads[i], NULL);
+  pn_proactor_free(p);
+
+  std::vector<unsigned> &v = pp.latency;
+  std::sort(v.begin(), v.end());
+  std::cout << "busy poll " << busy_poll_usec << "us: " << v.size()
+            << " round trips, latency p50 " << v[v.size() / 2] << "us p99 "
+            << v[v.size() * 99 / 100] << "us p999 " << v[v.size() * 999 / 1000]
+            << "us" << std::endl;
+}
+} // namespace
+
+TEST_CASE("proactor_ping_pong_benchmark", "[!hide][benchmark]") {
+  ping_pong_latency(0);
+  ping_pong_latency(50);
+}
+
 namespace {
 struct abort_handler : public common_handler {
   bool handle(pn_event_t *e) {
@@ -829,3 +1463,224 @@ TEST_CASE("proactor_message_stream") {
   free(h.send_buf.start);
   free(h.recv_buf.start);
 }
+
+struct bulk_handler : public common_handler {
+  pn_rwbytes_t send_buf, recv_buf;
+  ssize_t size, received;
+  bool sent, complete;
+
+  bulk_handler()
+      : send_buf(), recv_buf(), size(), received(), sent(), complete() {}
+
+  bool handle(pn_event_t *e) {
+    switch (pn_event_type(e)) {
+    case PN_LINK_REMOTE_OPEN:
+      common_handler::handle(e);
+      if (pn_link_is_receiver(pn_event_link(e))) {
+        pn_link_flow(pn_event_link(e), 1);
+      }
+      return false;
+
+    case PN_LINK_FLOW: { /* Send the whole message at once */
+      pn_link_t *l = pn_event_link(e);
+      if (pn_link_is_sender(l) && !sent) {
+        pn_delivery(l, pn_dtag("x", 1));
+        CHECK(size == pn_link_send(l, send_buf.start, size));
+        CHECK(pn_link_advance(l));
+        sent = true;
+      }
+      return false;
+    }
+
+    case PN_DELIVERY: {
+      pn_delivery_t *dlv = pn_event_delivery(e);
+      if (pn_link_is_receiver(pn_event_link(e)) && pn_delivery_readable(dlv)) {
+        ssize_t n = pn_delivery_pending(dlv);
+        rwbytes_ensure(&recv_buf, received + n);
+        REQUIRE(n ==
+                pn_link_recv(pn_event_link(e), recv_buf.start + received, n));
+        received += n;
+        complete = !pn_delivery_partial(dlv);
+      }
+      return false;
+    }
+    default:
+      return common_handler::handle(e);
+    }
+  }
+};
+
+/* Test a multi-megabyte message written with MSG_ZEROCOPY, where supported */
+TEST_CASE("proactor_zerocopy") {
+  bulk_handler h;
+  proactor p(&h);
+  pn_proactor_set_zerocopy_threshold(p, 4096);
+
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+
+  std::string body(4 * 1024 * 1024, '\0');
+  for (size_t i = 0; i < body.size(); ++i) body[i] = char(i * 7 + i / 4096);
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_data_put_binary(pn_message_body(m), pn_bytes(body));
+  h.size = pn_message_encode2(m, &h.send_buf);
+
+  pn_connection_t *c = p.connect(l);
+  pn_session_t *ssn = pn_session(c);
+  pn_session_open(ssn);
+  pn_link_open(pn_sender(ssn, "x"));
+  do {
+    REQUIRE_RUN(p, PN_DELIVERY);
+  } while (!h.complete);
+  CHECK(h.received == h.size);
+  CHECK(!memcmp(h.send_buf.start, h.recv_buf.start, h.size));
+
+  free(h.send_buf.start);
+  free(h.recv_buf.start);
+}
+
+/* Sends the message again and closes the connection as soon as the receiver
+   sees the first part, so the sender's transport writes frames while the first
+   send may still be in progress */
+struct send_again_handler : public bulk_handler {
+  bool flowed, again;
+
+  send_again_handler() : flowed(), again() {}
+
+  bool handle(pn_event_t *e) {
+    switch (pn_event_type(e)) {
+    case PN_DELIVERY: {
+      pn_link_t *l = pn_event_link(e);
+      if (!pn_link_is_receiver(l)) return false;
+      if (!flowed) {
+        pn_link_flow(l, 1);
+        flowed = true;
+      }
+      bulk_handler::handle(e);
+      pn_delivery_t *dlv = pn_event_delivery(e);
+      if (dlv == pn_link_current(l) && !pn_delivery_partial(dlv)) pn_link_advance(l);
+      return false;
+    }
+
+    case PN_LINK_FLOW: {
+      pn_link_t *l = pn_event_link(e);
+      if (pn_link_is_sender(l) && sent && !again && pn_link_credit(l) > 0) {
+        pn_delivery(l, pn_dtag("y", 1));
+        CHECK(size == pn_link_send(l, send_buf.start, size));
+        CHECK(pn_link_advance(l));
+        pn_connection_close(pn_event_connection(e));
+        again = true;
+        return false;
+      }
+      return bulk_handler::handle(e);
+    }
+
+    default:
+      return bulk_handler::handle(e);
+    }
+  }
+};
+
+TEST_CASE("proactor_zerocopy_write_more") {
+  send_again_handler h;
+  proactor p(&h);
+  pn_proactor_set_zerocopy_threshold(p, 4096);
+
+  pn_listener_t *l = p.listen();
+  REQUIRE_RUN(p, PN_LISTENER_OPEN);
+
+  std::string body(16 * 1024 * 1024, '\0'); /* More than a socket takes at once */
+  for (size_t i = 0; i < body.size(); ++i) body[i] = char(i * 7 + i / 4096);
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_data_put_binary(pn_message_body(m), pn_bytes(body));
+  h.size = pn_message_encode2(m, &h.send_buf);
+
+  pn_connection_t *c = p.connect(l);
+  pn_session_t *ssn = pn_session(c);
+  pn_session_open(ssn);
+  pn_link_open(pn_sender(ssn, "x"));
+  while (h.received < 2 * h.size) {
+    REQUIRE_RUN(p, PN_DELIVERY);
+  }
+  CHECK(h.received == 2 * h.size);
+  CHECK(!memcmp(h.send_buf.start, h.recv_buf.start, h.size));
+  CHECK(!memcmp(h.send_buf.start, h.recv_buf.start + h.size, h.size));
+  REQUIRE_RUN(p, PN_TRANSPORT_CLOSED);
+  REQUIRE_RUN(p, PN_TRANSPORT_CLOSED); /* Both ends */
+
+  free(h.send_buf.start);
+  free(h.recv_buf.start);
+}
+
+#ifdef PN_TEST_EPOLL
+/* Receives in small frames, noting the connection's IO notifications at each
+   delivery */
+struct read_budget_handler : public bulk_handler {
+  std::vector<ssize_t> received_at;
+  std::vector<uint64_t> wakeups_at;
+
+  bool handle(pn_event_t *e) {
+    switch (pn_event_type(e)) {
+    case PN_CONNECTION_BOUND: /* Frames, and so the read buffer, stay small */
+      pn_transport_set_max_frame(pn_event_transport(e), 16 * 1024);
+      return false;
+    case PN_DELIVERY: {
+      bool ret = bulk_handler::handle(e);
+      pn_proactor_stats_t cs;
+      REQUIRE(pn_connection_stats(pn_event_connection(e), &cs));
+      received_at.push_back(received);
+      wakeups_at.push_back(cs.wakeups);
+      return ret;
+    }
+    default:
+      return bulk_handler::handle(e);
+    }
+  }
+};
+
+/* A connection with a lot of input reads more than one read buffer in a pass,
+   but no more than READ_MAX, and carries on without waiting to be polled */
+TEST_CASE("proactor_read_budget") {
+  const ssize_t READ_BUF = 16 * 1024, READ_MAX = 256 * 1024;
+  read_budget_handler sh;
+  bulk_handler ch;
+  proactor server(&sh), client(&ch);
+  pn_proactor_stats_enable(server, true);
+  pn_listener_t *l = server.listen();
+  REQUIRE_RUN(server, PN_LISTENER_OPEN);
+
+  auto_free<pn_message_t, pn_message_free> m(pn_message());
+  pn_data_put_binary(pn_message_body(m), pn_bytes(std::string(4 * 1024 * 1024, 'x')));
+  ch.size = pn_message_encode2(m, &ch.send_buf);
+
+  pn_connection_t *c = client.connect(l);
+  pn_session_t *ssn = pn_session(c);
+  pn_session_open(ssn);
+  pn_link_open(pn_sender(ssn, "x"));
+  REQUIRE(PN_LINK_FLOW == client.corun(server, PN_LINK_FLOW)); /* Sends the message */
+  for (int i = 0; i < 100; ++i) { /* Fill the socket buffers */
+    client.flush();
+    millisleep(1);
+  }
+  /* Each pass over the connection's input ends with a delivery event */
+  REQUIRE_RUN(server, PN_DELIVERY);
+  CHECK(sh.received_at[0] > READ_BUF);
+  while (!sh.complete)
+    REQUIRE(PN_DELIVERY == server.corun(client, PN_DELIVERY));
+  CHECK(sh.received == ch.size);
+
+  bool yielded = false;     /* A pass stopped at READ_MAX, the next was not polled */
+  for (size_t i = 1; i < sh.received_at.size(); ++i) {
+    ssize_t n = sh.received_at[i] - sh.received_at[i-1];
+    INFO("pass " << i);
+    CHECK(n <= READ_MAX);
+    if (n > READ_MAX - READ_BUF && i + 1 < sh.received_at.size() &&
+        sh.wakeups_at[i + 1] == sh.wakeups_at[i])
+      yielded = true;
+  }
+  CHECK(yielded);
+
+  free(ch.send_buf.start);
+  free(sh.recv_buf.start);
+}
+#endif
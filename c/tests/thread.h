@@ -62,14 +62,14 @@ typedef CRITICAL_SECTION pthread_mutex_t;
 #define pthread_mutex_lock(m) EnterCriticalSection(m)
 #define pthread_mutex_unlock(m) LeaveCriticalSection(m)
 
-void millisleep(long ms) { Sleep(ms); }
+static inline void millisleep(long ms) { Sleep(ms); }
 
 #else  /* POSIX */
 
 #include <pthread.h>
 #include <unistd.h>             /* For sleep() */
 
-void millisleep(long ms) {
+static inline void millisleep(long ms) {
   struct timespec delay = {0};
   delay.tv_sec  = ms / 1000;
   delay.tv_nsec = (ms % 1000) * 1000000;
@@ -29,6 +29,7 @@
 #include "./internal/pn_unique_ptr.hpp"
 #include "./symbol.hpp"
 #include "./types_fwd.hpp"
+#include "./work_queue.hpp"
 
 #include <proton/type_compat.h>
 
@@ -171,6 +172,11 @@ class connection_options {
     /// **Unsettled API** - Set reconnect and failover options.
     PN_CPP_EXTERN connection_options& reconnect(const reconnect_options &);
 
+    /// **Unsettled API** - Bound the connection's work queue to at
+    /// most `capacity` items of work, see work_queue::full_policy.
+    /// The default of 0 is unbounded.
+    PN_CPP_EXTERN connection_options& work_queue_capacity(size_t capacity, work_queue::full_policy policy = work_queue::FAIL);
+
     /// Update option values from values set in other.
     PN_CPP_EXTERN connection_options& update(const connection_options& other);
 
@@ -179,6 +185,8 @@ class connection_options {
     void apply_unbound_client(pn_transport_t*) const;
     void apply_unbound_server(pn_transport_t*) const;
     messaging_handler* handler() const;
+    size_t work_queue_capacity() const;
+    work_queue::full_policy work_queue_policy() const;
 
     class impl;
     internal::pn_unique_ptr<impl> impl_;
@@ -169,6 +169,19 @@ class PN_CPP_CLASS_EXTERN container {
     /// The call returns when the container stops. See `auto_stop()`
     /// and `stop()`.
     PN_CPP_EXTERN void run(int count);
+
+    /// **Unsettled API** - Divide the container's connections and
+    /// listeners over `count` independent event queues.
+    ///
+    /// Each thread running the container polls one queue, so threads
+    /// contend less with each other. Use with `run(int count)` where
+    /// `count` is a multiple of the number of queues.
+    ///
+    /// **C++ versions** - Available with C++11 or later.
+    ///
+    /// @throw error if the container has already started, or has
+    /// connections, listeners or scheduled work.
+    PN_CPP_EXTERN void shards(int count);
 #endif
 
     /// Enable or disable automatic container stop.  It is enabled by
@@ -306,7 +319,14 @@ class PN_CPP_CLASS_EXTERN container {
     ///
     /// **C++ versions** - With C++11 and later, use a
     /// `std::function<void()>` type for the `fn` parameter.
-    PN_CPP_EXTERN void schedule(duration dur, work fn);
+    ///
+    /// @return a handle that can be passed to cancel().
+    PN_CPP_EXTERN work_handle schedule(duration dur, work fn);
+
+    /// **Unsettled API** - Cancel work scheduled with schedule().
+    ///
+    /// Has no effect if the work has already been run or cancelled.
+    PN_CPP_EXTERN void cancel(work_handle);
 
     /// **Deprecated** - Use `container::schedule(duration, work)`.
     PN_CPP_EXTERN PN_CPP_DEPRECATED("Use 'container::schedule(duration, work)'") void schedule(duration dur, void_function0& fn);
@@ -315,7 +335,7 @@ class PN_CPP_CLASS_EXTERN container {
     /// Declare both v03 and v11 if compiling with c++11 as the library contains both.
     /// A C++11 user should never call the v03 overload so it is private in this case
 #if PN_CPP_HAS_LAMBDAS && PN_CPP_HAS_VARIADIC_TEMPLATES
-    PN_CPP_EXTERN void schedule(duration dur, internal::v03::work fn);
+    PN_CPP_EXTERN work_handle schedule(duration dur, internal::v03::work fn);
 #endif
     class impl;
     internal::pn_unique_ptr<impl> impl_;
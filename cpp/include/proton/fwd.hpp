@@ -27,6 +27,8 @@
 
 #include "./internal/config.hpp"
 
+#include <proton/type_compat.h>
+
 namespace proton {
 
 class annotation_key;
@@ -70,6 +72,11 @@ using internal::v11::work;
 using internal::v03::work;
 #endif
 
+/// **Unsettled API** - Identifies work scheduled with
+/// `container::schedule()` or `work_queue::schedule()` so that it can
+/// be cancelled. 0 never identifies any work.
+typedef uint64_t work_handle;
+
 namespace io {
 
 class connection_driver;
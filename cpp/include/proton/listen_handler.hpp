@@ -57,6 +57,13 @@ class PN_CPP_CLASS_EXTERN listen_handler {
 
     /// Called when this listen_handler is no longer needed, and can be deleted.
     PN_CPP_EXTERN virtual void on_close(listener&);
+
+    /// **Unsettled API** - Called before listening, returns the number of
+    /// sockets to listen with for each address using SO_REUSEPORT, so
+    /// incoming connections are spread over a container's shards. See
+    /// proton::container::shards(). The default, 0, listens with a single
+    /// socket per address. Ignored where SO_REUSEPORT is not supported.
+    PN_CPP_EXTERN virtual size_t reuseport();
 };
 
 } // proton
@@ -107,6 +107,15 @@ class message {
     PN_CPP_EXTERN std::vector<char> encode() const;
 
     /// Decode from string data into the message.
+    ///
+    /// Each section of the message is decoded when it is first
+    /// used. Sections that are not used are encoded again by copying
+    /// the original bytes, so forwarding a message unchanged does not
+    /// decode or re-encode its content.
+    ///
+    /// @throw proton::error if the data is not a sequence of message
+    /// sections. Errors in the content of a section are thrown by the
+    /// accessors for that section when it is used.
     PN_CPP_EXTERN void decode(const std::vector<char>&);
 
     /// @}
@@ -325,10 +334,12 @@ class message {
     struct impl;
     pn_message_t* pn_msg() const;
     struct impl& impl() const;
+    size_t encode_into(std::vector<char>&, size_t offset = 0) const;
 
     mutable pn_message_t* pn_msg_;
 
   PN_CPP_EXTERN friend void swap(message&, message&);
+  friend class sender;
     /// @endcond
 };
 
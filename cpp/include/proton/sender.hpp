@@ -57,6 +57,24 @@ PN_CPP_CLASS_EXTERN sender : public link {
     /// Send a message on the sender.
     PN_CPP_EXTERN tracker send(const message &m);
 
+    /// **Unsettled API** - Send the messages in the range [first, last)
+    /// for as long as the sender has credit.
+    ///
+    /// The messages are encoded together and their deliveries are
+    /// created in one step, which is cheaper than calling send() for
+    /// each of them.
+    ///
+    /// @return the number of messages sent, from the start of the
+    /// range. The rest can be sent when there is more credit, see
+    /// messaging_handler::on_sendable.
+    template <class InputIterator> size_t send(InputIterator first, InputIterator last) {
+        size_t n = 0;
+        for (size_t credit = batch_begin(); n < credit && first != last; ++first, ++n)
+            batch_add(*first);
+        batch_send();
+        return n;
+    }
+
     /// Get the source node.
     PN_CPP_EXTERN class source source() const;
 
@@ -72,6 +90,11 @@ PN_CPP_CLASS_EXTERN sender : public link {
     PN_CPP_EXTERN void return_credit();
 
     /// @cond INTERNAL
+  private:
+    PN_CPP_EXTERN size_t batch_begin();
+    PN_CPP_EXTERN void batch_add(const message&);
+    PN_CPP_EXTERN void batch_send();
+
   friend class internal::factory<sender>;
   friend class sender_iterator;
     /// @endcond
@@ -66,7 +66,7 @@ struct invocable_cloner : invocable {
 
 struct invocable_wrapper {
     invocable_wrapper(): wrapped_(0) {}
-    invocable_wrapper(const invocable_wrapper& w): wrapped_(&w.wrapped_->clone()) {}
+    invocable_wrapper(const invocable_wrapper& w): wrapped_(w.wrapped_ ? &w.wrapped_->clone() : 0) {}
     invocable_wrapper& operator=(const invocable_wrapper& that) {
         invocable_wrapper newthis(that);
         std::swap(wrapped_, newthis.wrapped_);
@@ -343,12 +343,31 @@ class PN_CPP_CLASS_EXTERN work_queue {
     /// @endcond
 
   public:
+    /// **Unsettled API** - What add() does when a bounded work queue
+    /// is full.
+    ///
+    /// BLOCK must not be used to add work from the queue's own work or
+    /// event handlers, they would be waiting for themselves.
+    enum full_policy {
+        BLOCK,      ///< Wait until there is room.
+        FAIL,       ///< Return false without adding the work.
+        DROP_OLDEST ///< Discard the oldest work that has not started.
+    };
+
     /// **Unsettled API** - Create a work queue.
     PN_CPP_EXTERN work_queue();
 
     /// **Unsettled API** - Create a work queue backed by a container.
     PN_CPP_EXTERN work_queue(container&);
 
+    /// **Unsettled API** - Create a work queue backed by a container
+    /// that holds at most `capacity` items of work. `policy` says
+    /// what add() does when it is full. A capacity of 0 is unbounded.
+    ///
+    /// Adding to a bounded queue does not take a lock, which suits
+    /// many threads feeding the same queue.
+    PN_CPP_EXTERN work_queue(container&, size_t capacity, full_policy policy = FAIL);
+
     PN_CPP_EXTERN ~work_queue();
 
     /// **Unsettled API** - Add work `fn` to the work queue.
@@ -371,8 +390,14 @@ class PN_CPP_CLASS_EXTERN work_queue {
     /// to inject the work after the elapsed duration.  There will be
     /// no indication of this.
     ///
-    /// @copydetails add()
-    PN_CPP_EXTERN void schedule(duration, work fn);
+    /// @return a handle that can be passed to cancel().
+    PN_CPP_EXTERN work_handle schedule(duration, work fn);
+
+    /// **Unsettled API** - Cancel work scheduled with schedule().
+    ///
+    /// Has no effect if the duration has elapsed and the work has
+    /// already been added to the queue, or if it was already cancelled.
+    PN_CPP_EXTERN void cancel(work_handle);
 
     /// **Deprecated** - Use `schedule(duration, work)`.
     PN_CPP_EXTERN PN_CPP_DEPRECATED("Use 'work_queue::schedule(duration, work)'") void schedule(duration, void_function0& fn);
@@ -382,7 +407,7 @@ class PN_CPP_CLASS_EXTERN work_queue {
     /// A C++11 user should never call the v03 overload so it is private in this case
 #if PN_CPP_HAS_LAMBDAS && PN_CPP_HAS_VARIADIC_TEMPLATES
     PN_CPP_EXTERN bool add(internal::v03::work fn);
-    PN_CPP_EXTERN void schedule(duration, internal::v03::work fn);
+    PN_CPP_EXTERN work_handle schedule(duration, internal::v03::work fn);
 #endif
 
     PN_CPP_EXTERN static work_queue& get(pn_connection_t*);
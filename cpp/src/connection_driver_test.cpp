@@ -40,6 +40,7 @@
 #include "proton/uuid.hpp"
 
 #include <deque>
+#include <sstream>
 #include <algorithm>
 
 namespace {
@@ -490,6 +491,82 @@ void test_message() {
     ASSERT_EQUAL(value("b"), m2.message_annotations().get("a"));
 }
 
+void test_message_sizes() {
+    // Messages of different sizes on one link share its encode buffer
+    record_handler ha, hb;
+    driver_pair d(ha, hb);
+
+    proton::sender s = d.a.connection().open_sender("x");
+    std::string big(100000, 'x');
+    s.send(proton::message("small"));
+    s.send(proton::message(big));
+    s.send(proton::message("tiny"));
+
+    while (hb.messages.size() < 3)
+        d.process();
+
+    ASSERT_EQUAL(value("small"), quick_pop(hb.messages).body());
+    ASSERT_EQUAL(value(big), quick_pop(hb.messages).body());
+    ASSERT_EQUAL(value("tiny"), quick_pop(hb.messages).body());
+}
+
+void test_send_buffer_size() {
+    // The encode buffer follows the size of recent sends: large sends reuse
+    // it, a run of small ones shrinks it and a large one grows it again
+    record_handler ha, hb;
+    driver_pair d(ha, hb);
+
+    proton::sender s = d.a.connection().open_sender("x");
+    std::string big(100000, 'x');
+    std::vector<std::string> sent;
+    for (int i = 0; i < 2; ++i)
+        sent.push_back(big);
+    for (int i = 0; i < 40; ++i) {
+        std::ostringstream o;
+        o << "small" << i;
+        sent.push_back(o.str());
+    }
+    sent.push_back(big + "y");
+    sent.push_back("tiny");
+    for (size_t i = 0; i < sent.size(); ++i)
+        s.send(proton::message(sent[i]));
+
+    while (hb.messages.size() < sent.size())
+        d.process();
+    for (size_t i = 0; i < sent.size(); ++i)
+        ASSERT_EQUAL(value(sent[i]), quick_pop(hb.messages).body());
+}
+
+void test_message_batch() {
+    // A batch sends as many messages as there is credit for
+    record_handler ha, hb;
+    driver_pair d(ha, hb);
+
+    proton::sender s = d.a.connection().open_sender("x");
+    while (s.credit() == 0)
+        d.process();
+    int credit = s.credit();
+    std::vector<proton::message> batch;
+    for (int i = 0; i < credit + 5; ++i)
+        batch.push_back(proton::message(i));
+
+    ASSERT_EQUAL(size_t(credit), s.send(batch.begin(), batch.end()));
+    ASSERT_EQUAL(0, s.credit());
+    while (hb.messages.size() < size_t(credit))
+        d.process();
+    for (int i = 0; i < credit; ++i)
+        ASSERT_EQUAL(value(i), quick_pop(hb.messages).body());
+
+    // The rest once there is more credit
+    while (s.credit() == 0)
+        d.process();
+    ASSERT_EQUAL(size_t(5), s.send(batch.begin() + credit, batch.end()));
+    while (hb.messages.size() < 5)
+        d.process();
+    for (int i = credit; i < credit + 5; ++i)
+        ASSERT_EQUAL(value(i), quick_pop(hb.messages).body());
+}
+
 void test_message_timeout_succeed() {
     // Verify a message arrives intact
     record_handler ha, hb;
@@ -549,6 +626,9 @@ int main(int argc, char** argv) {
     RUN_ARGV_TEST(failed, test_link_anonymous_dynamic());
     RUN_ARGV_TEST(failed, test_link_capability_filter());
     RUN_ARGV_TEST(failed, test_message());
+    RUN_ARGV_TEST(failed, test_message_sizes());
+    RUN_ARGV_TEST(failed, test_send_buffer_size());
+    RUN_ARGV_TEST(failed, test_message_batch());
     RUN_ARGV_TEST(failed, test_message_timeout_succeed());
     RUN_ARGV_TEST(failed, test_message_timeout_fail());
     return failed;
@@ -93,6 +93,8 @@ void container::run() { impl_->run(1); }
 
 #if PN_CPP_SUPPORTS_THREADS
 void container::run(int threads) { impl_->run(threads); }
+
+void container::shards(int count) { impl_->shards(count); }
 #endif
 
 void container::auto_stop(bool set) { impl_->auto_stop(set); }
@@ -115,12 +117,14 @@ returned<receiver> container::open_receiver(
 
 std::string container::id() const { return impl_->id(); }
 
-void container::schedule(duration d, internal::v03::work f) { return impl_->schedule(d, f); }
+work_handle container::schedule(duration d, internal::v03::work f) { return impl_->schedule(d, f); }
 #if PN_CPP_HAS_LAMBDAS && PN_CPP_HAS_VARIADIC_TEMPLATES
-void container::schedule(duration d, internal::v11::work f) { return impl_->schedule(d, f); }
+work_handle container::schedule(duration d, internal::v11::work f) { return impl_->schedule(d, f); }
 #endif
 
-void container::schedule(duration d, void_function0& f) { return impl_->schedule(d, make_work(&void_function0::operator(), &f)); }
+void container::schedule(duration d, void_function0& f) { impl_->schedule(d, make_work(&void_function0::operator(), &f)); }
+
+void container::cancel(work_handle h) { impl_->cancel(h); }
 
 void container::client_connection_options(const connection_options& c) { impl_->client_connection_options(c); }
 connection_options container::client_connection_options() const { return impl_->client_connection_options(); }
@@ -33,8 +33,13 @@
 #include <string>
 #include <cstdio>
 #include <sstream>
+#include <vector>
 
 #if PN_CPP_SUPPORTS_THREADS
+# include <algorithm>
+# include <atomic>
+# include <chrono>
+# include <memory>
 # include <thread>
 # include <mutex>
 # include <condition_variable>
@@ -53,10 +58,13 @@ struct test_listen_handler : public proton::listen_handler {
     std::string on_error_;
     std::string host_;
     proton::connection_options opts_;
+    size_t reuseport_;
 
     test_listen_handler(const std::string& host=std::string(),
                         const proton::connection_options& opts=proton::connection_options()
-    ) : on_open_(false), on_accept_(false), on_close_(false), host_(host), opts_(opts) {}
+    ) : on_open_(false), on_accept_(false), on_close_(false), host_(host), opts_(opts), reuseport_(0) {}
+
+    size_t reuseport() PN_CPP_OVERRIDE { return reuseport_; }
 
     proton::connection_options on_accept(proton::listener&) PN_CPP_OVERRIDE {
         on_accept_ = true;
@@ -319,6 +327,36 @@ int test_container_schedule_stop() {
     return 0;
 }
 
+struct schedule_cancel_tester : public proton::messaging_handler {
+    std::vector<int> ran;
+
+    void run(int i) { ran.push_back(i); }
+    void stop(proton::container* c) { c->stop(); }
+
+    void on_container_start(proton::container& c) PN_CPP_OVERRIDE {
+        c.schedule(proton::duration(30), proton::make_work(&schedule_cancel_tester::run, this, 3));
+        c.schedule(proton::duration(10), proton::make_work(&schedule_cancel_tester::run, this, 1));
+        proton::work_handle h = c.schedule(proton::duration(15), proton::make_work(&schedule_cancel_tester::run, this, 0));
+        c.schedule(proton::duration(20), proton::make_work(&schedule_cancel_tester::run, this, 2));
+        c.cancel(h);
+        c.cancel(h);            // Already cancelled, no effect
+        c.cancel(0);
+        // A day ahead, on a high level of the timer wheel
+        c.cancel(c.schedule(proton::duration(24*60*60*1000), proton::make_work(&schedule_cancel_tester::run, this, 0)));
+        c.schedule(proton::duration(100), proton::make_work(&schedule_cancel_tester::stop, this, &c));
+    }
+};
+
+int test_container_schedule_cancel() {
+    schedule_cancel_tester tester;
+    proton::container c(tester);
+    c.auto_stop(false);
+    c.run();
+    ASSERT_EQUAL(3U, tester.ran.size());
+    for (size_t i = 0; i < tester.ran.size(); ++i)
+        ASSERT_EQUAL(int(i+1), tester.ran[i]);
+    return 0;
+}
 
 #if PN_CPP_SUPPORTS_THREADS // Tests that require thread support
 
@@ -406,6 +444,141 @@ void test_container_mt_stop() {
     }
 }
 
+void test_container_mt_shards() {
+    proton::connection_options opts;
+    test_handler th("", opts);
+    th.listen_handler.reuseport_ = 2; // A listening socket for each shard
+    proton::container c(th);
+    c.shards(2);
+    c.run(4);                   // Threads on both shards stop with the container
+    ASSERT(!th.peer_container_id.empty());
+    ASSERT(th.listen_handler.on_close_);
+
+    proton::container used;
+    used.listen("//:0");
+    ASSERT_THROWS(proton::error, used.shards(2));
+}
+
+// Count work run by a work queue, wait for a total from another thread
+class work_counter {
+  public:
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::vector<int> done_;
+
+    void run(int i) {
+        std::lock_guard<std::mutex> l(lock_);
+        done_.push_back(i);
+        cond_.notify_all();
+    }
+
+    std::vector<int> wait(size_t n) {
+        std::unique_lock<std::mutex> l(lock_);
+        while (done_.size() < n) cond_.wait(l);
+        return done_;
+    }
+};
+
+void test_container_bounded_work_queue() {
+    proton::container c;
+    c.auto_stop(false);
+    work_counter failed, dropped, blocked;
+    proton::work_queue fail_q(c, 4, proton::work_queue::FAIL);
+    proton::work_queue drop_q(c, 4, proton::work_queue::DROP_OLDEST);
+    proton::work_queue block_q(c, 8, proton::work_queue::BLOCK);
+
+    // Before the container runs nothing is taken off the queues
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQUAL(i < 4, fail_q.add([&failed, i]() { failed.run(i); }));
+        ASSERT(drop_q.add([&dropped, i]() { dropped.run(i); }));
+    }
+    container_runner runner(c);
+    auto t = std::thread(runner);
+    try {
+        ASSERT_EQUAL(test::many<int>() + 0 + 1 + 2 + 3, failed.wait(4));
+        ASSERT_EQUAL(test::many<int>() + 2 + 3 + 4 + 5, dropped.wait(4));
+
+        // Producers wait for room, no work is lost
+        const int producers = 4, n = 1000;
+        std::atomic<int> rejected(0);
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.push_back(std::thread([&block_q, &blocked, &rejected, n]() {
+                for (int i = 0; i < n; ++i)
+                    if (!block_q.add([&blocked, i]() { blocked.run(i); })) ++rejected;
+            }));
+        }
+        for (size_t p = 0; p < threads.size(); ++p) threads[p].join();
+        ASSERT_EQUAL(0, rejected.load());
+        ASSERT_EQUAL(size_t(producers * n), blocked.wait(producers * n).size());
+        c.stop();
+        t.join();
+    } catch (const std::exception& e) {
+        std::cerr << FAIL_MSG(e.what()) << std::endl;
+        c.stop();
+        t.join();
+        throw;
+    }
+}
+
+// Work that waits until `expected` pieces of work are running at once
+class work_gate {
+  public:
+    std::mutex lock_;
+    std::condition_variable cond_;
+    int running_, max_running_, done_;
+    bool overlap_;
+
+    work_gate() : running_(0), max_running_(0), done_(0), overlap_(false) {}
+
+    void run(int expected, std::atomic<bool>* queue_busy) {
+        if (queue_busy->exchange(true)) overlap_ = true; // Two jobs of one queue at once
+        std::unique_lock<std::mutex> l(lock_);
+        max_running_ = std::max(max_running_, ++running_);
+        cond_.notify_all();
+        cond_.wait_for(l, std::chrono::seconds(5), [&]() { return max_running_ >= expected; });
+        --running_;
+        ++done_;
+        queue_busy->store(false);
+        cond_.notify_all();
+    }
+
+    void wait_done(int n) {
+        std::unique_lock<std::mutex> l(lock_);
+        while (done_ < n) cond_.wait(l);
+    }
+};
+
+void test_container_parallel_work_queues() {
+    const int n = 4;
+    proton::container c;
+    c.auto_stop(false);
+    work_gate gate;
+    std::vector<std::unique_ptr<proton::work_queue> > queues;
+    std::vector<std::atomic<bool> > busy(n);
+    auto t = std::thread([&c, n]() { c.run(n); });
+    try {
+        // Queues run on different threads at the same time, but the two
+        // jobs in each queue are never run together.
+        for (int i = 0; i < n; ++i) {
+            queues.push_back(std::unique_ptr<proton::work_queue>(new proton::work_queue(c)));
+            std::atomic<bool>* b = &busy[i];
+            for (int j = 0; j < 2; ++j)
+                ASSERT(queues.back()->add([&gate, b, n]() { gate.run(n, b); }));
+        }
+        gate.wait_done(2 * n);
+        ASSERT_EQUAL(n, gate.max_running_);
+        ASSERT(!gate.overlap_);
+        c.stop();
+        t.join();
+    } catch (const std::exception& e) {
+        std::cerr << FAIL_MSG(e.what()) << std::endl;
+        c.stop();
+        t.join();
+        throw;
+    }
+}
+
 #endif
 
 } // namespace
@@ -423,9 +596,13 @@ int main(int argc, char** argv) {
     RUN_ARGV_TEST(failed, test_container_immediate_stop());
     RUN_ARGV_TEST(failed, test_container_pre_stop());
     RUN_ARGV_TEST(failed, test_container_schedule_stop());
+    RUN_ARGV_TEST(failed, test_container_schedule_cancel());
 #if PN_CPP_SUPPORTS_THREADS
     RUN_ARGV_TEST(failed, test_container_mt_stop_empty());
     RUN_ARGV_TEST(failed, test_container_mt_stop());
+    RUN_ARGV_TEST(failed, test_container_mt_shards());
+    RUN_ARGV_TEST(failed, test_container_bounded_work_queue());
+    RUN_ARGV_TEST(failed, test_container_parallel_work_queues());
 #endif
     return failed;
 }
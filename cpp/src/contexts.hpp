@@ -121,7 +121,8 @@ class listener_context : public context {
 
 class link_context : public context {
   public:
-    link_context() : handler(0), credit_window(10), pending_credit(0), auto_accept(true), auto_settle(true), draining(false) {}
+    link_context() : handler(0), credit_window(10), pending_credit(0), auto_accept(true), auto_settle(true), draining(false),
+                     send_size(0), small_sends(0), small_send_size(0) {}
     static link_context& get(pn_link_t* l);
 
     messaging_handler* handler;
@@ -130,6 +131,11 @@ class link_context : public context {
     bool auto_accept;
     bool auto_settle;
     bool draining;
+    std::vector<char> send_buffer; // re-used by sender::send for encoding.
+    std::vector<size_t> batch_ends; // End of each message of a send batch in send_buffer.
+    size_t send_size;       // Largest recent send from send_buffer, sizes it for the next encode.
+    unsigned small_sends;   // Consecutive sends of under a quarter of send_size.
+    size_t small_send_size; // Largest of the small_sends.
 };
 
 class session_context : public context {
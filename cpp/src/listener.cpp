@@ -66,4 +66,5 @@ void listen_handler::on_open(listener&) {}
 connection_options listen_handler::on_accept(listener&) { return connection_options(); }
 void listen_handler::on_error(listener&, const std::string&) {}
 void listen_handler::on_close(listener&) {}
+size_t listen_handler::reuseport() { return 0; }
 }
@@ -107,7 +107,8 @@ struct message::impl& message::impl() const {
 
 message& message::operator=(const message& m) {
     if (&m != this) {
-        // TODO aconway 2015-08-10: more efficient pn_message_copy function
+        // Sections of m that have not been used since it was decoded are
+        // copied as they are, see decode()
         std::vector<char> data;
         m.encode(data);
         decode(data);
@@ -126,11 +127,18 @@ namespace {
 void check(int err) {
     if (err) throw error(error_str(err));
 }
+
+// Decode a section on first use after decode(), throw if its content is bad.
+void check_section(pn_message_t* m, pni_msg_section_t s) {
+    int err = pni_message_check_section(m, s);
+    if (err) throw error(error_str(pn_message_error(m), err));
+}
 } // namespace
 
 void message::id(const message_id& id) { pn_message_set_id(pn_msg(), id.atom_); }
 
 message_id message::id() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     return pn_message_get_id(pn_msg());
 }
 
@@ -139,6 +147,7 @@ void message::user(const std::string &id) {
 }
 
 std::string message::user() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     return str(pn_message_get_user_id(pn_msg()));
 }
 
@@ -147,6 +156,7 @@ void message::to(const std::string &addr) {
 }
 
 std::string message::to() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* addr = pn_message_get_address(pn_msg());
     return addr ? std::string(addr) : std::string();
 }
@@ -165,6 +175,7 @@ void message::subject(const std::string &s) {
 }
 
 std::string message::subject() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_subject(pn_msg());
     return s ? std::string(s) : std::string();
 }
@@ -174,6 +185,7 @@ void message::reply_to(const std::string &s) {
 }
 
 std::string message::reply_to() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_reply_to(pn_msg());
     return s ? std::string(s) : std::string();
 }
@@ -183,6 +195,7 @@ void message::correlation_id(const message_id& id) {
 }
 
 message_id message::correlation_id() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     return pn_message_get_correlation_id(pn_msg());
 }
 
@@ -191,6 +204,7 @@ void message::content_type(const std::string &s) {
 }
 
 std::string message::content_type() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_content_type(pn_msg());
     return s ? std::string(s) : std::string();
 }
@@ -200,6 +214,7 @@ void message::content_encoding(const std::string &s) {
 }
 
 std::string message::content_encoding() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_content_encoding(pn_msg());
     return s ? std::string(s) : std::string();
 }
@@ -208,6 +223,7 @@ void message::expiry_time(timestamp t) {
     pn_message_set_expiry_time(pn_msg(), t.milliseconds());
 }
 timestamp message::expiry_time() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     return timestamp(pn_message_get_expiry_time(pn_msg()));
 }
 
@@ -215,6 +231,7 @@ void message::creation_time(timestamp t) {
     pn_message_set_creation_time(pn_msg(), t.milliseconds());
 }
 timestamp message::creation_time() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     return timestamp(pn_message_get_creation_time(pn_msg()));
 }
 
@@ -223,6 +240,7 @@ void message::group_id(const std::string &s) {
 }
 
 std::string message::group_id() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_group_id(pn_msg());
     return s ? std::string(s) : std::string();
 }
@@ -232,61 +250,78 @@ void message::reply_to_group_id(const std::string &s) {
 }
 
 std::string message::reply_to_group_id() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
     const char* s = pn_message_get_reply_to_group_id(pn_msg());
     return s ? std::string(s) : std::string();
 }
 
-bool message::inferred() const { return pn_message_is_inferred(pn_msg()); }
+bool message::inferred() const {
+    check_section(pn_msg(), PNI_MSG_BODY);
+    return pn_message_is_inferred(pn_msg());
+}
 
 void message::inferred(bool b) { pn_message_set_inferred(pn_msg(), b); }
 
 void message::body(const value& x) { body() = x; }
 
-const value& message::body() const { return impl().body; }
-value& message::body() { return impl().body; }
+// check_section() decodes the section if it has not been used since a lazy
+// decode, impl() refers to the same pn_data_t.
+const value& message::body() const { check_section(pn_msg(), PNI_MSG_BODY); return impl().body; }
+value& message::body() { check_section(pn_msg(), PNI_MSG_BODY); return impl().body; }
 
 message::property_map& message::properties() {
+    check_section(pn_msg(), PNI_MSG_APPLICATION_PROPERTIES);
     return impl().properties;
 }
 
 const message::property_map& message::properties() const {
+    check_section(pn_msg(), PNI_MSG_APPLICATION_PROPERTIES);
     return impl().properties;
 }
 
 message::annotation_map& message::message_annotations() {
+    check_section(pn_msg(), PNI_MSG_ANNOTATIONS);
     return impl().annotations;
 }
 
 const message::annotation_map& message::message_annotations() const {
+    check_section(pn_msg(), PNI_MSG_ANNOTATIONS);
     return impl().annotations;
 }
 
 message::annotation_map& message::delivery_annotations() {
+    check_section(pn_msg(), PNI_MSG_INSTRUCTIONS);
     return impl().instructions;
 }
 
 const message::annotation_map& message::delivery_annotations() const {
+    check_section(pn_msg(), PNI_MSG_INSTRUCTIONS);
     return impl().instructions;
 }
 
-void message::encode(std::vector<char> &s) const {
+// Encode into s from offset to the end, growing s until the message fits, and
+// return the encoded size. s is not shrunk to fit so a buffer that is used
+// again does not have to be re-allocated or cleared.
+size_t message::encode_into(std::vector<char> &s, size_t offset) const {
     impl().flush();
-    size_t sz = std::max(s.capacity(), size_t(512));
+    size_t min = std::max(s.capacity(), offset + 512);
+    if (s.size() < min)
+        s.resize(min);
     while (true) {
-        s.resize(sz);
-        assert(!s.empty());
-        int err = pn_message_encode(pn_msg(), const_cast<char*>(&s[0]), &sz);
-        if (err) {
-            if (err != PN_OVERFLOW)
-                check(err);
-        } else {
-            s.resize(sz);
-            return;
-        }
-        sz *= 2;
+        size_t sz = s.size() - offset;
+        int err = pn_message_encode(pn_msg(), &s[offset], &sz);
+        if (!err)
+            return sz;
+        if (err != PN_OVERFLOW)
+            check(err);
+        s.resize(s.size() * 2);
     }
 }
 
+void message::encode(std::vector<char> &s) const {
+    s.resize(encode_into(s));
+}
+
 std::vector<char> message::encode() const {
     std::vector<char> data;
     encode(data);
@@ -297,25 +332,43 @@ void message::decode(const std::vector<char> &s) {
     if (s.empty())
         throw error("message decode: no data");
     impl().clear();
-    check(pn_message_decode(pn_msg(), &s[0], s.size()));
+    check(pn_message_decode_lazy(pn_msg(), &s[0], s.size()));
 }
 
-bool message::durable() const { return pn_message_is_durable(pn_msg()); }
+bool message::durable() const {
+    check_section(pn_msg(), PNI_MSG_HEADER);
+    return pn_message_is_durable(pn_msg());
+}
 void message::durable(bool b) { pn_message_set_durable(pn_msg(), b); }
 
-duration message::ttl() const { return duration(pn_message_get_ttl(pn_msg())); }
+duration message::ttl() const {
+    check_section(pn_msg(), PNI_MSG_HEADER);
+    return duration(pn_message_get_ttl(pn_msg()));
+}
 void message::ttl(duration d) { pn_message_set_ttl(pn_msg(), d.milliseconds()); }
 
-uint8_t message::priority() const { return pn_message_get_priority(pn_msg()); }
+uint8_t message::priority() const {
+    check_section(pn_msg(), PNI_MSG_HEADER);
+    return pn_message_get_priority(pn_msg());
+}
 void message::priority(uint8_t d) { pn_message_set_priority(pn_msg(), d); }
 
-bool message::first_acquirer() const { return pn_message_is_first_acquirer(pn_msg()); }
+bool message::first_acquirer() const {
+    check_section(pn_msg(), PNI_MSG_HEADER);
+    return pn_message_is_first_acquirer(pn_msg());
+}
 void message::first_acquirer(bool b) { pn_message_set_first_acquirer(pn_msg(), b); }
 
-uint32_t message::delivery_count() const { return pn_message_get_delivery_count(pn_msg()); }
+uint32_t message::delivery_count() const {
+    check_section(pn_msg(), PNI_MSG_HEADER);
+    return pn_message_get_delivery_count(pn_msg());
+}
 void message::delivery_count(uint32_t d) { pn_message_set_delivery_count(pn_msg(), d); }
 
-int32_t message::group_sequence() const { return pn_message_get_group_sequence(pn_msg()); }
+int32_t message::group_sequence() const {
+    check_section(pn_msg(), PNI_MSG_PROPERTIES);
+    return pn_message_get_group_sequence(pn_msg());
+}
 void message::group_sequence(int32_t d) { pn_message_set_group_sequence(pn_msg(), d); }
 
 const uint8_t message::default_priority = PN_DEFAULT_PRIORITY;
@@ -194,6 +194,54 @@ void test_message_reuse() {
     ASSERT_EQUAL(value("b"), m1.properties().get("a"));
 }
 
+void test_message_forward() {
+    message m1("body");
+    m1.to("to");
+    m1.properties().put("a", "b");
+    m1.message_annotations().put("x-opt-a", 1);
+    std::vector<char> data = m1.encode();
+
+    // Unchanged message encodes to the same bytes
+    message m2;
+    m2.decode(data);
+    ASSERT(data == m2.encode());
+    message m3(m2);
+    ASSERT(data == m3.encode());
+    ASSERT_EQUAL(value("b"), m3.properties().get("a"));
+
+    // Changed sections are encoded again, the rest are kept
+    m2.decode(data);
+    m2.to("elsewhere");
+    m2.message_annotations().put("x-opt-b", 2);
+    message m4;
+    m4.decode(m2.encode());
+    ASSERT_EQUAL("elsewhere", m4.to());
+    ASSERT_EQUAL(value(2), m4.message_annotations().get("x-opt-b"));
+    ASSERT_EQUAL(value("b"), m4.properties().get("a"));
+    ASSERT_EQUAL(value("body"), m4.body());
+}
+
+void test_message_bad_section() {
+    // Header and application-properties sections with an invalid type code
+    // inside their list/map, followed by a good amqp-value body.
+    const char bytes[] =
+        "\x00\x53\x70\xc0\x02\x01\xff"
+        "\x00\x53\x74\xc1\x02\x01\xff"
+        "\x00\x53\x77\xa1\x02hi";
+    std::vector<char> data(bytes, bytes + sizeof(bytes) - 1);
+    message m;
+    m.decode(data);             // Sections are only decoded when used
+    ASSERT_EQUAL(value("hi"), m.body());
+    ASSERT_THROWS_MSG(proton::error, "data error", m.durable());
+    ASSERT_THROWS(proton::error, m.ttl()); // Still reported after first use
+    ASSERT_THROWS(proton::error, m.properties());
+    ASSERT_EQUAL("", m.to());
+
+    m.decode(message("ok").encode()); // A new decode forgets the errors
+    ASSERT(!m.durable());
+    ASSERT(m.properties().empty());
+}
+
 void test_message_print() {
   message m("hello");
   m.to("to");
@@ -216,6 +264,8 @@ int main(int, char**) {
     RUN_TEST(failed, test_message_body());
     RUN_TEST(failed, test_message_maps());
     RUN_TEST(failed, test_message_reuse());
+    RUN_TEST(failed, test_message_forward());
+    RUN_TEST(failed, test_message_bad_section());
     RUN_TEST(failed, test_message_print());
     return failed;
 }
@@ -42,9 +42,11 @@
 #include <string.h>
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 #if PN_CPP_SUPPORTS_THREADS
+# include <condition_variable>
 # include <thread>
 #endif
 
@@ -57,31 +59,195 @@
 
 namespace proton {
 
+namespace {
+
+using internal::atomic;
+
+const timestamp::numeric_type NO_TIMEOUT = std::numeric_limits<timestamp::numeric_type>::max();
+
+// Bounded lock-free queue of work, after Dmitry Vyukov's bounded MPMC queue.
+//
+// Each slot has a sequence number: a slot is free for the producer at
+// position pos when its sequence is pos, and holds work for the consumer at
+// pos when it is pos+1. Positions only increase, the slot is pos % capacity.
+class work_ring {
+  public:
+    explicit work_ring(size_t capacity) : mask_(round_up(capacity) - 1), slots_(mask_ + 1), head_(0), tail_(0) {
+        for (size_t i = 0; i <= mask_; ++i)
+            slots_[i].seq.store(i);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Return false if there is no room
+    bool push(const work& f) {
+        size_t pos = tail_.load();
+        while (true) {
+            slot& s = slots_[pos & mask_];
+            ptrdiff_t diff = ptrdiff_t(s.seq.load()) - ptrdiff_t(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1)) {
+                    s.item = f;
+                    s.seq.store(pos + 1);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // The slot still holds work from the previous lap
+            } else {
+                pos = tail_.load();
+            }
+        }
+    }
+
+    // Return false if there is no work
+    bool pop(work& f) {
+        size_t pos = head_.load();
+        while (true) {
+            slot& s = slots_[pos & mask_];
+            ptrdiff_t diff = ptrdiff_t(s.seq.load()) - ptrdiff_t(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1)) {
+                    f = s.item;
+                    s.item = work();
+                    s.seq.store(pos + mask_ + 1);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load();
+            }
+        }
+    }
+
+    bool full() const {
+        size_t pos = tail_.load();
+        return ptrdiff_t(slots_[pos & mask_].seq.load()) - ptrdiff_t(pos) < 0;
+    }
+
+  private:
+    struct slot {
+        atomic<size_t> seq;
+        work item;
+    };
+
+    static size_t round_up(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    const size_t mask_;
+    std::vector<slot> slots_;
+    atomic<size_t> head_;
+    atomic<size_t> tail_;
+};
+
+} // namespace
+
 class container::impl::common_work_queue : public work_queue::impl {
   public:
-    common_work_queue(container::impl& c): container_(c), finished_(false), running_(false) {}
+    common_work_queue(container::impl& c, size_t capacity, work_queue::full_policy policy) :
+        container_(c), ring_(capacity ? new work_ring(capacity) : 0), policy_(policy),
+        pending_(0), blocked_(0), finished_(false), running_(false) {}
 
     typedef std::vector<work> jobs;
 
+    bool add(work f) { return push(f, policy_ == work_queue::BLOCK); }
+    void add_scheduled(work f) { push(f, false); }
     void run_all_jobs();
-    void finished() { GUARD(lock_); finished_ = true; }
-    void schedule(duration, work);
+    void finished();
+    work_handle schedule(duration, work);
+    void cancel(work_handle h) { container_.cancel(h); }
+
+  protected:
+    // Make sure run_all_jobs() is called, lock_ is held
+    virtual void wake() = 0;
 
+  private:
+    bool push(work f, bool can_block);
+    bool wait_for_room();
+    void run_ring_jobs();
+
+  protected:
     MUTEX(lock_)
+#if PN_CPP_SUPPORTS_THREADS
+    std::condition_variable room_;
+#endif
     container::impl& container_;
-    jobs jobs_;
-    bool finished_;
-    bool running_;
+    jobs jobs_;                              // Unbounded queue, protected by lock_
+    internal::pn_unique_ptr<work_ring> ring_; // Bounded queue, lock-free
+    work_queue::full_policy policy_;
+    atomic<size_t> pending_;  // Work in ring_, the producer that makes it non-zero wakes the queue
+    atomic<size_t> blocked_;  // Producers waiting for room in ring_
+    atomic<bool> finished_;
+    atomic<bool> running_;
 };
 
-void container::impl::common_work_queue::schedule(duration d, work f) {
+work_handle container::impl::common_work_queue::schedule(duration d, work f) {
     // Note this is an unbounded work queue.
     // A resource-safe implementation should be bounded.
-    if (finished_) return;
-    container_.schedule(d, make_work(&work_queue::impl::add_void, (work_queue::impl*)this, f));
+    if (finished_) return 0;
+    // Scheduled work is added from a container thread so it must not block
+    return container_.schedule(d, make_work(&common_work_queue::add_scheduled, this, f));
+}
+
+void container::impl::common_work_queue::finished() {
+    GUARD(lock_);
+    finished_ = true;
+#if PN_CPP_SUPPORTS_THREADS
+    room_.notify_all();
+#endif
+}
+
+bool container::impl::common_work_queue::push(work f, bool can_block) {
+    if (!ring_.get()) {
+        // Note this is an unbounded work queue.
+        GUARD(lock_);
+        if (finished_) return false;
+        jobs_.push_back(f);
+        // Work already queued has woken the queue
+        if (jobs_.size() == 1) wake();
+        return true;
+    }
+    while (true) {
+        if (finished_) return false;
+        if (ring_->push(f)) break;
+        if (policy_ == work_queue::DROP_OLDEST) {
+            work oldest;
+            if (ring_->pop(oldest)) pending_.fetch_sub(1);
+        } else if (!can_block || !wait_for_room()) {
+            return false;
+        }
+    }
+    if (pending_.fetch_add(1) == 0) {
+        GUARD(lock_);
+        if (!finished_) wake();
+    }
+    return true;
+}
+
+// Return false if there is no other thread to make room
+bool container::impl::common_work_queue::wait_for_room() {
+#if PN_CPP_SUPPORTS_THREADS
+    std::unique_lock<std::mutex> l(lock_);
+    ++blocked_;
+    // The consumer frees a slot before it checks blocked_, we count
+    // ourselves before we check for a free slot: one of us sees the other.
+    while (!finished_ && ring_->full())
+        room_.wait(l);
+    --blocked_;
+    return true;
+#else
+    return false;
+#endif
 }
 
 void container::impl::common_work_queue::run_all_jobs() {
+    if (ring_.get()) {
+        run_ring_jobs();
+        return;
+    }
     jobs j;
     // Lock this operation for mt
     {
@@ -99,70 +265,130 @@ void container::impl::common_work_queue::run_all_jobs() {
     {
         GUARD(lock_);
         running_ = false;
+        // Work added while running may have woken a thread that found us
+        // running, wake again so it is not left behind.
+        if (!jobs_.empty() && !finished_) wake();
     }
     return;
 }
 
+void container::impl::common_work_queue::run_ring_jobs() {
+    // Ensure that we never run work from this queue concurrently
+    if (running_.exchange(true)) return;
+    // Run at most one ring full, work added meanwhile is run after another
+    // wake so that it does not hold up the connection's own events.
+    size_t n = 0;
+    work f;
+    for (size_t i = ring_->capacity(); i > 0 && ring_->pop(f); --i) {
+        ++n;
+#if PN_CPP_SUPPORTS_THREADS
+        if (blocked_) {
+            GUARD(lock_);
+            room_.notify_all();
+        }
+#endif
+        // Run queued work, but ignore any exceptions
+        try {
+            f();
+        } catch (...) {};
+    }
+    running_ = false;
+    if (n && pending_.fetch_sub(n) != n) {
+        GUARD(lock_);
+        if (!finished_) wake();
+    }
+}
+
 class container::impl::connection_work_queue : public common_work_queue {
   public:
-    connection_work_queue(container::impl& ct, pn_connection_t* c): common_work_queue(ct), connection_(c) {}
-
-    bool add(work f);
+    connection_work_queue(container::impl& ct, pn_connection_t* c, size_t capacity, work_queue::full_policy policy) :
+        common_work_queue(ct, capacity, policy), connection_(c) {}
 
     pn_connection_t* connection_;
-};
 
-bool container::impl::connection_work_queue::add(work f) {
-    // Note this is an unbounded work queue.
-    // A resource-safe implementation should be bounded.
-    GUARD(lock_);
-    if (finished_) return false;
-    jobs_.push_back(f);
-    pn_connection_wake(connection_);
-    return true;
-}
+  protected:
+    void wake() { pn_connection_wake(connection_); }
+};
 
 class container::impl::container_work_queue : public common_work_queue {
   public:
-    container_work_queue(container::impl& c): common_work_queue(c) {}
+    container_work_queue(container::impl& c, size_t capacity, work_queue::full_policy policy) :
+        common_work_queue(c, capacity, policy) {}
     ~container_work_queue() { container_.remove_work_queue(this); }
 
-    bool add(work f);
+  protected:
+    void wake() { container_.work_queue_ready(this); }
 };
 
-bool container::impl::container_work_queue::add(work f) {
-    // Note this is an unbounded work queue.
-    // A resource-safe implementation should be bounded.
-    GUARD(lock_);
-    if (finished_) return false;
-    jobs_.push_back(f);
-    pn_proactor_set_timeout(container_.proactor_, 0);
-    return true;
-}
-
-class work_queue::impl* container::impl::make_work_queue(container& c) {
-    return c.impl_->add_work_queue();
+class work_queue::impl* container::impl::make_work_queue(container& c, size_t capacity, work_queue::full_policy policy) {
+    return c.impl_->add_work_queue(capacity, policy);
 }
 
 container::impl::impl(container& c, const std::string& id, messaging_handler* mh)
-    : threads_(0), container_(c), proactor_(pn_proactor()), handler_(mh), id_(id),
-      reconnecting_(0), auto_stop_(true), stopping_(false)
+    : threads_(0), container_(c), next_timeout_(NO_TIMEOUT), proactor_(pn_proactor()), handler_(mh), id_(id),
+      reconnecting_(0), auto_stop_(true), stopping_(false), proactor_used_(false)
 {}
 
 container::impl::~impl() {
     pn_proactor_free(proactor_);
 }
 
-container::impl::container_work_queue* container::impl::add_work_queue() {
-    container_work_queue* c = new container_work_queue(*this);
+container::impl::container_work_queue* container::impl::add_work_queue(size_t capacity, work_queue::full_policy policy) {
+    return new container_work_queue(*this, capacity, policy);
+}
+
+// Queue q for the next thread to get a PN_PROACTOR_TIMEOUT
+void container::impl::work_queue_ready(container::impl::container_work_queue* q) {
+    GUARD(work_queues_lock_);
+    work_queues_.push_back(q);
+    pn_proactor_set_timeout(proactor_, 0);
+}
+
+// Set the proactor timeout for the earliest scheduled work. The timeout is
+// also used to run work queues: setting it under the same lock as they are
+// queued means a ready queue is never left waiting for a later timeout.
+void container::impl::set_timeout() {
     GUARD(work_queues_lock_);
-    work_queues_.insert(c);
-    return c;
+    if (!work_queues_.empty()) {
+        pn_proactor_set_timeout(proactor_, 0);
+        return;
+    }
+    timestamp::numeric_type next = next_timeout_.load();
+    if (next == NO_TIMEOUT) return;
+    // Work further ahead than the proactor timeout can reach is re-armed when it fires
+    timestamp::numeric_type ms = std::max(next - timestamp::now().milliseconds(), timestamp::numeric_type(0));
+    pn_proactor_set_timeout(proactor_, pn_millis_t(std::min(ms, timestamp::numeric_type(std::numeric_limits<pn_millis_t>::max()))));
+}
+
+// Make sure the proactor timeout is no later than t. Only a thread that
+// lowers next_timeout_ sets the proactor timeout, so scheduling work that is
+// not the earliest takes no lock but its shard's.
+void container::impl::arm_timeout(timestamp t) {
+    timestamp::numeric_type next = next_timeout_.load();
+    do {
+        if (next <= t.milliseconds()) return;
+    } while (!next_timeout_.compare_exchange_weak(next, t.milliseconds()));
+    set_timeout();
 }
 
 void container::impl::remove_work_queue(container::impl::container_work_queue* l) {
     GUARD(work_queues_lock_);
-    work_queues_.erase(l);
+    work_queues_.erase(std::remove(work_queues_.begin(), work_queues_.end(), l), work_queues_.end());
+}
+
+// Run one container work queue that has work. If there are more, make sure
+// another thread gets a timeout event to run the next so that queues run in
+// parallel, while each queue is only ever run by one thread at a time.
+void container::impl::run_work_queue() {
+    container_work_queue* q = 0;
+    {
+        GUARD(work_queues_lock_);
+        if (work_queues_.empty()) return;
+        q = work_queues_.front();
+        work_queues_.pop_front();
+        if (!work_queues_.empty()) pn_proactor_set_timeout(proactor_, 0);
+    }
+    q->run_all_jobs();
 }
 
 void container::impl::setup_connection_lh(const url& url, pn_connection_t *pnc) {
@@ -180,6 +406,7 @@ pn_connection_t* container::impl::make_connection_lh(
 {
     if (stopping_)
         throw proton::error("container is stopping");
+    proactor_used_ = true;
 
     connection_options opts = client_connection_options_; // Defaults
     opts.update(user_opts);
@@ -189,7 +416,8 @@ pn_connection_t* container::impl::make_connection_lh(
     connection_context& cc(connection_context::get(pnc));
     cc.container = &container_;
     cc.handler = mh;
-    cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, pnc);
+    cc.work_queue_ = new container::impl::connection_work_queue(
+        *container_.impl_, pnc, opts.work_queue_capacity(), opts.work_queue_policy());
     cc.connected_address_ = url;
     cc.connection_options_.reset(new connection_options(opts));
 
@@ -403,9 +631,10 @@ returned<receiver> container::impl::open_receiver(const std::string &urlstr, con
     return make_returned<receiver>(pnl);
 }
 
-pn_listener_t* container::impl::listen_common_lh(const std::string& addr) {
+pn_listener_t* container::impl::listen_common_lh(const std::string& addr, size_t reuseport) {
     if (stopping_)
         throw proton::error("container is stopping");
+    proactor_used_ = true;
 
     proton::url url(addr, false); // Don't want un-helpful defaults like "localhost"
 
@@ -416,6 +645,7 @@ pn_listener_t* container::impl::listen_common_lh(const std::string& addr) {
 
     pn_listener_t* listener = pn_listener();
     pn_listener_set_context(listener, &container_);
+    pn_listener_set_reuseport(listener, reuseport);
     pn_proactor_listen(proactor_, listener, &caddr[0], 16);
     return listener;
 }
@@ -436,25 +666,39 @@ proton::listener container::impl::listen(const std::string& addr, const proton::
 
 proton::listener container::impl::listen(const std::string& addr, proton::listen_handler& lh) {
     GUARD(lock_);
-    pn_listener_t* listener = listen_common_lh(addr);
+    pn_listener_t* listener = listen_common_lh(addr, lh.reuseport());
     listener_context& lc=listener_context::get(listener);
     lc.listen_handler_ = &lh;
     return proton::listener(listener);
 }
 
-void container::impl::schedule(duration delay, work f) {
-    GUARD(deferred_lock_);
-    timestamp now = timestamp::now();
+work_handle container::impl::schedule(duration delay, work f) {
+    timer_shard& ts = this_thread_timers();
+    timestamp due = timestamp::now()+delay;
+    timer_wheel::id id;
+    {
+        GUARD(ts.lock);
+        id = ts.wheel.add(due, f);
+    }
+    arm_timeout(due);
+    // The handle has the shard in the bits the wheel leaves free
+    return id | (work_handle(&ts - timer_shards_) << 32);
+}
 
-    // Record timeout; Add callback to timeout sorted list
-    scheduled s = {now+delay, f};
-    deferred_.push_back(s);
-    std::push_heap(deferred_.begin(), deferred_.end());
+void container::impl::cancel(work_handle h) {
+    size_t shard = (h >> 32) & 0xff;
+    if (!h || shard >= TIMER_SHARDS) return;
+    timer_shard& ts = timer_shards_[shard];
+    GUARD(ts.lock);
+    ts.wheel.cancel(h);
+}
 
-    // Set timeout for current head of timeout queue
-    scheduled* next = &deferred_.front();
-    pn_millis_t timeout_ms = (now < next->time) ? (next->time-now).milliseconds() : 0;
-    pn_proactor_set_timeout(proactor_, timeout_ms);
+container::impl::timer_shard& container::impl::this_thread_timers() {
+#if PN_CPP_SUPPORTS_THREADS
+    return timer_shards_[std::hash<std::thread::id>()(std::this_thread::get_id()) % TIMER_SHARDS];
+#else
+    return timer_shards_[0];
+#endif
 }
 
 void container::impl::client_connection_options(const connection_options &opts) {
@@ -479,50 +723,26 @@ void container::impl::receiver_options(const proton::receiver_options &opts) {
 
 void container::impl::run_timer_jobs() {
     timestamp now = timestamp::now();
-    std::vector<scheduled> tasks;
+    std::vector<timer_wheel::timer> tasks;
 
     // We first extract all the runnable tasks and then run them -  this is to avoid having tasks
-    // injected as we are running them (which could potentially never end)
-    {
-        GUARD(deferred_lock_);
-
-        // Figure out how many tasks we need to execute and pop them to the back of the
-        // queue (in reverse order)
-        unsigned i = 0;
-        for (;;) {
-            // Have we seen all the queued tasks?
-            if  ( deferred_.size()-i==0 ) break;
-
-            // Is the next task in the future?
-            timestamp next_time = deferred_.front().time;
-            if ( next_time>now ) {
-                pn_proactor_set_timeout(proactor_, (next_time-now).milliseconds());
-                break;
-            }
-
-            std::pop_heap(deferred_.begin(), deferred_.end()-i);
-            ++i;
-        }
-        // Nothing to do
-        if ( i==0 ) return;
-
-        // Now we know how many tasks to run
-        if ( deferred_.size()==i ) {
-            // If we sorted the entire heap, then we're executing every task
-            // so don't need to copy and can just swap
-            tasks.swap(deferred_);
-        } else {
-            // Otherwise just copy the ones we sorted
-            tasks = std::vector<scheduled>(deferred_.end()-i, deferred_.end());
-
-            // Remove tasks to be executed
-            deferred_.resize(deferred_.size()-i);
-        }
+    // injected as we are running them (which could potentially never end).
+    // Work scheduled meanwhile lowers next_timeout_ again and sets its own timeout.
+    next_timeout_.store(NO_TIMEOUT);
+    timestamp next(NO_TIMEOUT);
+    for (size_t i = 0; i < TIMER_SHARDS; ++i) {
+        timer_shard& ts = timer_shards_[i];
+        GUARD(ts.lock);
+        ts.wheel.expire(now, tasks);
+        timestamp t;
+        if (ts.wheel.next(t) && t < next) next = t;
     }
-    // We've now taken the tasks to run from the deferred tasks
-    // so we can run them unlocked
-    // NB. We copied the due tasks in reverse order so execute from end
-    for (int i = tasks.size()-1; i>=0; --i) tasks[i].task();
+    if (next.milliseconds() != NO_TIMEOUT) arm_timeout(next);
+
+    // Run in time order, work for the same time in the order it was scheduled
+    std::stable_sort(tasks.begin(), tasks.end());
+    // We've now taken the tasks to run from the wheels so we can run them unlocked
+    for (size_t i = 0; i < tasks.size(); ++i) tasks[i].task();
 }
 
 // Return true if this thread is finished
@@ -554,18 +774,7 @@ container::impl::dispatch_result container::impl::dispatch(pn_event_t* event) {
     case PN_PROACTOR_TIMEOUT: {
         // Can get an immediate timeout, if we have a container event loop inject
         run_timer_jobs();
-
-        // Run every container event loop job
-        // This is not at all efficient and single threads all these jobs, but it does correctly
-        // serialise them
-        work_queues queues;
-        {
-            GUARD(work_queues_lock_);
-            queues = work_queues_;
-        }
-        for (work_queues::iterator queue = queues.begin(); queue!=queues.end(); ++queue) {
-            (*queue)->run_all_jobs();
-        }
+        // Container work queues are run by thread() once the batch is done
         return EndBatch;
     }
     case PN_LISTENER_OPEN: {
@@ -606,7 +815,8 @@ container::impl::dispatch_result container::impl::dispatch(pn_event_t* event) {
         cc.container = &container_;
         cc.listener_context_ = lc;
         cc.handler = opts.handler();
-        cc.work_queue_ = new container::impl::connection_work_queue(*container_.impl_, c);
+        cc.work_queue_ = new container::impl::connection_work_queue(
+            *container_.impl_, c, opts.work_queue_capacity(), opts.work_queue_policy());
         pn_transport_t* pnt = pn_transport();
         pn_transport_set_server(pnt);
         opts.apply_unbound_server(pnt);
@@ -729,15 +939,16 @@ void container::impl::thread() {
     bool finished;
     {
         GUARD(lock_);
-        ++threads_;
         finished = stopping_;
     }
     while (!finished) {
         pn_event_batch_t *events = pn_proactor_wait(proactor_);
         pn_event_t *e;
+        bool timeout = false;
         error_condition error;
         try {
             while ((e = pn_event_batch_next(events))) {
+                timeout = pn_event_type(e) == PN_PROACTOR_TIMEOUT;
                 dispatch_result r = dispatch(e);
                 finished = r==EndLoop;
                 if (r!=ContinueLoop) break;
@@ -749,6 +960,9 @@ void container::impl::thread() {
             error = error_condition("exception", "container shut-down by unknown exception");
         }
         pn_proactor_done(proactor_, events);
+        // Outside the proactor batch so other threads can get the next
+        // timeout and run other work queues meanwhile.
+        if (timeout && error.empty()) run_work_queue();
         if (!error.empty()) {
             finished = true;
             {
@@ -779,6 +993,12 @@ void container::impl::run(int threads) {
 #if PN_CPP_SUPPORTS_THREADS
     // Run handler threads
     threads = std::max(threads, 1); // Ensure at least 1 thread
+    {
+        // Count the threads before they start so that the thread stopping the
+        // container also interrupts those not yet waiting for events
+        GUARD(lock_);
+        threads_ += threads;
+    }
     typedef std::vector<std::thread*> vt; // pointer vector to work around failures in older compilers
     vt ts(threads-1);
     for (vt::iterator i = ts.begin(); i != ts.end(); ++i) {
@@ -794,6 +1014,10 @@ void container::impl::run(int threads) {
     }
 #else
     // Run a single handler thread (As we have no threading API)
+    {
+        GUARD(lock_);
+        ++threads_;
+    }
     thread();
 #endif
 
@@ -811,6 +1035,21 @@ void container::impl::run(int threads) {
     };
 }
 
+// Replace the unused proactor with a sharded one
+void container::impl::shards(int count) {
+    GUARD(lock_);
+    {
+        GUARD(work_queues_lock_);
+        if (threads_ || stopping_ || proactor_used_ || !work_queues_.empty() || next_timeout_.load() != NO_TIMEOUT)
+            throw proton::error("container is already in use");
+    }
+    pn_proactor_t* p = pn_proactor_sharded(std::max(count, 1));
+    if (!p)
+        throw proton::error("cannot create proactor");
+    pn_proactor_free(proactor_);
+    proactor_ = p;
+}
+
 void container::impl::auto_stop(bool set) {
     GUARD(lock_);
     auto_stop_ = set;
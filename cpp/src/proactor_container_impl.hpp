@@ -36,14 +36,16 @@
 #include "proton/work_queue.hpp"
 
 #include "proton_bits.hpp"
+#include "timer_wheel.hpp"
 
+#include <deque>
 #include <list>
 #include <map>
-#include <set>
 #include <string>
 #include <vector>
 
 #if PN_CPP_SUPPORTS_THREADS
+#include <atomic>
 #include <mutex>
 # define MUTEX(x) std::mutex x;
 # define GUARD(x) std::lock_guard<std::mutex> g(x)
@@ -64,6 +66,29 @@ namespace proton {
 
 namespace internal {
 class connector;
+
+#if PN_CPP_SUPPORTS_THREADS
+using std::atomic;
+#else
+// Without threads there is nothing to synchronise with
+template <class T> class atomic {
+  public:
+    atomic(T v = T()) : value_(v) {}
+    T load() const { return value_; }
+    void store(T v) { value_ = v; }
+    T exchange(T v) { T old = value_; value_ = v; return old; }
+    T fetch_add(T n) { T old = value_; value_ += n; return old; }
+    T fetch_sub(T n) { T old = value_; value_ -= n; return old; }
+    bool compare_exchange_weak(T& expected, T v) {
+        if (value_ != expected) { expected = value_; return false; }
+        value_ = v;
+        return true;
+    }
+    operator T() const { return value_; }
+  private:
+    T value_;
+};
+#endif
 }
 
 class container::impl {
@@ -89,19 +114,21 @@ class container::impl {
     void receiver_options(const proton::receiver_options&);
     class receiver_options receiver_options() const { return receiver_options_; }
     void run(int threads);
+    void shards(int count);
     void stop(const error_condition& err);
     void auto_stop(bool set);
-    void schedule(duration, work);
+    work_handle schedule(duration, work);
+    void cancel(work_handle);
     template <class T> static void set_handler(T s, messaging_handler* h);
     template <class T> static messaging_handler* get_handler(T s);
     messaging_handler* get_handler(pn_event_t *event);
-    static work_queue::impl* make_work_queue(container&);
+    static work_queue::impl* make_work_queue(container&, size_t capacity = 0, work_queue::full_policy = work_queue::FAIL);
 
   private:
     class common_work_queue;
     class connection_work_queue;
     class container_work_queue;
-    pn_listener_t* listen_common_lh(const std::string&);
+    pn_listener_t* listen_common_lh(const std::string&, size_t reuseport = 0);
     pn_connection_t* make_connection_lh(const url& url, const connection_options&);
     void setup_connection_lh(const url& url, pn_connection_t *pnc);
     void start_connection(const url& url, pn_connection_t* c);
@@ -116,6 +143,8 @@ class container::impl {
     enum dispatch_result {ContinueLoop, EndBatch, EndLoop};
     dispatch_result dispatch(pn_event_t*);
     void run_timer_jobs();
+    void run_work_queue();
+    void set_timeout();
 
     int threads_;
     container& container_;
@@ -126,21 +155,27 @@ class container::impl {
     void start_event();
     void stop_event();
 
-    typedef std::set<container_work_queue*> work_queues;
+    // Container work queues with work to run, each is taken by one thread
+    typedef std::deque<container_work_queue*> work_queues;
     work_queues work_queues_;
     MUTEX(work_queues_lock_)
-    container_work_queue* add_work_queue();
+    container_work_queue* add_work_queue(size_t capacity, work_queue::full_policy);
+    void work_queue_ready(container_work_queue*);
     void remove_work_queue(container_work_queue*);
 
-    struct scheduled {
-        timestamp time; // duration from epoch for task
-        work task;
-
-        // We want to get to get the *earliest* first so test is "reversed"
-        bool operator < (const scheduled& r) const { return  r.time < time; }
+    // Scheduled work is spread over timer wheels by thread so that threads
+    // scheduling work do not contend for one lock.
+    struct timer_shard {
+        timer_shard() : wheel(timestamp::now()) {}
+        MUTEX(lock)
+        timer_wheel wheel;
     };
-    std::vector<scheduled> deferred_; // This vector is kept as a heap
-    MUTEX(deferred_lock_)
+    enum { TIMER_SHARDS = 8 };
+    timer_shard timer_shards_[TIMER_SHARDS];
+    timer_shard& this_thread_timers();
+    // Earliest time the proactor timeout is set for
+    internal::atomic<timestamp::numeric_type> next_timeout_;
+    void arm_timeout(timestamp);
 
     pn_proactor_t* proactor_;
     messaging_handler* handler_;
@@ -154,6 +189,7 @@ class container::impl {
     unsigned reconnecting_;
     bool auto_stop_;
     bool stopping_;
+    bool proactor_used_;        // Connections or listeners were added
     friend class connector;
 };
 
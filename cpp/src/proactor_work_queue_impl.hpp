@@ -31,7 +31,8 @@ class work_queue::impl {
     virtual ~impl() {};
     virtual bool add(work f) = 0;
     void add_void(work f) { add(f); }
-    virtual void schedule(duration, work) = 0;
+    virtual work_handle schedule(duration, work) = 0;
+    virtual void cancel(work_handle) = 0;
     virtual void run_all_jobs() = 0;
     virtual void finished() = 0;
 };
@@ -62,24 +62,93 @@ class target sender::target() const {
 namespace {
 // TODO: revisit if thread safety required
 uint64_t tag_counter = 0;
-}
 
-tracker sender::send(const message &message) {
+pn_delivery_t *send_encoded(pn_link_t *lnk, const char *bytes, size_t size) {
     uint64_t id = ++tag_counter;
     pn_delivery_t *dlv =
-        pn_delivery(pn_object(), pn_dtag(reinterpret_cast<const char*>(&id), sizeof(id)));
-    std::vector<char> buf;
-    message.encode(buf);
-    assert(!buf.empty());
-    pn_link_send(pn_object(), &buf[0], buf.size());
-    pn_link_advance(pn_object());
-    if (pn_link_snd_settle_mode(pn_object()) == PN_SND_SETTLED)
+        pn_delivery(lnk, pn_dtag(reinterpret_cast<const char*>(&id), sizeof(id)));
+    pn_link_send(lnk, bytes, size);
+    pn_link_advance(lnk);
+    if (pn_link_snd_settle_mode(lnk) == PN_SND_SETTLED)
         pn_delivery_settle(dlv);
+    return dlv;
+}
+
+// The send buffer is kept at the size of the largest recent send, so repeated
+// large sends encode in one pass without allocating. After SHRINK_AFTER sends
+// in a row of under a quarter of that, it is sized to them instead, and memory
+// over SEND_BUFFER_KEEP is released.
+const unsigned SHRINK_AFTER = 32;
+const size_t SEND_BUFFER_KEEP = 64 * 1024;
+
+// Size the buffer for the next encode from recent sends, rather than growing
+// it from scratch by encoding again
+void prepare_send_buffer(link_context &lctx) {
+    if (lctx.send_buffer.size() < lctx.send_size)
+        lctx.send_buffer.resize(lctx.send_size);
+}
+
+// Record a send of size bytes from the buffer
+void sent_from_buffer(link_context &lctx, size_t size) {
+    if (size >= lctx.send_size / 4) {
+        if (size > lctx.send_size) lctx.send_size = size;
+        lctx.small_sends = 0;
+        lctx.small_send_size = 0;
+        return;
+    }
+    if (size > lctx.small_send_size) lctx.small_send_size = size;
+    if (++lctx.small_sends < SHRINK_AFTER) return;
+    lctx.send_size = lctx.small_send_size;
+    lctx.small_sends = 0;
+    lctx.small_send_size = 0;
+    if (lctx.send_buffer.capacity() > SEND_BUFFER_KEEP) {
+        std::vector<char>().swap(lctx.send_buffer);
+        std::vector<size_t>().swap(lctx.batch_ends);
+    }
+}
+}
+
+tracker sender::send(const message &message) {
+    link_context &lctx = link_context::get(pn_object());
+    prepare_send_buffer(lctx);
+    size_t size = message.encode_into(lctx.send_buffer);
+    assert(size);
+    pn_delivery_t *dlv = send_encoded(pn_object(), &lctx.send_buffer[0], size);
+    sent_from_buffer(lctx, size);
     if (!pn_link_credit(pn_object()))
-        link_context::get(pn_object()).draining = false;
+        lctx.draining = false;
     return make_wrapper<tracker>(dlv);
 }
 
+size_t sender::batch_begin() {
+    link_context &lctx = link_context::get(pn_object());
+    lctx.batch_ends.clear();
+    prepare_send_buffer(lctx);
+    int credit = pn_link_credit(pn_object());
+    return credit > 0 ? credit : 0;
+}
+
+// Messages of a batch are encoded one after the other in the send buffer
+void sender::batch_add(const message &message) {
+    link_context &lctx = link_context::get(pn_object());
+    size_t offset = lctx.batch_ends.empty() ? 0 : lctx.batch_ends.back();
+    lctx.batch_ends.push_back(offset + message.encode_into(lctx.send_buffer, offset));
+}
+
+void sender::batch_send() {
+    link_context &lctx = link_context::get(pn_object());
+    size_t offset = 0;
+    for (size_t i = 0; i < lctx.batch_ends.size(); ++i) {
+        size_t end = lctx.batch_ends[i];
+        send_encoded(pn_object(), &lctx.send_buffer[offset], end - offset);
+        offset = end;
+    }
+    lctx.batch_ends.clear();
+    if (offset) sent_from_buffer(lctx, offset);
+    if (!pn_link_credit(pn_object()))
+        lctx.draining = false;
+}
+
 void sender::return_credit() {
     link_context &lctx = link_context::get(pn_object());
     lctx.draining = false;
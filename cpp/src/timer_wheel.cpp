@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "timer_wheel.hpp"
+
+#include "proton/error.hpp"
+
+namespace proton {
+
+namespace {
+
+// Index of the lowest set bit of m, m != 0
+inline unsigned lowest_bit(uint64_t m) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(m);
+#else
+    unsigned i = 0;
+    for (; !(m & 1); m >>= 1) ++i;
+    return i;
+#endif
+}
+
+}
+
+const uint32_t timer_wheel::NIL;
+
+timer_wheel::timer_wheel(timestamp now) : now_(now.milliseconds()), size_(0) {
+    for (int k = 0; k < LEVELS; ++k) occupied_[k] = 0;
+}
+
+// The list for work at tick t: the level is the highest group of bits where
+// t differs from now_, the slot is t's value in that group.
+uint32_t timer_wheel::list_for(tick t) const {
+    if (t <= now_) return DUE;
+    tick diff = t ^ now_;
+    if (diff >> (LEVELS * BITS)) return FAR;
+    unsigned k = 0;
+    while (diff >> ((k + 1) * BITS)) ++k;
+    return k * SLOTS + ((t >> (k * BITS)) & (SLOTS - 1));
+}
+
+void timer_wheel::link(uint32_t n) {
+    node& x = nodes_[n];
+    uint32_t l = list_for(x.time);
+    list& ls = lists_[l];
+    x.list = l;
+    x.prev = ls.tail;
+    x.next = NIL;
+    if (ls.tail == NIL) ls.head = n; else nodes_[ls.tail].next = n;
+    ls.tail = n;
+    if (l < DUE) occupied_[l / SLOTS] |= uint64_t(1) << (l % SLOTS);
+}
+
+void timer_wheel::unlink(uint32_t n) {
+    node& x = nodes_[n];
+    list& ls = lists_[x.list];
+    if (x.prev == NIL) ls.head = x.next; else nodes_[x.prev].next = x.next;
+    if (x.next == NIL) ls.tail = x.prev; else nodes_[x.next].prev = x.prev;
+    if (ls.head == NIL && x.list < DUE)
+        occupied_[x.list / SLOTS] &= ~(uint64_t(1) << (x.list % SLOTS));
+}
+
+void timer_wheel::release(uint32_t n) {
+    node& x = nodes_[n];
+    x.task = work();
+    x.list = NIL;
+    // Never reuse an id, 0 stays invalid
+    x.gen = (x.gen + 1) & 0xffffff;
+    if (!x.gen) x.gen = 1;
+    free_.push_back(n);
+    --size_;
+}
+
+timer_wheel::id timer_wheel::add(timestamp t, const work& f) {
+    uint32_t n;
+    if (free_.empty()) {
+        if (nodes_.size() == NIL) throw error("too many scheduled tasks");
+        n = uint32_t(nodes_.size());
+        nodes_.push_back(node());
+    } else {
+        n = free_.back();
+        free_.pop_back();
+    }
+    node& x = nodes_[n];
+    x.time = t.milliseconds() > 0 ? t.milliseconds() : 0;
+    x.task = f;
+    link(n);
+    ++size_;
+    return (id(x.gen) << 40) | n;
+}
+
+bool timer_wheel::cancel(id i) {
+    uint32_t n = uint32_t(i);
+    if (n >= nodes_.size()) return false;
+    node& x = nodes_[n];
+    if (x.list == NIL || x.gen != (i >> 40)) return false;
+    unlink(n);
+    release(n);
+    return true;
+}
+
+// The first occupied slot after now_: a slot on the lowest level with one
+// starts before any slot on the levels above.
+bool timer_wheel::next_tick(tick& t, uint32_t& l) const {
+    for (unsigned k = 0; k < LEVELS; ++k) {
+        unsigned cur = (now_ >> (k * BITS)) & (SLOTS - 1);
+        uint64_t later = (cur == SLOTS - 1) ? 0 : occupied_[k] & (~uint64_t(0) << (cur + 1));
+        if (later) {
+            unsigned s = lowest_bit(later);
+            unsigned shift = (k + 1) * BITS;
+            t = ((now_ >> shift) << shift) | (tick(s) << (k * BITS));
+            l = k * SLOTS + s;
+            return true;
+        }
+    }
+    if (lists_[FAR].head != NIL) {
+        unsigned shift = LEVELS * BITS;
+        t = ((now_ >> shift) + 1) << shift;
+        l = FAR;
+        return true;
+    }
+    return false;
+}
+
+void timer_wheel::expire(timestamp now, std::vector<timer>& due) {
+    tick until = now.milliseconds() > 0 ? now.milliseconds() : 0;
+    while (true) {
+        for (uint32_t n = lists_[DUE].head; n != NIL; n = lists_[DUE].head) {
+            node& x = nodes_[n];
+            unlink(n);
+            timer tm = { timestamp(x.time), x.task };
+            due.push_back(tm);
+            release(n);
+        }
+        tick t;
+        uint32_t l;
+        if (!next_tick(t, l) || t > until) break;
+        // Advance to the slot and move its work down, work due now goes to DUE
+        now_ = t;
+        list ls = lists_[l];
+        lists_[l] = list();
+        if (l < DUE) occupied_[l / SLOTS] &= ~(uint64_t(1) << (l % SLOTS));
+        for (uint32_t n = ls.head, next; n != NIL; n = next) {
+            next = nodes_[n].next;
+            link(n);
+        }
+    }
+    if (until > now_) now_ = until;
+}
+
+bool timer_wheel::next(timestamp& t) const {
+    if (lists_[DUE].head != NIL) {
+        t = timestamp(now_);
+        return true;
+    }
+    tick nt;
+    uint32_t l;
+    if (!next_tick(nt, l)) return false;
+    t = timestamp(nt);
+    return true;
+}
+
+}
@@ -0,0 +1,109 @@
+#ifndef PROTON_CPP_TIMER_WHEEL_HPP
+#define PROTON_CPP_TIMER_WHEEL_HPP
+
+/*
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ *
+ */
+
+#include "proton/fwd.hpp"
+#include "proton/timestamp.hpp"
+#include "proton/work_queue.hpp"
+
+#include <vector>
+
+namespace proton {
+
+// Hierarchical timer wheel of work to run at a time, with millisecond ticks.
+//
+// Level k has 64 slots of 64^k ticks, work is kept on the lowest level whose
+// current span contains its time. When time reaches a slot on a higher level
+// its work is moved down ("cascaded") to a lower level. Adding and cancelling
+// are O(1), expiring touches only occupied slots. Work more than 64^6 ticks
+// (about two years) ahead is kept aside until time gets closer.
+//
+// Not thread safe.
+class timer_wheel {
+  public:
+    // Identifies added work: the slot generation in the high 24 bits and the
+    // node in the low 32 bits. Bits 32-39 are always 0 and free for the caller.
+    typedef uint64_t id;
+
+    struct timer {
+        timestamp time;
+        work task;
+
+        bool operator<(const timer& t) const { return time < t.time; }
+    };
+
+    explicit timer_wheel(timestamp now);
+
+    // Add work f to run at time t, return an id for cancel()
+    id add(timestamp t, const work& f);
+
+    // Remove work that has not expired yet, return false if there is none
+    bool cancel(id);
+
+    // Append work due at or before now to due
+    void expire(timestamp now, std::vector<timer>& due);
+
+    // Earliest time at which expire() may find work, false if there is no work.
+    // This is the start of the first occupied slot, so it can be early.
+    bool next(timestamp& t) const;
+
+    size_t size() const { return size_; }
+
+  private:
+    typedef uint64_t tick;
+    enum { BITS = 6, SLOTS = 1 << BITS, LEVELS = 6 };
+    // Lists past the wheel slots: work already due, and work beyond the top level
+    enum { DUE = LEVELS * SLOTS, FAR, LISTS };
+    static const uint32_t NIL = ~uint32_t(0);
+
+    struct node {
+        node() : time(0), gen(1), list(NIL), prev(NIL), next(NIL) {}
+        tick time;
+        work task;
+        uint32_t gen;
+        uint32_t list;          // NIL when the node is free
+        uint32_t prev, next;
+    };
+
+    struct list {
+        list() : head(NIL), tail(NIL) {}
+        uint32_t head, tail;
+    };
+
+    uint32_t list_for(tick t) const;
+    void link(uint32_t n);
+    void unlink(uint32_t n);
+    void release(uint32_t n);
+    bool next_tick(tick& t, uint32_t& l) const;
+
+    tick now_;
+    size_t size_;
+    std::vector<node> nodes_;
+    std::vector<uint32_t> free_;
+    list lists_[LISTS];
+    uint64_t occupied_[LEVELS]; // Bit s of level k is set if slot s has work
+};
+
+}
+
+#endif // PROTON_CPP_TIMER_WHEEL_HPP
@@ -32,6 +32,9 @@ namespace proton {
 
 work_queue::work_queue() {}
 work_queue::work_queue(container& c) { *this = container::impl::make_work_queue(c); }
+work_queue::work_queue(container& c, size_t capacity, full_policy policy) {
+    *this = container::impl::make_work_queue(c, capacity, policy);
+}
 
 work_queue::~work_queue() {}
 
@@ -55,16 +58,16 @@ bool work_queue::add(void_function0& f) {
     return add(make_work(&void_function0::operator(), &f));
 }
 
-void work_queue::schedule(duration d, internal::v03::work f) {
+work_handle work_queue::schedule(duration d, internal::v03::work f) {
     // If we have no actual work queue, then can't defer
-    if (!impl_) return;
+    if (!impl_) return 0;
     return impl_->schedule(d, f);
 }
 
 #if PN_CPP_HAS_LAMBDAS && PN_CPP_HAS_VARIADIC_TEMPLATES
-void work_queue::schedule(duration d, internal::v11::work f) {
+work_handle work_queue::schedule(duration d, internal::v11::work f) {
     // If we have no actual work queue, then can't defer
-    if (!impl_) return;
+    if (!impl_) return 0;
     return impl_->schedule(d, f);
 }
 #endif
@@ -73,6 +76,11 @@ void work_queue::schedule(duration d, void_function0& f) {
     schedule(d, make_work(&void_function0::operator(), &f));
 }
 
+void work_queue::cancel(work_handle h) {
+    if (!impl_) return;
+    impl_->cancel(h);
+}
+
 work_queue& work_queue::get(pn_connection_t* c) {
     return connection_context::get(c).work_queue_;
 }